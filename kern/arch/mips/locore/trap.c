@@ -38,6 +38,7 @@
 #include <current.h>
 #include <vm.h>
 #include <mainbus.h>
+#include <proc.h>
 #include <syscall.h>
 
 
@@ -322,6 +323,14 @@ mips_trap(struct trapframe *tf)
 	cpu_irqoff();
  done2:
 
+	/*
+	 * If another thread of this process is exiting (or exec'ing),
+	 * don't go back to user mode; this doesn't return in that case.
+	 */
+	if (!iskern) {
+		proc_checkexiting();
+	}
+
 	/*
 	 * The boot thread can get here (e.g. on interrupt return) but
 	 * since it doesn't go to userlevel, it can't be returning to
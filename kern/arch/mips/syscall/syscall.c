@@ -38,8 +38,268 @@
 #include <current.h>
 #include <copyinout.h>
 #include <syscall.h>
+#include <sysstat.h>
 #include <vm.h>
 
+/*
+ * Argument decoding.
+ *
+ * Each entry in the dispatch table is a small function that pulls its
+ * call's arguments out of the trapframe (note the casts to userptr_t)
+ * and calls the real implementation. RETVAL is preset to 0, so calls
+ * that just succeed or fail can ignore it.
+ */
+
+static
+int
+sc_reboot(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_reboot(tf->tf_a0);
+}
+
+static
+int
+sc___time(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys___time((userptr_t)tf->tf_a0, (userptr_t)tf->tf_a1);
+}
+
+/* file calls */
+
+static
+int
+sc_open(struct trapframe *tf, int32_t *retval)
+{
+	return sys_open((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2, retval);
+}
+
+static
+int
+sc_dup2(struct trapframe *tf, int32_t *retval)
+{
+	return sys_dup2(tf->tf_a0, tf->tf_a1, retval);
+}
+
+static
+int
+sc_close(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_close(tf->tf_a0);
+}
+
+static
+int
+sc_read(struct trapframe *tf, int32_t *retval)
+{
+	return sys_read(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2, retval);
+}
+
+static
+int
+sc_write(struct trapframe *tf, int32_t *retval)
+{
+	return sys_write(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2, retval);
+}
+
+static
+int
+sc_lseek(struct trapframe *tf, int32_t *retval)
+{
+	/*
+	 * Because the position argument is 64 bits wide, it goes in
+	 * the a2/a3 registers and we have to get "whence" from the
+	 * stack. Furthermore, the return value is 64 bits wide, so
+	 * the extra part of it goes in the v1 register.
+	 *
+	 * This is a trifle messy.
+	 */
+	uint64_t offset;
+	int whence;
+	off_t retval64;
+	int err;
+
+	join32to64(tf->tf_a2, tf->tf_a3, &offset);
+
+	err = copyin((userptr_t)tf->tf_sp + 16, &whence, sizeof(int));
+	if (err) {
+		return err;
+	}
+
+	err = sys_lseek(tf->tf_a0, offset, whence, &retval64);
+	if (err) {
+		return err;
+	}
+
+	split64to32(retval64, &tf->tf_v0, &tf->tf_v1);
+	*retval = tf->tf_v0;
+	return 0;
+}
+
+static
+int
+sc_chdir(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_chdir((userptr_t)tf->tf_a0);
+}
+
+static
+int
+sc___getcwd(struct trapframe *tf, int32_t *retval)
+{
+	return sys___getcwd((userptr_t)tf->tf_a0, tf->tf_a1, retval);
+}
+
+/* process calls */
+
+static
+int
+sc_fork(struct trapframe *tf, int32_t *retval)
+{
+	return sys_fork(tf, retval);
+}
+
+static
+int
+sc___getpid(struct trapframe *tf, int32_t *retval)
+{
+	(void)tf;
+	return sys_getpid(retval);
+}
+
+static
+int
+sc__exit(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys__exit(tf->tf_a0);
+}
+
+static
+int
+sc_waitpid(struct trapframe *tf, int32_t *retval)
+{
+	return sys_waitpid(tf->tf_a0, (userptr_t)tf->tf_a1, tf->tf_a2,
+			   retval);
+}
+
+static
+int
+sc_execv(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_execv((const_userptr_t)tf->tf_a0,
+			 (const_userptr_t)tf->tf_a1);
+}
+
+static
+int
+sc_spawn(struct trapframe *tf, int32_t *retval)
+{
+	return sys_spawn((const_userptr_t)tf->tf_a0,
+			 (const_userptr_t)tf->tf_a1, retval);
+}
+
+static
+int
+sc___thread_create(struct trapframe *tf, int32_t *retval)
+{
+	return sys___thread_create((userptr_t)tf->tf_a0,
+				   (userptr_t)tf->tf_a1,
+				   (userptr_t)tf->tf_a2, retval);
+}
+
+static
+int
+sc_thread_join(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_thread_join(tf->tf_a0, (userptr_t)tf->tf_a1);
+}
+
+static
+int
+sc_thread_exit(struct trapframe *tf, int32_t *retval)
+{
+	(void)retval;
+	return sys_thread_exit((userptr_t)tf->tf_a0);
+}
+
+static
+int
+sc_futex(struct trapframe *tf, int32_t *retval)
+{
+	return sys_futex((userptr_t)tf->tf_a0, tf->tf_a1, tf->tf_a2,
+			 retval);
+}
+
+static
+int
+sc_ioring_enter(struct trapframe *tf, int32_t *retval)
+{
+	return sys_ioring_enter((userptr_t)tf->tf_a0, retval);
+}
+
+static
+int
+sc_sbrk(struct trapframe *tf, int32_t *retval)
+{
+	(void)tf;
+	(void)retval;
+	kprintf("Warning: sbrk() removed for asst2-single submission\n");
+	return ENOSYS;
+}
+
+/*
+ * The dispatch table, indexed by call number. Empty slots are calls
+ * we don't implement.
+ */
+struct syscall_entry {
+	const char *se_name;
+	int (*se_handler)(struct trapframe *tf, int32_t *retval);
+};
+
+#define SYSCALL(name)	[SYS_##name] = { #name, sc_##name }
+
+static const struct syscall_entry syscall_table[SYSCALL_NUM] = {
+	SYSCALL(reboot),
+	SYSCALL(__time),
+
+	SYSCALL(open),
+	SYSCALL(dup2),
+	SYSCALL(close),
+	SYSCALL(read),
+	SYSCALL(write),
+	SYSCALL(lseek),
+	SYSCALL(chdir),
+	SYSCALL(__getcwd),
+
+	SYSCALL(fork),
+	SYSCALL(__getpid),
+	SYSCALL(_exit),
+	SYSCALL(waitpid),
+	SYSCALL(execv),
+	SYSCALL(spawn),
+	SYSCALL(__thread_create),
+	SYSCALL(thread_join),
+	SYSCALL(thread_exit),
+	SYSCALL(futex),
+	SYSCALL(ioring_enter),
+	SYSCALL(sbrk),
+};
+
+const char *
+syscall_name(unsigned callno)
+{
+	if (callno >= SYSCALL_NUM) {
+		return NULL;
+	}
+	return syscall_table[callno].se_name;
+}
+
 /*
  * System call dispatcher.
  *
@@ -81,7 +341,9 @@
 void
 syscall(struct trapframe *tf)
 {
-	int callno;
+	const struct syscall_entry *se;
+	unsigned callno;
+	uint32_t start;
 	int32_t retval;
 	int err;
 
@@ -90,6 +352,7 @@ syscall(struct trapframe *tf)
 	KASSERT(curthread->t_iplhigh_count == 0);
 
 	callno = tf->tf_v0;
+	start = sysstat_enter(callno);
 
 	/*
 	 * Initialize retval to 0. Many of the system calls don't
@@ -102,133 +365,15 @@ syscall(struct trapframe *tf)
 
 	retval = 0;
 
-	/* note the casts to userptr_t */
-
-	switch (callno) {
-	    case SYS_reboot:
-		err = sys_reboot(tf->tf_a0);
-		break;
-
-	    case SYS___time:
-		err = sys___time((userptr_t)tf->tf_a0,
-				 (userptr_t)tf->tf_a1);
-		break;
-
-
-	    /* file calls */
-
-	    case SYS_open:
-		err = sys_open(
-			(userptr_t)tf->tf_a0,
-			tf->tf_a1,
-			tf->tf_a2,
-			&retval);
-		break;
-
-	    case SYS_dup2:
-		err = sys_dup2(
-			tf->tf_a0,
-			tf->tf_a1,
-			&retval);
-		break;
-
-	    case SYS_close:
-		err = sys_close(tf->tf_a0);
-		break;
-
-	    case SYS_read:
-		err = sys_read(
-			tf->tf_a0,
-			(userptr_t)tf->tf_a1,
-			tf->tf_a2,
-			&retval);
-		break;
-	    case SYS_write:
-		err = sys_write(
-			tf->tf_a0,
-			(userptr_t)tf->tf_a1,
-			tf->tf_a2,
-			&retval);
-		break;
-	    case SYS_lseek:
-		{
-			/*
-			 * Because the position argument is 64 bits wide,
-			 * it goes in the a2/a3 registers and we have to
-			 * get "whence" from the stack. Furthermore, the
-			 * return value is 64 bits wide, so the extra
-			 * part of it goes in the v1 register.
-			 *
-			 * This is a trifle messy.
-			 */
-			uint64_t offset;
-			int whence;
-			off_t retval64;
-
-			join32to64(tf->tf_a2, tf->tf_a3, &offset);
-
-			err = copyin((userptr_t)tf->tf_sp + 16,
-				     &whence, sizeof(int));
-			if (err) {
-				break;
-			}
-
-			err = sys_lseek(tf->tf_a0, offset, whence, &retval64);
-			if (err) {
-				break;
-			}
-
-			split64to32(retval64, &tf->tf_v0, &tf->tf_v1);
-			retval = tf->tf_v0;
-		}
-		break;
-
-	    case SYS_chdir:
-		err = sys_chdir((userptr_t)tf->tf_a0);
-		break;
-
-	    case SYS___getcwd:
-		err = sys___getcwd(
-			(userptr_t)tf->tf_a0,
-			tf->tf_a1,
-			&retval);
-		break;
-
-
-	    /* Process system calls go here */
-	    case SYS_fork:
-		err = sys_fork(tf, &retval);
-		
-		break;	
-		
-	    case SYS_getpid:
-		err = sys_getpid(&retval);
-		break;
-	    case SYS__exit:
-		err = sys__exit(tf->tf_a0);
-		break;
-	    case SYS_waitpid:
-		err = sys_waitpid(tf->tf_a0, (int*)tf->tf_a1, tf->tf_a2, &retval);
-		break;
-
-	    case SYS_execv:
-		err = sys_execv((char *)tf->tf_a0, (userptr_t **)tf->tf_a1, &retval);
-		break;
-
-	    case SYS_sbrk:
-		/*
-		err = sys_sbrk(tf->tf_a0, &retval);
-		*/
-		kprintf("Warning: sbrk() removed for asst2-single submission\n");
-		break;
-    	
-	default:
-		kprintf("Unknown syscall %d\n", callno);
+	se = callno < SYSCALL_NUM ? &syscall_table[callno] : NULL;
+	if (se != NULL && se->se_handler != NULL) {
+		err = se->se_handler(tf, &retval);
+	}
+	else {
+		kprintf("Unknown syscall %d\n", (int)callno);
 		err = ENOSYS;
-		break;
 	}
 
-
 	if (err) {
 		/*
 		 * Return the error code. This gets converted at
@@ -251,6 +396,8 @@ syscall(struct trapframe *tf)
 
 	tf->tf_epc += 4;
 
+	sysstat_exit(callno, start);
+
 	/* Make sure the syscall code didn't forget to lower spl */
 	KASSERT(curthread->t_curspl == 0);
 	/* ...or leak any spinlocks */
@@ -272,13 +419,15 @@ enter_forked_process(struct trapframe *tf)
 {
 	struct trapframe tf_stack;	
 
+	// mips_usermode needs the trapframe on our own stack; this is
+	// where the heap copy made by sys_fork ends up, and it's freed.
+	tf_stack = *tf;
+	kfree(tf);
+
 	// Alter trap frame to show a success. Increment counter as per instructions.
-	tf->tf_v0 = 0;
-	tf->tf_a3 = 0;
-	tf->tf_epc += 4;
-	
-	// Copy over to stack
-	tf_stack = *tf;	
+	tf_stack.tf_v0 = 0;
+	tf_stack.tf_a3 = 0;
+	tf_stack.tf_epc += 4;
 
 	mips_usermode(&tf_stack);
 	
@@ -170,6 +170,33 @@ cpu_identify(char *buf, size_t max)
 
 ////////////////////////////////////////////////////////////
 
+/*
+ * Cycle counter.
+ *
+ * c0_count increments once per cycle (this is also what drives the
+ * on-chip timer; see lamebus_machdep.c). At 25 MHz it wraps about
+ * every three minutes.
+ */
+uint32_t
+cpu_getcycles(void)
+{
+	uint32_t count;
+
+	/*
+	 * $9 == c0_count; we can't use the symbolic name inside the
+	 * asm string.
+	 */
+	__asm volatile(
+		".set push;"		/* save assembler mode */
+		".set mips32;"		/* allow MIPS32 registers */
+		"mfc0 %0, $9;"		/* read it */
+		".set pop"		/* restore assembler mode */
+		: "=r" (count));
+	return count;
+}
+
+////////////////////////////////////////////////////////////
+
 /*
  * Interrupt control.
  *
@@ -29,12 +29,14 @@
 
 #include <types.h>
 #include <kern/errno.h>
+#include <kern/userinfo.h>
 #include <lib.h>
 #include <spl.h>
 #include <cpu.h>
 #include <spinlock.h>
 #include <proc.h>
 #include <current.h>
+#include <clock.h>
 #include <mips/tlb.h>
 #include <addrspace.h>
 #include <vm.h>
@@ -59,10 +61,17 @@
 /* (this must be > 64K so argument blocks of size ARG_MAX will fit) */
 #define DUMBVM_STACKPAGES    18
 
+/* Extra thread stacks go below the main stack; slot 0 is highest. */
+#define DUMBVM_TSTACKSIZE    (ADDRSP_THREADSTACK_PAGES * PAGE_SIZE)
+#define DUMBVM_TSTACKTOP     (USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE)
+#define DUMBVM_TSTACKBASE(slot) \
+	(DUMBVM_TSTACKTOP - ((slot) + 1) * DUMBVM_TSTACKSIZE)
+
 /*
  * Wrap ram_stealmem in a spinlock.
  */
-static struct spinlock stealmem_lock = SPINLOCK_INITIALIZER;
+static struct spinlock stealmem_lock =
+	SPINLOCK_INITIALIZER_NAMED("stealmem_lock");
 
 void
 vm_bootstrap(void)
@@ -153,6 +162,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 {
 	vaddr_t vbase1, vtop1, vbase2, vtop2, stackbase, stacktop;
 	paddr_t paddr;
+	unsigned slot;
+	bool readonly;
 	int i;
 	uint32_t ehi, elo;
 	struct addrspace *as;
@@ -164,8 +175,8 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 
 	switch (faulttype) {
 	    case VM_FAULT_READONLY:
-		/* We always create pages read-write, so we can't get this */
-		panic("dumbvm: got VM_FAULT_READONLY\n");
+		/* Only the user info pages are read-only. */
+		return EFAULT;
 	    case VM_FAULT_READ:
 	    case VM_FAULT_WRITE:
 		break;
@@ -211,6 +222,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	vtop2 = vbase2 + as->as_npages2 * PAGE_SIZE;
 	stackbase = USERSTACK - DUMBVM_STACKPAGES * PAGE_SIZE;
 	stacktop = USERSTACK;
+	readonly = false;
 
 	if (faultaddress >= vbase1 && faultaddress < vtop1) {
 		paddr = (faultaddress - vbase1) + as->as_pbase1;
@@ -221,6 +233,23 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 	else if (faultaddress >= stackbase && faultaddress < stacktop) {
 		paddr = (faultaddress - stackbase) + as->as_stackpbase;
 	}
+	else if (faultaddress >= DUMBVM_TSTACKBASE(UTHREAD_MAX - 1) &&
+		 faultaddress < DUMBVM_TSTACKTOP) {
+		slot = (DUMBVM_TSTACKTOP - 1 - faultaddress) / DUMBVM_TSTACKSIZE;
+		if (as->as_tstackpbase[slot] == 0) {
+			return EFAULT;
+		}
+		paddr = (faultaddress - DUMBVM_TSTACKBASE(slot)) +
+			as->as_tstackpbase[slot];
+	}
+	else if (faultaddress == USERINFO_ADDR) {
+		paddr = KVADDR_TO_PADDR((vaddr_t)curproc->p_userinfo);
+		readonly = true;
+	}
+	else if (faultaddress == USERCLOCK_ADDR) {
+		paddr = KVADDR_TO_PADDR((vaddr_t)userclock);
+		readonly = true;
+	}
 	else {
 		return EFAULT;
 	}
@@ -237,7 +266,10 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 			continue;
 		}
 		ehi = faultaddress;
-		elo = paddr | TLBLO_DIRTY | TLBLO_VALID;
+		elo = paddr | TLBLO_VALID;
+		if (!readonly) {
+			elo |= TLBLO_DIRTY;
+		}
 		DEBUG(DB_VM, "dumbvm: 0x%x -> 0x%x\n", faultaddress, paddr);
 		tlb_write(ehi, elo, i);
 		splx(spl);
@@ -252,6 +284,7 @@ vm_fault(int faulttype, vaddr_t faultaddress)
 struct addrspace *
 as_create(void)
 {
+	unsigned i;
 	struct addrspace *as = kmalloc(sizeof(struct addrspace));
 	if (as==NULL) {
 		return NULL;
@@ -264,6 +297,10 @@ as_create(void)
 	as->as_pbase2 = 0;
 	as->as_npages2 = 0;
 	as->as_stackpbase = 0;
+	for (i=0; i<UTHREAD_MAX; i++) {
+		as->as_tstackpbase[i] = 0;
+	}
+	as->as_copiedpages = 0;
 
 	return as;
 }
@@ -398,10 +435,43 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/*
+ * Thread stacks. Like everything else here they're physically
+ * contiguous, and since dumbvm can't free memory, a slot keeps its
+ * pages once it has them and they're reused by the slot's next thread.
+ */
+int
+as_define_thread_stack(struct addrspace *as, unsigned slot, vaddr_t *stackptr)
+{
+	KASSERT(slot < UTHREAD_MAX);
+
+	dumbvm_can_sleep();
+
+	if (as->as_tstackpbase[slot] == 0) {
+		as->as_tstackpbase[slot] = getppages(ADDRSP_THREADSTACK_PAGES);
+		if (as->as_tstackpbase[slot] == 0) {
+			return ENOMEM;
+		}
+	}
+	as_zero_region(as->as_tstackpbase[slot], ADDRSP_THREADSTACK_PAGES);
+
+	*stackptr = DUMBVM_TSTACKBASE(slot) + DUMBVM_TSTACKSIZE;
+	return 0;
+}
+
+void
+as_free_thread_stack(struct addrspace *as, unsigned slot)
+{
+	KASSERT(slot < UTHREAD_MAX);
+	(void)as;
+	/* nothing - keep the pages for the slot's next thread */
+}
+
 int
 as_copy(struct addrspace *old, struct addrspace **ret)
 {
 	struct addrspace *new;
+	unsigned i;
 
 	dumbvm_can_sleep();
 
@@ -437,6 +507,25 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		(const void *)PADDR_TO_KVADDR(old->as_stackpbase),
 		DUMBVM_STACKPAGES*PAGE_SIZE);
 
+	new->as_copiedpages = old->as_npages1 + old->as_npages2 +
+		DUMBVM_STACKPAGES;
+
+	/* The forking thread might be running on one of these. */
+	for (i=0; i<UTHREAD_MAX; i++) {
+		if (old->as_tstackpbase[i] == 0) {
+			continue;
+		}
+		new->as_tstackpbase[i] = getppages(ADDRSP_THREADSTACK_PAGES);
+		if (new->as_tstackpbase[i] == 0) {
+			as_destroy(new);
+			return ENOMEM;
+		}
+		memmove((void *)PADDR_TO_KVADDR(new->as_tstackpbase[i]),
+			(const void *)PADDR_TO_KVADDR(old->as_tstackpbase[i]),
+			DUMBVM_TSTACKSIZE);
+		new->as_copiedpages += ADDRSP_THREADSTACK_PAGES;
+	}
+
 	*ret = new;
 	return 0;
 }
@@ -1079,6 +1079,7 @@ static const struct vnode_ops emufs_fileops = {
 	.vop_reclaim = emufs_reclaim,
 
 	.vop_read = emufs_read,
+	.vop_readahead = vopfail_readahead_ignore,
 	.vop_readlink = emufs_readlink_notlink,
 	.vop_getdirentry = emufs_uio_op_notdir,
 	.vop_write = emufs_write,
@@ -1113,6 +1114,7 @@ static const struct vnode_ops emufs_dirops = {
 	.vop_reclaim = emufs_reclaim,
 
 	.vop_read = emufs_uio_op_isdir,
+	.vop_readahead = vopfail_readahead_ignore,
 	.vop_readlink = emufs_uio_op_isdir,
 	.vop_getdirentry = emufs_getdirentry,
 	.vop_write = emufs_uio_op_isdir,
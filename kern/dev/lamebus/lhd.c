@@ -29,6 +29,16 @@
 
 /*
  * LAMEbus hard disk (lhd) driver.
+ *
+ * The hardware transfers one sector per command, through a single
+ * sector-sized buffer on the card. To keep the disk busy, each call
+ * to lhd_io becomes one request for all the sectors of each of its
+ * buffers, and these go on a queue sorted by sector number. The interrupt handler copies
+ * each finished sector to or from the request's buffer and starts
+ * the next sector itself; when a request is done it wakes its
+ * thread and starts the next request right away, chosen C-SCAN
+ * style: the lowest-numbered one at or past the sector the disk
+ * last worked on, or if there are none of those, the lowest of all.
  */
 
 #include <types.h>
@@ -36,7 +46,8 @@
 #include <lib.h>
 #include <uio.h>
 #include <membar.h>
-#include <synch.h>
+#include <spinlock.h>
+#include <wchan.h>
 #include <platform/bus.h>
 #include <vfs.h>
 #include <lamebus/lhd.h>
@@ -60,6 +71,30 @@
 /* Buffer (offset within slot)  */
 #define LHD_BUFFER      32768
 
+/*
+ * Sectors per request when we have to copy through a bounce buffer
+ * (kept small enough for kmalloc's subpage allocator).
+ */
+#define LHD_BOUNCESECTS 4
+
+/* Most requests queued at once for one call to lhd_io */
+#define LHD_MAXIOV      16
+
+/*
+ * An I/O request. These live on the stack of the thread in lhd_io,
+ * which sleeps until lr_finished is set.
+ */
+struct lhd_request {
+	uint32_t lr_sector;		/* First sector */
+	uint32_t lr_nsect;		/* Number of sectors */
+	uint32_t lr_done;		/* Sectors done so far */
+	char *lr_buf;			/* Kernel buffer to transfer */
+	bool lr_write;			/* Is it a write? */
+	bool lr_finished;		/* Done (or failed) */
+	int lr_result;			/* Error code, if finished */
+	struct lhd_request *lr_next;	/* Next on the queue */
+};
+
 /*
  * Shortcut for reading a register.
  */
@@ -96,15 +131,119 @@ int lhd_code_to_errno(struct lhd_softc *lh, int code)
 }
 
 /*
- * Record that an I/O has completed: save the result and poke the
- * completion semaphore.
+ * Start the current sector of the active request. Call with lh_lock
+ * held.
+ */
+static
+void
+lhd_startsector(struct lhd_softc *lh)
+{
+	struct lhd_request *lr = lh->lh_active;
+	uint32_t statval = LHD_WORKING;
+
+	KASSERT(lr != NULL);
+	KASSERT(lr->lr_done < lr->lr_nsect);
+
+	/* If writing, transfer the data to the on-card buffer. */
+	if (lr->lr_write) {
+		memcpy(lh->lh_buf, lr->lr_buf + lr->lr_done * LHD_SECTSIZE,
+		       LHD_SECTSIZE);
+		membar_store_store();
+		statval |= LHD_ISWRITE;
+	}
+
+	lh->lh_headpos = lr->lr_sector + lr->lr_done;
+
+	/* Tell it what sector we want, and start the operation. */
+	lhd_wreg(lh, LHD_REG_SECT, lh->lh_headpos);
+	lhd_wreg(lh, LHD_REG_STAT, statval);
+}
+
+/*
+ * If the disk is idle, take the next request off the queue and start
+ * it. Call with lh_lock held.
+ */
+static
+void
+lhd_start(struct lhd_softc *lh)
+{
+	struct lhd_request **pp, *lr;
+
+	if (lh->lh_active != NULL || lh->lh_queue == NULL) {
+		return;
+	}
+
+	/* C-SCAN: first request at or past the head, else wrap around. */
+	pp = &lh->lh_queue;
+	while (*pp != NULL && (*pp)->lr_sector < lh->lh_headpos) {
+		pp = &(*pp)->lr_next;
+	}
+	if (*pp == NULL) {
+		pp = &lh->lh_queue;
+	}
+
+	lr = *pp;
+	*pp = lr->lr_next;
+	lr->lr_next = NULL;
+
+	lh->lh_active = lr;
+	lhd_startsector(lh);
+}
+
+/*
+ * Put a request on the queue, after any others for the same sector.
+ * Call with lh_lock held.
+ */
+static
+void
+lhd_enqueue(struct lhd_softc *lh, struct lhd_request *lr)
+{
+	struct lhd_request **pp;
+
+	pp = &lh->lh_queue;
+	while (*pp != NULL && (*pp)->lr_sector <= lr->lr_sector) {
+		pp = &(*pp)->lr_next;
+	}
+	lr->lr_next = *pp;
+	*pp = lr;
+}
+
+/*
+ * Record that a sector has completed. If reading, copy the data out
+ * of the on-card buffer. Then start the next sector, or if the
+ * request is done (or failed), finish it and start the next one.
+ * Called from the interrupt handler with lh_lock held.
  */
 static
 void
 lhd_iodone(struct lhd_softc *lh, int err)
 {
-	lh->lh_result = err;
-	V(lh->lh_done);
+	struct lhd_request *lr = lh->lh_active;
+
+	if (lr == NULL) {
+		kprintf("lhd%d: Spurious completion\n", lh->lh_unit);
+		return;
+	}
+
+	if (err == 0) {
+		if (!lr->lr_write) {
+			membar_load_load();
+			memcpy(lr->lr_buf + lr->lr_done * LHD_SECTSIZE,
+			       lh->lh_buf, LHD_SECTSIZE);
+		}
+		lr->lr_done++;
+		if (lr->lr_done < lr->lr_nsect) {
+			lhd_startsector(lh);
+			return;
+		}
+	}
+
+	lr->lr_result = err;
+	lr->lr_finished = true;
+	lh->lh_active = NULL;
+	wchan_wakeall(lh->lh_wchan, &lh->lh_lock);
+
+	lhd_start(lh);
 }
 
 /*
@@ -118,6 +257,8 @@ lhd_irq(void *vlh)
 	struct lhd_softc *lh = vlh;
 	uint32_t val;
 
+	spinlock_acquire(&lh->lh_lock);
+
 	val = lhd_rdreg(lh, LHD_REG_STAT);
 
 	switch (val & LHD_STATEMASK) {
@@ -131,6 +272,8 @@ lhd_irq(void *vlh)
 		lhd_iodone(lh, lhd_code_to_errno(lh, val));
 		break;
 	}
+
+	spinlock_release(&lh->lh_lock);
 }
 
 /*
@@ -179,6 +322,76 @@ lhd_reset(struct lhd_softc *lh)
 }
 #endif
 
+/*
+ * Set up a request for NSECT sectors at SECTOR to or from the kernel
+ * buffer BUF.
+ */
+static
+void
+lhd_initreq(struct lhd_request *lr, uint32_t sector, uint32_t nsect,
+	    char *buf, bool iswrite)
+{
+	lr->lr_sector = sector;
+	lr->lr_nsect = nsect;
+	lr->lr_done = 0;
+	lr->lr_buf = buf;
+	lr->lr_write = iswrite;
+	lr->lr_finished = false;
+	lr->lr_result = 0;
+	lr->lr_next = NULL;
+}
+
+/*
+ * Queue N requests together, so they run back to back, and wait for
+ * all of them. Returns the first error.
+ */
+static
+int
+lhd_doio(struct lhd_softc *lh, struct lhd_request *lrs, unsigned n)
+{
+	unsigned i;
+	int result;
+
+	spinlock_acquire(&lh->lh_lock);
+	for (i=0; i<n; i++) {
+		lhd_enqueue(lh, &lrs[i]);
+	}
+	lhd_start(lh);
+	result = 0;
+	for (i=0; i<n; i++) {
+		while (!lrs[i].lr_finished) {
+			wchan_sleep(lh->lh_wchan, &lh->lh_lock);
+		}
+		if (result == 0) {
+			result = lrs[i].lr_result;
+		}
+	}
+	spinlock_release(&lh->lh_lock);
+
+	return result;
+}
+
+/*
+ * Check if UIO is kernel buffers of whole sectors, which the
+ * interrupt handler can copy straight to or from.
+ */
+static
+bool
+lhd_direct(struct uio *uio)
+{
+	unsigned i;
+
+	if (uio->uio_segflg != UIO_SYSSPACE) {
+		return false;
+	}
+	for (i=0; i<uio->uio_iovcnt; i++) {
+		if (uio->uio_iov[i].iov_len % LHD_SECTSIZE != 0) {
+			return false;
+		}
+	}
+	return true;
+}
+
 /*
  * I/O function (for both reads and writes)
  */
@@ -192,8 +405,12 @@ lhd_io(struct device *d, struct uio *uio)
 	uint32_t sectoff = uio->uio_offset % LHD_SECTSIZE;
 	uint32_t len = uio->uio_resid / LHD_SECTSIZE;
 	uint32_t lenoff = uio->uio_resid % LHD_SECTSIZE;
-	uint32_t i;
-	uint32_t statval = LHD_WORKING;
+	bool iswrite = (uio->uio_rw == UIO_WRITE);
+	struct lhd_request lrs[LHD_MAXIOV];
+	struct iovec *iov;
+	uint32_t n;
+	unsigned nreqs;
+	char *bounce;
 	int result;
 
 	/* Don't allow I/O that isn't sector-aligned. */
@@ -202,66 +419,90 @@ lhd_io(struct device *d, struct uio *uio)
 	}
 
 	/* Don't allow I/O past the end of the disk. */
-	/* XXX this check can overflow */
-	if (sector+len > lh->lh_dev.d_blocks) {
+	if (sector > lh->lh_dev.d_blocks ||
+	    len > lh->lh_dev.d_blocks - sector) {
 		return EINVAL;
 	}
 
-	/* Set up the value to write into the status register. */
-	if (uio->uio_rw==UIO_WRITE) {
-		statval |= LHD_ISWRITE;
+	if (len == 0) {
+		return 0;
 	}
 
-	/* Loop over all the sectors we were asked to do. */
-	for (i=0; i<len; i++) {
-
-		/* Wait until nobody else is using the device. */
-		P(lh->lh_clear);
-
-		/*
-		 * Are we writing? If so, transfer the data to the
-		 * on-card buffer.
-		 */
-		if (uio->uio_rw == UIO_WRITE) {
-			result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
-			membar_store_store();
+	/*
+	 * Kernel buffers (as from the bio layer) get one request per
+	 * iovec, queued a batch at a time so the interrupt handler
+	 * goes from one to the next without waiting for us.
+	 */
+	if (lhd_direct(uio)) {
+		while (uio->uio_resid > 0) {
+			nreqs = 0;
+			iov = uio->uio_iov;
+			while (nreqs < LHD_MAXIOV && len > 0) {
+				KASSERT(iov < uio->uio_iov + uio->uio_iovcnt);
+				n = iov->iov_len / LHD_SECTSIZE;
+				if (n > len) {
+					n = len;
+				}
+				if (n > 0) {
+					lhd_initreq(&lrs[nreqs++], sector, n,
+						    iov->iov_kbase, iswrite);
+					sector += n;
+					len -= n;
+				}
+				iov++;
+			}
+			result = lhd_doio(lh, lrs, nreqs);
 			if (result) {
-				V(lh->lh_clear);
 				return result;
 			}
+			/* Update the uio as uiomove would have. */
+			while (uio->uio_iov < iov) {
+				n = uio->uio_iov->iov_len;
+				if (n > uio->uio_resid) {
+					n = uio->uio_resid;
+				}
+				uio->uio_iov->iov_kbase =
+					(char *)uio->uio_iov->iov_kbase + n;
+				uio->uio_iov->iov_len -= n;
+				uio->uio_offset += n;
+				uio->uio_resid -= n;
+				uio->uio_iov++;
+				uio->uio_iovcnt--;
+			}
 		}
+		return 0;
+	}
 
-		/* Tell it what sector we want... */
-		lhd_wreg(lh, LHD_REG_SECT, sector+i);
-
-		/* and start the operation. */
-		lhd_wreg(lh, LHD_REG_STAT, statval);
-
-		/* Now wait until the interrupt handler tells us we're done. */
-		P(lh->lh_done);
-
-		/* Get the result value saved by the interrupt handler. */
-		result = lh->lh_result;
-
-		/*
-		 * Are we reading? If so, and if we succeeded,
-		 * transfer the data out of the on-card buffer.
-		 */
-		if (result==0 && uio->uio_rw==UIO_READ) {
-			membar_load_load();
-			result = uiomove(lh->lh_buf, LHD_SECTSIZE, uio);
+	/* Otherwise go through a bounce buffer, a few sectors at a time. */
+	bounce = kmalloc(LHD_BOUNCESECTS * LHD_SECTSIZE);
+	if (bounce == NULL) {
+		return ENOMEM;
+	}
+	result = 0;
+	while (len > 0) {
+		n = len < LHD_BOUNCESECTS ? len : LHD_BOUNCESECTS;
+		if (iswrite) {
+			result = uiomove(bounce, n * LHD_SECTSIZE, uio);
+			if (result) {
+				break;
+			}
 		}
-
-		/* Tell another thread it's cleared to go ahead. */
-		V(lh->lh_clear);
-
-		/* If we failed, return the error. */
+		lhd_initreq(&lrs[0], sector, n, bounce, iswrite);
+		result = lhd_doio(lh, lrs, 1);
 		if (result) {
-			return result;
+			break;
+		}
+		if (!iswrite) {
+			result = uiomove(bounce, n * LHD_SECTSIZE, uio);
+			if (result) {
+				break;
+			}
 		}
+		sector += n;
+		len -= n;
 	}
-
-	return 0;
+	kfree(bounce);
+	return result;
 }
 
 static const struct device_ops lhd_devops = {
@@ -276,25 +517,25 @@ static const struct device_ops lhd_devops = {
 int
 config_lhd(struct lhd_softc *lh, int lhdno)
 {
-	char name[32];
-
-	/* Figure out what our name is. */
-	snprintf(name, sizeof(name), "lhd%d", lhdno);
+	/*
+	 * Figure out what our name is. Keep it in the softc, since
+	 * wchan_create doesn't copy it.
+	 */
+	snprintf(lh->lh_name, sizeof(lh->lh_name), "lhd%d", lhdno);
 
 	/* Get a pointer to the on-chip buffer. */
 	lh->lh_buf = bus_map_area(lh->lh_busdata, lh->lh_buspos, LHD_BUFFER);
 
-	/* Create the semaphores. */
-	lh->lh_clear = sem_create("lhd-clear", 1);
-	if (lh->lh_clear == NULL) {
-		return ENOMEM;
-	}
-	lh->lh_done = sem_create("lhd-done", 0);
-	if (lh->lh_done == NULL) {
-		sem_destroy(lh->lh_clear);
-		lh->lh_clear = NULL;
+	/* Set up the request queue. */
+	spinlock_init(&lh->lh_lock);
+	lh->lh_wchan = wchan_create(lh->lh_name);
+	if (lh->lh_wchan == NULL) {
+		spinlock_cleanup(&lh->lh_lock);
 		return ENOMEM;
 	}
+	lh->lh_queue = NULL;
+	lh->lh_active = NULL;
+	lh->lh_headpos = 0;
 
 	/* Set up the VFS device structure. */
 	lh->lh_dev.d_ops = &lhd_devops;
@@ -304,5 +545,5 @@ config_lhd(struct lhd_softc *lh, int lhdno)
 	lh->lh_dev.d_data = lh;
 
 	/* Add the VFS device structure to the VFS device list. */
-	return vfs_adddev(name, &lh->lh_dev, 1);
+	return vfs_adddev(lh->lh_name, &lh->lh_dev, 1);
 }
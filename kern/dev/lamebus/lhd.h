@@ -30,6 +30,7 @@
 #ifndef _LAMEBUS_LHD_H_
 #define _LAMEBUS_LHD_H_
 
+#include <spinlock.h>
 #include <device.h>
 
 /*
@@ -37,6 +38,8 @@
  */
 #define LHD_SECTSIZE  512
 
+struct lhd_request;	/* private to lhd.c */
+
 /*
  * Hardware device data associated with lhd (LAMEbus hard disk)
  */
@@ -50,10 +53,13 @@ struct lhd_softc {
 	 * Initialized by config_lhd
 	 */
 
+	char lh_name[16];		/* "lhdN"; names lh_wchan too */
 	void *lh_buf;			/* Pointer to on-card I/O buffer */
-	int lh_result;			/* Result from I/O operation */
-	struct semaphore *lh_clear;	/* Synchronization */
-	struct semaphore *lh_done;
+	struct spinlock lh_lock;	/* Lock for the fields below */
+	struct wchan *lh_wchan;		/* Threads waiting for requests */
+	struct lhd_request *lh_queue;	/* Waiting requests, by sector */
+	struct lhd_request *lh_active;	/* Request the disk is working on */
+	uint32_t lh_headpos;		/* Sector last started */
 
 	struct device lh_dev;		/* VFS device structure */
 };
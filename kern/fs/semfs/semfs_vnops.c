@@ -655,6 +655,7 @@ static const struct vnode_ops semfs_dirops = {
 	.vop_reclaim = semfs_reclaim,
 
 	.vop_read = vopfail_uio_isdir,
+	.vop_readahead = vopfail_readahead_ignore,
 	.vop_readlink = vopfail_uio_isdir,
 	.vop_getdirentry = semfs_getdirentry,
 	.vop_write = vopfail_uio_isdir,
@@ -688,6 +689,7 @@ static const struct vnode_ops semfs_semops = {
 	.vop_reclaim = semfs_reclaim,
 
 	.vop_read = semfs_read,
+	.vop_readahead = vopfail_readahead_ignore,
 	.vop_readlink = vopfail_uio_inval,
 	.vop_getdirentry = vopfail_uio_notdir,
 	.vop_write = semfs_write,
@@ -35,6 +35,7 @@
 #include <types.h>
 #include <lib.h>
 #include <bitmap.h>
+#include <synch.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -52,28 +53,52 @@ sfs_clearblock(struct sfs_fs *sfs, daddr_t block)
 }
 
 /*
- * Allocate a block.
+ * Allocate a block, near GOAL if possible. WANT is how many blocks
+ * the caller expects to allocate in a row (e.g. the rest of a write):
+ * if GOAL isn't free, we look for a free run at least that long, so
+ * the blocks can stay together. Nothing below the free hint is free,
+ * so if GOAL is below it (or is 0) the search starts at the hint
+ * instead, skipping the full part of the disk. The block is zeroed
+ * if CLEAR is set; a caller that's about to overwrite all of it can
+ * skip that.
  */
 int
-sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
+sfs_balloc(struct sfs_fs *sfs, daddr_t goal, unsigned want, bool clear,
+	   daddr_t *diskblock)
 {
 	int result;
 
-	result = bitmap_alloc(sfs->sfs_freemap, diskblock);
+	lock_acquire(sfs->sfs_fslock);
+	if (goal < sfs->sfs_freehint || goal >= sfs->sfs_sb.sb_nblocks) {
+		goal = sfs->sfs_freehint;
+	}
+	result = bitmap_alloc_near(sfs->sfs_freemap, goal, want, diskblock);
 	if (result) {
+		lock_release(sfs->sfs_fslock);
 		return result;
 	}
+	if (*diskblock == sfs->sfs_freehint) {
+		sfs->sfs_freehint++;
+	}
 	sfs->sfs_freemapdirty = true;
+	lock_release(sfs->sfs_fslock);
 
 	if (*diskblock >= sfs->sfs_sb.sb_nblocks) {
 		panic("sfs: %s: balloc: invalid block %u\n",
 		      sfs->sfs_sb.sb_volname, *diskblock);
 	}
 
-	/* Clear block before returning it */
+	if (!clear) {
+		return 0;
+	}
+
+	/*
+	 * Clear block before returning it. The block is ours now, so
+	 * this doesn't need the lock.
+	 */
 	result = sfs_clearblock(sfs, *diskblock);
 	if (result) {
-		bitmap_unmark(sfs->sfs_freemap, *diskblock);
+		sfs_bfree(sfs, *diskblock);
 	}
 	return result;
 }
@@ -84,8 +109,13 @@ sfs_balloc(struct sfs_fs *sfs, daddr_t *diskblock)
 void
 sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock)
 {
+	lock_acquire(sfs->sfs_fslock);
 	bitmap_unmark(sfs->sfs_freemap, diskblock);
+	if (diskblock < sfs->sfs_freehint) {
+		sfs->sfs_freehint = diskblock;
+	}
 	sfs->sfs_freemapdirty = true;
+	lock_release(sfs->sfs_fslock);
 }
 
 /*
@@ -94,10 +124,15 @@ sfs_bfree(struct sfs_fs *sfs, daddr_t diskblock)
 int
 sfs_bused(struct sfs_fs *sfs, daddr_t diskblock)
 {
+	int ret;
+
 	if (diskblock >= sfs->sfs_sb.sb_nblocks) {
 		panic("sfs: %s: sfs_bused called on out of range block %u\n",
 		      sfs->sfs_sb.sb_volname, diskblock);
 	}
-	return bitmap_isset(sfs->sfs_freemap, diskblock);
+	lock_acquire(sfs->sfs_fslock);
+	ret = bitmap_isset(sfs->sfs_freemap, diskblock);
+	lock_release(sfs->sfs_fslock);
+	return ret;
 }
 
@@ -35,39 +35,47 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
-#include <vfs.h>
+#include <synch.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
 /*
- * Look up the disk block number (from 0 up to the number of blocks on
- * the disk) given a file and the logical block number within that
- * file. If DOALLOC is set, and no such block exists, one will be
- * allocated.
+ * Where to put a new block for FILEBLOCK, given PREV, the disk block
+ * of the file block before it (or 0): right after PREV, or if there
+ * isn't one, right after the inode.
  */
-int
-sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
-	 daddr_t *diskblock)
+static
+daddr_t
+sfs_bmap_goal(struct sfs_vnode *sv, daddr_t prev)
 {
-	/*
-	 * I/O buffer for handling indirect blocks.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	return (prev != 0 ? prev : sv->sv_ino) + 1;
+}
 
+/*
+ * Common code for sfs_bmap and sfs_bmapfill. If DOALLOC is set and
+ * there's no block, allocate one (WANT and CLEAR are passed to
+ * sfs_balloc), and set *ISNEW if ISNEW isn't null.
+ */
+static
+int
+sfs_bmap_common(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
+		unsigned want, bool clear, daddr_t *diskblock, bool *isnew)
+{
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
-	daddr_t block;
+	struct buf *idbuf;
+	uint32_t *idptrs;
+	daddr_t block, prev;
 	daddr_t idblock;
 	uint32_t idnum, idoff;
 	int result;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
+	COMPILE_ASSERT(SFS_DBPERIDB * sizeof(uint32_t) == SFS_BLOCKSIZE);
+	KASSERT(!doalloc || rwlock_do_i_hold_write(sv->sv_lock));
 
-	/* Since we're using a static buffer, we'd better be locked. */
-	KASSERT(vfs_biglock_do_i_hold());
+	if (isnew != NULL) {
+		*isnew = false;
+	}
 
 	/*
 	 * If the block we want is one of the direct blocks...
@@ -82,7 +90,10 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		 * Do we need to allocate?
 		 */
 		if (block==0 && doalloc) {
-			result = sfs_balloc(sfs, &block);
+			prev = fileblock > 0 ?
+				sv->sv_i.sfi_direct[fileblock - 1] : 0;
+			result = sfs_balloc(sfs, sfs_bmap_goal(sv, prev),
+					    want, clear, &block);
 			if (result) {
 				return result;
 			}
@@ -90,6 +101,9 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 			/* Remember what we allocated; mark inode dirty */
 			sv->sv_i.sfi_direct[fileblock] = block;
 			sv->sv_dirty = true;
+			if (isnew != NULL) {
+				*isnew = true;
+			}
 		}
 
 		/*
@@ -141,9 +155,12 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		 * There's no indirect block allocated, but we need to
 		 * allocate a block whose number needs to be stored in
 		 * the indirect block. Thus, we need to allocate an
-		 * indirect block.
+		 * indirect block. Put it after the last direct block,
+		 * and ask for room for the data after it too.
 		 */
-		result = sfs_balloc(sfs, &idblock);
+		prev = sv->sv_i.sfi_direct[SFS_NDIRECT - 1];
+		result = sfs_balloc(sfs, sfs_bmap_goal(sv, prev), want + 1,
+				    true, &idblock);
 		if (result) {
 			return result;
 		}
@@ -154,38 +171,39 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 		/* Mark the inode dirty */
 		sv->sv_dirty = true;
 
-		/* Clear the indirect block buffer */
-		bzero(idbuf, sizeof(idbuf));
+		/* sfs_balloc zeroed it, so it's already an empty block. */
 	}
-	else {
-		/*
-		 * We already have an indirect block allocated; load it.
-		 */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
-		if (result) {
-			return result;
-		}
+
+	/*
+	 * Get the indirect block from the buffer cache.
+	 */
+	result = buf_read(sfs->sfs_device, idblock, &idbuf);
+	if (result) {
+		return result;
 	}
+	idptrs = idbuf->b_data;
 
-	/* Get the block out of the indirect block buffer */
-	block = idbuf[idoff];
+	/* Get the block out of the indirect block */
+	block = idptrs[idoff];
 
 	/* If there's no block there, allocate one */
 	if (block==0 && doalloc) {
-		result = sfs_balloc(sfs, &block);
+		prev = idoff > 0 ? idptrs[idoff - 1] : idblock;
+		result = sfs_balloc(sfs, sfs_bmap_goal(sv, prev), want, clear,
+				    &block);
 		if (result) {
+			buf_release(idbuf);
 			return result;
 		}
 
-		/* Remember the block we allocated */
-		idbuf[idoff] = block;
-
-		/* The indirect block is now dirty; write it back */
-		result = sfs_writeblock(sfs, idblock, idbuf, sizeof(idbuf));
-		if (result) {
-			return result;
+		/* Remember the block we allocated; the block is now dirty */
+		idptrs[idoff] = block;
+		buf_markdirty(idbuf);
+		if (isnew != NULL) {
+			*isnew = true;
 		}
 	}
+	buf_release(idbuf);
 
 	/* Hand back the result and return. */
 	if (block != 0 && !sfs_bused(sfs, block)) {
@@ -198,21 +216,48 @@ sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
 }
 
 /*
- * Called for ftruncate() and from sfs_reclaim.
+ * Look up the disk block number (from 0 up to the number of blocks on
+ * the disk) given a file and the logical block number within that
+ * file. If DOALLOC is set, and no such block exists, one will be
+ * allocated (and zeroed), near the file's previous block if possible.
+ *
+ * Call with the vnode locked; exclusively if DOALLOC is set.
  */
 int
-sfs_itrunc(struct sfs_vnode *sv, off_t len)
+sfs_bmap(struct sfs_vnode *sv, uint32_t fileblock, bool doalloc,
+	 daddr_t *diskblock)
 {
-	/*
-	 * I/O buffer for handling the indirect block.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static uint32_t idbuf[SFS_DBPERIDB];
+	return sfs_bmap_common(sv, fileblock, doalloc, 1, true, diskblock,
+			       NULL);
+}
 
+/*
+ * Like sfs_bmap with DOALLOC set, for a caller that's about to write
+ * the whole block: a new block isn't zeroed, and *ISNEW says whether
+ * the block is new, so that the caller can clean up if the write
+ * fails. WANT is how many blocks (this one included) the caller is
+ * about to write, for sfs_balloc.
+ *
+ * Call with the vnode locked exclusively.
+ */
+int
+sfs_bmapfill(struct sfs_vnode *sv, uint32_t fileblock, unsigned want,
+	     daddr_t *diskblock, bool *isnew)
+{
+	return sfs_bmap_common(sv, fileblock, true, want, false, diskblock,
+			       isnew);
+}
+
+/*
+ * Called for ftruncate() and from sfs_reclaim, with the vnode locked
+ * exclusively.
+ */
+int
+sfs_itrunc(struct sfs_vnode *sv, off_t len)
+{
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *idbuf;
+	uint32_t *idptrs;
 
 	/* Length in blocks (divide rounding up) */
 	uint32_t blocklen = DIVROUNDUP(len, SFS_BLOCKSIZE);
@@ -223,9 +268,7 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	int result;
 	int hasnonzero, iddirty;
 
-	KASSERT(sizeof(idbuf)==SFS_BLOCKSIZE);
-
-	vfs_biglock_acquire();
+	KASSERT(rwlock_do_i_hold_write(sv->sv_lock));
 
 	/*
 	 * Go through the direct blocks. Discard any that are
@@ -252,43 +295,40 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	if (blocklen < highblock && idblock != 0) {
 		/* We're past the proposed EOF; may need to free stuff */
 
-		/* Read the indirect block */
-		result = sfs_readblock(sfs, idblock, idbuf, sizeof(idbuf));
+		/* Get the indirect block */
+		result = buf_read(sfs->sfs_device, idblock, &idbuf);
 		if (result) {
-			vfs_biglock_release();
 			return result;
 		}
+		idptrs = idbuf->b_data;
 
 		hasnonzero = 0;
 		iddirty = 0;
 		for (j=0; j<SFS_DBPERIDB; j++) {
 			/* Discard any blocks that are past the new EOF */
-			if (blocklen < baseblock+j && idbuf[j] != 0) {
-				sfs_bfree(sfs, idbuf[j]);
-				idbuf[j] = 0;
+			if (blocklen < baseblock+j && idptrs[j] != 0) {
+				sfs_bfree(sfs, idptrs[j]);
+				idptrs[j] = 0;
 				iddirty = 1;
 			}
 			/* Remember if we see any nonzero blocks in here */
-			if (idbuf[j]!=0) {
+			if (idptrs[j]!=0) {
 				hasnonzero=1;
 			}
 		}
 
+		/* If the indirect block changed, it needs writing back */
+		if (iddirty) {
+			buf_markdirty(idbuf);
+		}
+		buf_release(idbuf);
+
 		if (!hasnonzero) {
 			/* The whole indirect block is empty now; free it */
 			sfs_bfree(sfs, idblock);
 			sv->sv_i.sfi_indirect = 0;
 			sv->sv_dirty = true;
 		}
-		else if (iddirty) {
-			/* The indirect block is dirty; write it back */
-			result = sfs_writeblock(sfs, idblock, idbuf,
-						sizeof(idbuf));
-			if (result) {
-				vfs_biglock_release();
-				return result;
-			}
-		}
 	}
 
 	/* Set the file size */
@@ -297,7 +337,6 @@ sfs_itrunc(struct sfs_vnode *sv, off_t len)
 	/* Mark the inode dirty */
 	sv->sv_dirty = true;
 
-	vfs_biglock_release();
 	return 0;
 }
 
@@ -35,6 +35,7 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
 #include <sfs.h>
 #include "sfsprivate.h"
@@ -95,14 +96,361 @@ sfs_dir_nentries(struct sfs_vnode *sv)
 	return size / sizeof(struct sfs_direntry);
 }
 
+////////////////////////////////////////////////////////////
+// Name hash
+
 /*
- * Search a directory for a particular filename in a directory, and
- * return its inode number, its slot, and/or the slot number of an
- * empty directory slot if one is found.
+ * In-memory name hash for a directory.
+ *
+ * The first lookup in a directory reads all of it and hashes the
+ * names, so that later lookups don't read the directory at all. It
+ * also keeps a list of the free slots, so sfs_dir_link can reuse one
+ * without searching. sfs_dir_link and sfs_dir_unlink keep both up to
+ * date, and the hash stays until the vnode is reclaimed.
+ *
+ * The hash is covered by the directory's sv_lock and only changed
+ * with it held exclusive. A lookup holding it shared may build the
+ * hash, though, so two lookups can each build one; the first to
+ * install its copy (under sfs_vnlock) wins, and the other throws its
+ * copy away.
+ *
+ * If there isn't memory for the hash, we go back to reading the
+ * directory.
+ */
+
+#define SFS_DIRHASH_MINBUCKETS	16
+#define SFS_DIRHASH_MAXBUCKETS	512	/* keeps the table within 2K */
+
+struct sfs_dirslot {
+	struct sfs_dirslot *ds_next;	/* hash chain, or free list */
+	char *ds_name;			/* NULL if the slot is free */
+	uint32_t ds_hash;		/* hash of ds_name */
+	uint32_t ds_ino;		/* inode number */
+	int ds_slot;			/* slot in the directory */
+};
+
+struct sfs_dirhash {
+	struct sfs_dirslot **dh_buckets;
+	unsigned dh_nbuckets;		/* always a power of 2 */
+	unsigned dh_count;		/* names in the table */
+	struct sfs_dirslot *dh_free;	/* free slots */
+};
+
+/*
+ * FNV-1a.
+ */
+static
+uint32_t
+sfs_dirhash_name(const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	while (*name != 0) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	return h;
+}
+
+static
+struct sfs_dirslot **
+sfs_dirhash_bucket(struct sfs_dirhash *dh, uint32_t hash)
+{
+	return &dh->dh_buckets[hash & (dh->dh_nbuckets - 1)];
+}
+
+static
+struct sfs_dirslot *
+sfs_dirhash_find(struct sfs_dirhash *dh, const char *name, uint32_t hash)
+{
+	struct sfs_dirslot *ds;
+
+	for (ds = *sfs_dirhash_bucket(dh, hash); ds != NULL; ds = ds->ds_next) {
+		if (ds->ds_hash == hash && !strcmp(ds->ds_name, name)) {
+			return ds;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+sfs_dirhash_insert(struct sfs_dirhash *dh, struct sfs_dirslot *ds)
+{
+	struct sfs_dirslot **bucket;
+
+	bucket = sfs_dirhash_bucket(dh, ds->ds_hash);
+	ds->ds_next = *bucket;
+	*bucket = ds;
+	dh->dh_count++;
+}
+
+static
+void
+sfs_dirhash_remove(struct sfs_dirhash *dh, struct sfs_dirslot *ds)
+{
+	struct sfs_dirslot **pp;
+
+	pp = sfs_dirhash_bucket(dh, ds->ds_hash);
+	while (*pp != ds) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->ds_next;
+	}
+	*pp = ds->ds_next;
+	ds->ds_next = NULL;
+	dh->dh_count--;
+}
+
+/*
+ * Create an empty hash table with room for about COUNT names.
  */
+static
+struct sfs_dirhash *
+sfs_dirhash_create(unsigned count)
+{
+	struct sfs_dirhash *dh;
+	unsigned i;
+
+	dh = kmalloc(sizeof(*dh));
+	if (dh == NULL) {
+		return NULL;
+	}
+	dh->dh_nbuckets = SFS_DIRHASH_MINBUCKETS;
+	while (dh->dh_nbuckets < count &&
+	       dh->dh_nbuckets < SFS_DIRHASH_MAXBUCKETS) {
+		dh->dh_nbuckets *= 2;
+	}
+	dh->dh_buckets = kmalloc(dh->dh_nbuckets * sizeof(dh->dh_buckets[0]));
+	if (dh->dh_buckets == NULL) {
+		kfree(dh);
+		return NULL;
+	}
+	for (i=0; i<dh->dh_nbuckets; i++) {
+		dh->dh_buckets[i] = NULL;
+	}
+	dh->dh_count = 0;
+	dh->dh_free = NULL;
+	return dh;
+}
+
+static
+void
+sfs_dirhash_freeslot(struct sfs_dirslot *ds)
+{
+	if (ds->ds_name != NULL) {
+		kfree(ds->ds_name);
+	}
+	kfree(ds);
+}
+
+static
+void
+sfs_dirhash_free(struct sfs_dirhash *dh)
+{
+	struct sfs_dirslot *ds;
+	unsigned i;
+
+	for (i=0; i<dh->dh_nbuckets; i++) {
+		while ((ds = dh->dh_buckets[i]) != NULL) {
+			dh->dh_buckets[i] = ds->ds_next;
+			sfs_dirhash_freeslot(ds);
+		}
+	}
+	while ((ds = dh->dh_free) != NULL) {
+		dh->dh_free = ds->ds_next;
+		sfs_dirhash_freeslot(ds);
+	}
+	kfree(dh->dh_buckets);
+	kfree(dh);
+}
+
+/*
+ * Double the number of buckets if the chains are getting long. If
+ * there's no memory for a bigger table, keep the old one.
+ */
+static
+void
+sfs_dirhash_grow(struct sfs_dirhash *dh)
+{
+	struct sfs_dirslot **old, *ds;
+	unsigned oldn, i;
+
+	if (dh->dh_count <= 2 * dh->dh_nbuckets ||
+	    dh->dh_nbuckets >= SFS_DIRHASH_MAXBUCKETS) {
+		return;
+	}
+
+	old = dh->dh_buckets;
+	oldn = dh->dh_nbuckets;
+	dh->dh_buckets = kmalloc(2 * oldn * sizeof(dh->dh_buckets[0]));
+	if (dh->dh_buckets == NULL) {
+		dh->dh_buckets = old;
+		return;
+	}
+	dh->dh_nbuckets = 2 * oldn;
+	for (i=0; i<dh->dh_nbuckets; i++) {
+		dh->dh_buckets[i] = NULL;
+	}
+
+	dh->dh_count = 0;
+	for (i=0; i<oldn; i++) {
+		while ((ds = old[i]) != NULL) {
+			old[i] = ds->ds_next;
+			sfs_dirhash_insert(dh, ds);
+		}
+	}
+	kfree(old);
+}
+
+/*
+ * Read the whole directory and build its hash. Returns ENOMEM if
+ * there isn't memory for it, in which case the caller can scan the
+ * directory instead.
+ */
+static
 int
-sfs_dir_findname(struct sfs_vnode *sv, const char *name,
-		uint32_t *ino, int *slot, int *emptyslot)
+sfs_dirhash_build(struct sfs_vnode *sv, struct sfs_dirhash **ret)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_direntry *sds;
+	struct sfs_dirhash *dh;
+	struct sfs_dirslot *ds;
+	int nentries, perblock, slot, n, i, result;
+
+	nentries = sfs_dir_nentries(sv);
+	perblock = SFS_BLOCKSIZE / sizeof(struct sfs_direntry);
+
+	dh = sfs_dirhash_create(nentries);
+	if (dh == NULL) {
+		return ENOMEM;
+	}
+	sds = kmalloc(SFS_BLOCKSIZE);
+	if (sds == NULL) {
+		sfs_dirhash_free(dh);
+		return ENOMEM;
+	}
+
+	/* Read a block's worth of entries at a time. */
+	for (slot = 0; slot < nentries; slot += perblock) {
+		n = nentries - slot;
+		if (n > perblock) {
+			n = perblock;
+		}
+		result = sfs_metaio(sv, slot * sizeof(struct sfs_direntry),
+				    sds, n * sizeof(struct sfs_direntry),
+				    UIO_READ);
+		if (result) {
+			goto fail;
+		}
+
+		for (i=0; i<n; i++) {
+			ds = kmalloc(sizeof(*ds));
+			if (ds == NULL) {
+				result = ENOMEM;
+				goto fail;
+			}
+			ds->ds_slot = slot + i;
+			ds->ds_ino = sds[i].sfd_ino;
+
+			if (ds->ds_ino == SFS_NOINO) {
+				ds->ds_name = NULL;
+				ds->ds_next = dh->dh_free;
+				dh->dh_free = ds;
+				continue;
+			}
+
+			/* Ensure null termination, just in case */
+			sds[i].sfd_name[sizeof(sds[i].sfd_name)-1] = 0;
+			ds->ds_name = kstrdup(sds[i].sfd_name);
+			if (ds->ds_name == NULL) {
+				kfree(ds);
+				result = ENOMEM;
+				goto fail;
+			}
+			ds->ds_hash = sfs_dirhash_name(ds->ds_name);
+
+			/* Each name may legally appear only once... */
+			if (sfs_dirhash_find(dh, ds->ds_name,
+					     ds->ds_hash) != NULL) {
+				panic("sfs: %s: directory %u: Duplicate "
+				      "name %s\n", sfs->sfs_sb.sb_volname,
+				      sv->sv_ino, ds->ds_name);
+			}
+			sfs_dirhash_insert(dh, ds);
+		}
+	}
+
+	kfree(sds);
+	*ret = dh;
+	return 0;
+
+ fail:
+	kfree(sds);
+	sfs_dirhash_free(dh);
+	return result;
+}
+
+/*
+ * Get the directory's hash, building it if need be. Returns ENOMEM
+ * if there's no memory for it.
+ */
+static
+int
+sfs_dirhash_get(struct sfs_vnode *sv, struct sfs_dirhash **ret)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct sfs_dirhash *dh;
+	int result;
+
+	if (sv->sv_dirhash != NULL) {
+		*ret = sv->sv_dirhash;
+		return 0;
+	}
+
+	result = sfs_dirhash_build(sv, &dh);
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(sfs->sfs_vnlock);
+	if (sv->sv_dirhash == NULL) {
+		sv->sv_dirhash = dh;
+		dh = NULL;
+	}
+	lock_release(sfs->sfs_vnlock);
+
+	if (dh != NULL) {
+		/* Someone else got there first. */
+		sfs_dirhash_free(dh);
+	}
+	*ret = sv->sv_dirhash;
+	return 0;
+}
+
+/*
+ * Throw away the directory's hash. Called when the vnode is
+ * reclaimed, and if the hash can't be kept up to date.
+ */
+void
+sfs_dirhash_destroy(struct sfs_vnode *sv)
+{
+	if (sv->sv_dirhash != NULL) {
+		sfs_dirhash_free(sv->sv_dirhash);
+		sv->sv_dirhash = NULL;
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Directory operations
+
+/*
+ * Search a directory for a name by reading every slot. This is the
+ * fallback when there's no hash.
+ */
+static
+int
+sfs_dir_scan(struct sfs_vnode *sv, const char *name,
+	     uint32_t *ino, int *slot, int *emptyslot)
 {
 	struct sfs_direntry tsd;
 	int found, nentries, i, result;
@@ -146,6 +494,47 @@ sfs_dir_findname(struct sfs_vnode *sv, const char *name,
 	return found ? 0 : ENOENT;
 }
 
+/*
+ * Search a directory for a particular filename in a directory, and
+ * return its inode number, its slot, and/or the slot number of an
+ * empty directory slot if one is found.
+ *
+ * The directory functions here expect the directory to be locked;
+ * exclusively for sfs_dir_link and sfs_dir_unlink.
+ */
+int
+sfs_dir_findname(struct sfs_vnode *sv, const char *name,
+		uint32_t *ino, int *slot, int *emptyslot)
+{
+	struct sfs_dirhash *dh;
+	struct sfs_dirslot *ds;
+	int result;
+
+	result = sfs_dirhash_get(sv, &dh);
+	if (result == ENOMEM) {
+		return sfs_dir_scan(sv, name, ino, slot, emptyslot);
+	}
+	if (result) {
+		return result;
+	}
+
+	if (emptyslot != NULL && dh->dh_free != NULL) {
+		*emptyslot = dh->dh_free->ds_slot;
+	}
+
+	ds = sfs_dirhash_find(dh, name, sfs_dirhash_name(name));
+	if (ds == NULL) {
+		return ENOENT;
+	}
+	if (slot != NULL) {
+		*slot = ds->ds_slot;
+	}
+	if (ino != NULL) {
+		*ino = ds->ds_ino;
+	}
+	return 0;
+}
+
 /*
  * Create a link in a directory to the specified inode by number, with
  * the specified name, and optionally hand back the slot.
@@ -156,6 +545,9 @@ sfs_dir_link(struct sfs_vnode *sv, const char *name, uint32_t ino, int *slot)
 	int emptyslot = -1;
 	int result;
 	struct sfs_direntry sd;
+	struct sfs_dirhash *dh;
+	struct sfs_dirslot *ds;
+	char *dsname;
 
 	/* Look up the name. We want to make sure it *doesn't* exist. */
 	result = sfs_dir_findname(sv, name, NULL, NULL, &emptyslot);
@@ -170,6 +562,37 @@ sfs_dir_link(struct sfs_vnode *sv, const char *name, uint32_t ino, int *slot)
 		return ENAMETOOLONG;
 	}
 
+	/*
+	 * Get the hash entry for the slot before writing, so running
+	 * out of memory doesn't leave the hash out of date. If we
+	 * can't, drop the hash; the next lookup builds a new one.
+	 */
+	dh = sv->sv_dirhash;
+	ds = NULL;
+	dsname = NULL;
+	if (dh != NULL) {
+		/* sfs_dir_findname gave us the first free slot, if any */
+		ds = dh->dh_free;
+		if (ds != NULL) {
+			KASSERT(ds->ds_slot == emptyslot);
+		}
+		else {
+			ds = kmalloc(sizeof(*ds));
+		}
+		dsname = kstrdup(name);
+		if (ds == NULL || dsname == NULL) {
+			if (ds != NULL && ds != dh->dh_free) {
+				kfree(ds);
+			}
+			if (dsname != NULL) {
+				kfree(dsname);
+			}
+			sfs_dirhash_destroy(sv);
+			dh = NULL;
+			ds = NULL;
+		}
+	}
+
 	/* If we didn't get an empty slot, add the entry at the end. */
 	if (emptyslot < 0) {
 		emptyslot = sfs_dir_nentries(sv);
@@ -186,23 +609,67 @@ sfs_dir_link(struct sfs_vnode *sv, const char *name, uint32_t ino, int *slot)
 	}
 
 	/* Write the entry. */
-	return sfs_writedir(sv, emptyslot, &sd);
+	result = sfs_writedir(sv, emptyslot, &sd);
+	if (result) {
+		if (dh != NULL) {
+			if (ds != dh->dh_free) {
+				kfree(ds);
+			}
+			kfree(dsname);
+		}
+		return result;
+	}
+
+	/* Record it in the hash. */
+	if (dh != NULL) {
+		if (ds == dh->dh_free) {
+			dh->dh_free = ds->ds_next;
+		}
+		ds->ds_name = dsname;
+		ds->ds_slot = emptyslot;
+		ds->ds_ino = ino;
+		ds->ds_hash = sfs_dirhash_name(name);
+		sfs_dirhash_insert(dh, ds);
+		sfs_dirhash_grow(dh);
+	}
+	return 0;
 }
 
 /*
- * Unlink a name in a directory, by slot number.
+ * Unlink a name in a directory, by slot number. NAME is the name in
+ * that slot, for finding it in the hash.
  */
 int
-sfs_dir_unlink(struct sfs_vnode *sv, int slot)
+sfs_dir_unlink(struct sfs_vnode *sv, const char *name, int slot)
 {
 	struct sfs_direntry sd;
+	struct sfs_dirhash *dh;
+	struct sfs_dirslot *ds;
+	int result;
 
 	/* Initialize a suitable directory entry... */
 	bzero(&sd, sizeof(sd));
 	sd.sfd_ino = SFS_NOINO;
 
 	/* ... and write it */
-	return sfs_writedir(sv, slot, &sd);
+	result = sfs_writedir(sv, slot, &sd);
+	if (result) {
+		return result;
+	}
+
+	/* Move the slot to the free list. */
+	dh = sv->sv_dirhash;
+	if (dh != NULL) {
+		ds = sfs_dirhash_find(dh, name, sfs_dirhash_name(name));
+		KASSERT(ds != NULL && ds->ds_slot == slot);
+		sfs_dirhash_remove(dh, ds);
+		kfree(ds->ds_name);
+		ds->ds_name = NULL;
+		ds->ds_ino = SFS_NOINO;
+		ds->ds_next = dh->dh_free;
+		dh->dh_free = ds;
+	}
+	return 0;
 }
 
 /*
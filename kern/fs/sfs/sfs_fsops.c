@@ -39,8 +39,10 @@
 #include <array.h>
 #include <bitmap.h>
 #include <uio.h>
+#include <synch.h>
 #include <vfs.h>
 #include <device.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -112,14 +114,56 @@ static
 int
 sfs_sync_vnodes(struct sfs_fs *sfs)
 {
-	unsigned i, num;
+	struct vnodearray *vnodes;
+	struct vnode *v;
+	struct sfs_vnode *sv;
+	unsigned i, j, num;
+	int result;
+
+	/*
+	 * Take a reference to each loaded vnode, so we can lock them
+	 * one at a time without holding the table lock (which comes
+	 * after vnode locks in the lock order).
+	 */
+	vnodes = vnodearray_create();
+	if (vnodes == NULL) {
+		return ENOMEM;
+	}
+	lock_acquire(sfs->sfs_vnlock);
+	num = sfs->sfs_nvnodes;
+	result = vnodearray_setsize(vnodes, num);
+	if (result) {
+		lock_release(sfs->sfs_vnlock);
+		vnodearray_destroy(vnodes);
+		return result;
+	}
+	i = 0;
+	for (j=0; j<SFS_VNHASHSIZE; j++) {
+		for (sv = sfs->sfs_vntable[j]; sv != NULL;
+		     sv = sv->sv_hashnext) {
+			v = &sv->sv_absvn;
+			VOP_INCREF(v);
+			vnodearray_set(vnodes, i++, v);
+		}
+	}
+	KASSERT(i == num);
+	lock_release(sfs->sfs_vnlock);
 
-	/* Go over the array of loaded vnodes, syncing as we go. */
-	num = vnodearray_num(sfs->sfs_vnodes);
+	/*
+	 * Sync each one. This only puts the inodes in the buffer
+	 * cache; sfs_sync flushes them to disk with everything else.
+	 */
 	for (i=0; i<num; i++) {
-		struct vnode *v = vnodearray_get(sfs->sfs_vnodes, i);
-		VOP_FSYNC(v);
+		v = vnodearray_get(vnodes, i);
+		sv = v->vn_data;
+		rwlock_acquire_write(sv->sv_lock);
+		sfs_sync_inode(sv);
+		rwlock_release_write(sv->sv_lock);
+		VOP_DECREF(v);
 	}
+
+	vnodearray_setsize(vnodes, 0);
+	vnodearray_destroy(vnodes);
 	return 0;
 }
 
@@ -132,13 +176,16 @@ sfs_sync_freemap(struct sfs_fs *sfs)
 {
 	int result;
 
+	lock_acquire(sfs->sfs_fslock);
 	if (sfs->sfs_freemapdirty) {
 		result = sfs_freemapio(sfs, UIO_WRITE);
 		if (result) {
+			lock_release(sfs->sfs_fslock);
 			return result;
 		}
 		sfs->sfs_freemapdirty = false;
 	}
+	lock_release(sfs->sfs_fslock);
 
 	return 0;
 }
@@ -152,14 +199,17 @@ sfs_sync_superblock(struct sfs_fs *sfs)
 {
 	int result;
 
+	lock_acquire(sfs->sfs_fslock);
 	if (sfs->sfs_superdirty) {
 		result = sfs_writeblock(sfs, SFS_SUPER_BLOCK, &sfs->sfs_sb,
 					sizeof(sfs->sfs_sb));
 		if (result) {
+			lock_release(sfs->sfs_fslock);
 			return result;
 		}
 		sfs->sfs_superdirty = false;
 	}
+	lock_release(sfs->sfs_fslock);
 	return 0;
 }
 
@@ -174,8 +224,6 @@ sfs_sync(struct fs *fs)
 	struct sfs_fs *sfs;
 	int result;
 
-	vfs_biglock_acquire();
-
 	/*
 	 * Get the sfs_fs from the generic abstract fs.
 	 *
@@ -211,25 +259,27 @@ sfs_sync(struct fs *fs)
 	/* If any vnodes need to be written, write them. */
 	result = sfs_sync_vnodes(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	/* If the free block map needs to be written, write it. */
 	result = sfs_sync_freemap(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	/* If the superblock needs to be written, write it. */
 	result = sfs_sync_superblock(sfs);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
-	vfs_biglock_release();
+	/* All of the above went into the buffer cache; write it out. */
+	result = buf_flush(sfs->sfs_device);
+	if (result) {
+		return result;
+	}
+
 	return 0;
 }
 
@@ -243,13 +293,9 @@ const char *
 sfs_getvolname(struct fs *fs)
 {
 	struct sfs_fs *sfs = fs->fs_data;
-	const char *ret;
-
-	vfs_biglock_acquire();
-	ret = sfs->sfs_sb.sb_volname;
-	vfs_biglock_release();
 
-	return ret;
+	/* This never changes while we're mounted. */
+	return sfs->sfs_sb.sb_volname;
 }
 
 /*
@@ -262,7 +308,9 @@ sfs_fs_destroy(struct sfs_fs *sfs)
 	if (sfs->sfs_freemap != NULL) {
 		bitmap_destroy(sfs->sfs_freemap);
 	}
-	vnodearray_destroy(sfs->sfs_vnodes);
+	KASSERT(sfs->sfs_nvnodes == 0);
+	lock_destroy(sfs->sfs_vnlock);
+	lock_destroy(sfs->sfs_fslock);
 	KASSERT(sfs->sfs_device == NULL);
 	kfree(sfs);
 }
@@ -270,26 +318,43 @@ sfs_fs_destroy(struct sfs_fs *sfs)
 /*
  * Unmount code.
  *
- * VFS calls FS_SYNC on the filesystem prior to unmounting it.
+ * VFS calls FS_SYNC on the filesystem prior to unmounting it. It
+ * also holds the mount table locked, so nobody can get a new vnode
+ * from us while we're doing this.
  */
 static
 int
 sfs_unmount(struct fs *fs)
 {
 	struct sfs_fs *sfs = fs->fs_data;
+	int result;
 
-	vfs_biglock_acquire();
-
-	/* Do we have any files open? If so, can't unmount. */
-	if (vnodearray_num(sfs->sfs_vnodes) > 0) {
-		vfs_biglock_release();
+	/*
+	 * Do we have any files open? If so, can't unmount. Otherwise,
+	 * throw away the cached vnodes; they were just synced.
+	 */
+	lock_acquire(sfs->sfs_vnlock);
+	if (sfs->sfs_nvnodes > sfs->sfs_ncached) {
+		lock_release(sfs->sfs_vnlock);
 		return EBUSY;
 	}
+	sfs_vntrim(sfs, 0);
+	if (sfs->sfs_nvnodes > 0) {
+		lock_release(sfs->sfs_vnlock);
+		return EBUSY;
+	}
+	lock_release(sfs->sfs_vnlock);
 
 	/* We should have just had sfs_sync called. */
 	KASSERT(sfs->sfs_superdirty == false);
 	KASSERT(sfs->sfs_freemapdirty == false);
 
+	/* Get our blocks out of the buffer cache. */
+	result = buf_invalidate(sfs->sfs_device);
+	if (result) {
+		return result;
+	}
+
 	/* The vfs layer takes care of the device for us */
 	sfs->sfs_device = NULL;
 
@@ -297,7 +362,6 @@ sfs_unmount(struct fs *fs)
 	sfs_fs_destroy(sfs);
 
 	/* nothing else to do */
-	vfs_biglock_release();
 	return 0;
 }
 
@@ -321,6 +385,7 @@ struct sfs_fs *
 sfs_fs_create(void)
 {
 	struct sfs_fs *sfs;
+	unsigned i;
 
 	/*
 	 * Make sure our on-disk structures aren't messed up
@@ -328,6 +393,7 @@ sfs_fs_create(void)
 	COMPILE_ASSERT(sizeof(struct sfs_superblock)==SFS_BLOCKSIZE);
 	COMPILE_ASSERT(sizeof(struct sfs_dinode)==SFS_BLOCKSIZE);
 	COMPILE_ASSERT(SFS_BLOCKSIZE % sizeof(struct sfs_direntry) == 0);
+	COMPILE_ASSERT(SFS_BLOCKSIZE == BUF_BLOCKSIZE);
 
 	/* Allocate object */
 	sfs = kmalloc(sizeof(struct sfs_fs));
@@ -343,6 +409,12 @@ sfs_fs_create(void)
 	sfs->sfs_absfs.fs_data = sfs;
 	sfs->sfs_absfs.fs_ops = &sfs_fsops;
 
+	/* lock for freemap and superblock */
+	sfs->sfs_fslock = lock_create("sfs_fslock");
+	if (sfs->sfs_fslock == NULL) {
+		goto cleanup_object;
+	}
+
 	/* superblock */
 	/* (ignore sfs_super, we'll read in over it shortly) */
 	sfs->sfs_superdirty = false;
@@ -351,17 +423,26 @@ sfs_fs_create(void)
 	sfs->sfs_device = NULL;
 
 	/* vnode table */
-	sfs->sfs_vnodes = vnodearray_create();
-	if (sfs->sfs_vnodes == NULL) {
-		goto cleanup_object;
+	sfs->sfs_vnlock = lock_create("sfs_vnlock");
+	if (sfs->sfs_vnlock == NULL) {
+		goto cleanup_fslock;
+	}
+	for (i=0; i<SFS_VNHASHSIZE; i++) {
+		sfs->sfs_vntable[i] = NULL;
 	}
+	sfs->sfs_nvnodes = 0;
+	sfs->sfs_lruhead = sfs->sfs_lrutail = NULL;
+	sfs->sfs_ncached = 0;
 
 	/* freemap */
 	sfs->sfs_freemap = NULL;
 	sfs->sfs_freemapdirty = false;
+	sfs->sfs_freehint = 0;
 
 	return sfs;
 
+cleanup_fslock:
+	lock_destroy(sfs->sfs_fslock);
 cleanup_object:
 	kfree(sfs);
 fail:
@@ -388,8 +469,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	int result;
 	struct sfs_fs *sfs;
 
-	vfs_biglock_acquire();
-
 	/* We don't pass any options through mount */
 	(void)options;
 
@@ -402,7 +481,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	 * don't do that in sfs.)
 	 */
 	if (dev->d_blocksize != SFS_BLOCKSIZE) {
-		vfs_biglock_release();
 		kprintf("sfs: Cannot mount on device with blocksize %zu\n",
 			dev->d_blocksize);
 		return ENXIO;
@@ -410,7 +488,6 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 
 	sfs = sfs_fs_create();
 	if (sfs == NULL) {
-		vfs_biglock_release();
 		return ENOMEM;
 	}
 
@@ -421,10 +498,7 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	result = sfs_readblock(sfs, SFS_SUPER_BLOCK, &sfs->sfs_sb,
 			       sizeof(sfs->sfs_sb));
 	if (result) {
-		sfs->sfs_device = NULL;
-		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
-		return result;
+		goto fail;
 	}
 
 	/* Make some simple sanity checks */
@@ -434,10 +508,8 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 			"(0x%x, should be 0x%x)\n",
 			sfs->sfs_sb.sb_magic,
 			SFS_MAGIC);
-		sfs->sfs_device = NULL;
-		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
-		return EINVAL;
+		result = EINVAL;
+		goto fail;
 	}
 
 	if (sfs->sfs_sb.sb_nblocks > dev->d_blocks) {
@@ -451,24 +523,29 @@ sfs_domount(void *options, struct device *dev, struct fs **ret)
 	/* Load free block bitmap */
 	sfs->sfs_freemap = bitmap_create(SFS_FS_FREEMAPBITS(sfs));
 	if (sfs->sfs_freemap == NULL) {
-		sfs->sfs_device = NULL;
-		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
-		return ENOMEM;
+		result = ENOMEM;
+		goto fail;
 	}
 	result = sfs_freemapio(sfs, UIO_READ);
 	if (result) {
-		sfs->sfs_device = NULL;
-		sfs_fs_destroy(sfs);
-		vfs_biglock_release();
-		return result;
+		goto fail;
+	}
+	while (sfs->sfs_freehint < sfs->sfs_sb.sb_nblocks &&
+	       bitmap_isset(sfs->sfs_freemap, sfs->sfs_freehint)) {
+		sfs->sfs_freehint++;
 	}
 
 	/* Hand back the abstract fs */
 	*ret = &sfs->sfs_absfs;
 
-	vfs_biglock_release();
 	return 0;
+
+fail:
+	/* Don't leave blocks we read behind in the buffer cache. */
+	buf_invalidate(dev);
+	sfs->sfs_device = NULL;
+	sfs_fs_destroy(sfs);
+	return result;
 }
 
 /*
@@ -35,13 +35,16 @@
 #include <types.h>
 #include <kern/errno.h>
 #include <lib.h>
+#include <synch.h>
 #include <vfs.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
 
 /*
- * Write an on-disk inode structure back out to disk.
+ * Write an on-disk inode structure back out to its block. (This puts
+ * it in the buffer cache; it reaches the disk when the cache is
+ * flushed.) Call with the vnode locked exclusively.
  */
 int
 sfs_sync_inode(struct sfs_vnode *sv)
@@ -49,6 +52,8 @@ sfs_sync_inode(struct sfs_vnode *sv)
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
 	int result;
 
+	KASSERT(rwlock_do_i_hold_write(sv->sv_lock));
+
 	if (sv->sv_dirty) {
 		result = sfs_writeblock(sfs, sv->sv_ino, &sv->sv_i,
 					sizeof(sv->sv_i));
@@ -60,44 +65,141 @@ sfs_sync_inode(struct sfs_vnode *sv)
 	return 0;
 }
 
+////////////////////////////////////////////////////////////
+// Vnode table
+
 /*
- * Called when the vnode refcount (in-memory usage count) hits zero.
+ * Loaded vnodes are kept in a hash table keyed by inode number. When
+ * the last reference to a vnode goes away and the file still has
+ * links, the vnode stays loaded, on the volume's list of cached
+ * vnodes, so opening the file again doesn't have to read its inode
+ * (or, for a directory, rebuild its name hash). The list holds the
+ * vnode's one remaining reference, which sfs_loadvnode hands on to
+ * whoever asks for the vnode next. Past SFS_VNCACHE cached vnodes,
+ * the least recently used ones are thrown away.
  *
- * This function should try to avoid returning errors other than EBUSY.
+ * All of this is covered by sfs_vnlock.
  */
-int
-sfs_reclaim(struct vnode *v)
+
+static
+struct sfs_vnode **
+sfs_vnbucket(struct sfs_fs *sfs, uint32_t ino)
 {
-	struct sfs_vnode *sv = v->vn_data;
-	struct sfs_fs *sfs = v->vn_fs->fs_data;
-	unsigned ix, i, num;
-	int result;
+	uint32_t h;
 
-	vfs_biglock_acquire();
+	h = ino * 2654435761U;
+	return &sfs->sfs_vntable[(h >> 16) & (SFS_VNHASHSIZE - 1)];
+}
 
-	/*
-	 * Make sure someone else hasn't picked up the vnode since the
-	 * decision was made to reclaim it. (You must also synchronize
-	 * this with sfs_loadvnode.)
-	 */
-	spinlock_acquire(&v->vn_countlock);
-	if (v->vn_refcount != 1) {
+static
+struct sfs_vnode *
+sfs_vnfind(struct sfs_fs *sfs, uint32_t ino)
+{
+	struct sfs_vnode *sv;
 
-		/* consume the reference VOP_DECREF gave us */
-		KASSERT(v->vn_refcount>1);
-		v->vn_refcount--;
+	for (sv = *sfs_vnbucket(sfs, ino); sv != NULL; sv = sv->sv_hashnext) {
+		if (sv->sv_ino == ino) {
+			return sv;
+		}
+	}
+	return NULL;
+}
 
-		spinlock_release(&v->vn_countlock);
-		vfs_biglock_release();
-		return EBUSY;
+static
+void
+sfs_vnhashadd(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	struct sfs_vnode **bucket;
+
+	bucket = sfs_vnbucket(sfs, sv->sv_ino);
+	sv->sv_hashnext = *bucket;
+	*bucket = sv;
+	sfs->sfs_nvnodes++;
+}
+
+static
+void
+sfs_vnhashremove(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	struct sfs_vnode **pp;
+
+	pp = sfs_vnbucket(sfs, sv->sv_ino);
+	while (*pp != sv) {
+		if (*pp == NULL) {
+			panic("sfs: %s: reclaim vnode %u not in vnode pool\n",
+			      sfs->sfs_sb.sb_volname, sv->sv_ino);
+		}
+		pp = &(*pp)->sv_hashnext;
 	}
-	spinlock_release(&v->vn_countlock);
+	*pp = sv->sv_hashnext;
+	sv->sv_hashnext = NULL;
+	sfs->sfs_nvnodes--;
+}
+
+static
+void
+sfs_lruadd(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	KASSERT(!sv->sv_cached);
+	sv->sv_lrunext = NULL;
+	sv->sv_lruprev = sfs->sfs_lrutail;
+	if (sfs->sfs_lrutail != NULL) {
+		sfs->sfs_lrutail->sv_lrunext = sv;
+	}
+	else {
+		sfs->sfs_lruhead = sv;
+	}
+	sfs->sfs_lrutail = sv;
+	sv->sv_cached = true;
+	sfs->sfs_ncached++;
+}
+
+static
+void
+sfs_lruremove(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	KASSERT(sv->sv_cached);
+	if (sv->sv_lruprev != NULL) {
+		sv->sv_lruprev->sv_lrunext = sv->sv_lrunext;
+	}
+	else {
+		KASSERT(sfs->sfs_lruhead == sv);
+		sfs->sfs_lruhead = sv->sv_lrunext;
+	}
+	if (sv->sv_lrunext != NULL) {
+		sv->sv_lrunext->sv_lruprev = sv->sv_lruprev;
+	}
+	else {
+		KASSERT(sfs->sfs_lrutail == sv);
+		sfs->sfs_lrutail = sv->sv_lruprev;
+	}
+	sv->sv_lruprev = sv->sv_lrunext = NULL;
+	sv->sv_cached = false;
+	sfs->sfs_ncached--;
+}
+
+/*
+ * Get rid of a vnode nobody else has a reference to: erase the file
+ * if it has no links left, write back its inode, and free it. Call
+ * with sfs_vnlock held, which keeps sfs_loadvnode from handing out
+ * new references while we work.
+ */
+static
+int
+sfs_vndestroy(struct sfs_fs *sfs, struct sfs_vnode *sv)
+{
+	int result;
+
+	KASSERT(!sv->sv_cached);
+
+	/* Nobody else can get at it, so this won't wait. */
+	rwlock_acquire_write(sv->sv_lock);
 
 	/* If there are no on-disk references to the file either, erase it. */
 	if (sv->sv_i.sfi_linkcount == 0) {
 		result = sfs_itrunc(sv, 0);
 		if (result) {
-			vfs_biglock_release();
+			rwlock_release_write(sv->sv_lock);
 			return result;
 		}
 	}
@@ -105,9 +207,10 @@ sfs_reclaim(struct vnode *v)
 	/* Sync the inode to disk */
 	result = sfs_sync_inode(sv);
 	if (result) {
-		vfs_biglock_release();
+		rwlock_release_write(sv->sv_lock);
 		return result;
 	}
+	rwlock_release_write(sv->sv_lock);
 
 	/* If there are no on-disk references, discard the inode */
 	if (sv->sv_i.sfi_linkcount==0) {
@@ -115,31 +218,101 @@ sfs_reclaim(struct vnode *v)
 	}
 
 	/* Remove the vnode structure from the table in the struct sfs_fs. */
-	num = vnodearray_num(sfs->sfs_vnodes);
-	ix = num;
-	for (i=0; i<num; i++) {
-		struct vnode *v2 = vnodearray_get(sfs->sfs_vnodes, i);
-		struct sfs_vnode *sv2 = v2->vn_data;
-		if (sv2 == sv) {
-			ix = i;
+	sfs_vnhashremove(sfs, sv);
+
+	/* Release the storage for the vnode structure itself. */
+	sfs_dirhash_destroy(sv);
+	vnode_cleanup(&sv->sv_absvn);
+	rwlock_destroy(sv->sv_lock);
+	kfree(sv);
+
+	return 0;
+}
+
+/*
+ * Throw away cached vnodes, oldest first, until there are no more
+ * than MAX. Call with sfs_vnlock held.
+ */
+void
+sfs_vntrim(struct sfs_fs *sfs, unsigned max)
+{
+	struct sfs_vnode *sv, *next;
+	struct vnode *v;
+	bool busy;
+	int result;
+
+	for (sv = sfs->sfs_lruhead; sv != NULL && sfs->sfs_ncached > max;
+	     sv = next) {
+		next = sv->sv_lrunext;
+		v = &sv->sv_absvn;
+
+		/* sfs_sync_vnodes may have it for the moment; skip it. */
+		spinlock_acquire(&v->vn_countlock);
+		KASSERT(v->vn_refcount > 0);
+		busy = v->vn_refcount > 1;
+		spinlock_release(&v->vn_countlock);
+		if (busy) {
+			continue;
+		}
+
+		sfs_lruremove(sfs, sv);
+		result = sfs_vndestroy(sfs, sv);
+		if (result) {
+			kprintf("sfs: %s: Cannot write back inode %u: %s\n",
+				sfs->sfs_sb.sb_volname, sv->sv_ino,
+				strerror(result));
+			sfs_lruadd(sfs, sv);
 			break;
 		}
 	}
-	if (ix == num) {
-		panic("sfs: %s: reclaim vnode %u not in vnode pool\n",
-		      sfs->sfs_sb.sb_volname, sv->sv_ino);
-	}
-	vnodearray_remove(sfs->sfs_vnodes, ix);
+}
 
-	vnode_cleanup(&sv->sv_absvn);
+/*
+ * Called when the vnode refcount (in-memory usage count) hits zero.
+ *
+ * This function should try to avoid returning errors other than EBUSY.
+ */
+int
+sfs_reclaim(struct vnode *v)
+{
+	struct sfs_vnode *sv = v->vn_data;
+	struct sfs_fs *sfs = v->vn_fs->fs_data;
+	int result;
 
-	vfs_biglock_release();
+	lock_acquire(sfs->sfs_vnlock);
 
-	/* Release the storage for the vnode structure itself. */
-	kfree(sv);
+	/*
+	 * Make sure someone else hasn't picked up the vnode since the
+	 * decision was made to reclaim it.
+	 */
+	spinlock_acquire(&v->vn_countlock);
+	if (v->vn_refcount != 1) {
 
-	/* Done */
-	return 0;
+		/* consume the reference VOP_DECREF gave us */
+		KASSERT(v->vn_refcount>1);
+		v->vn_refcount--;
+
+		spinlock_release(&v->vn_countlock);
+		lock_release(sfs->sfs_vnlock);
+		return EBUSY;
+	}
+	spinlock_release(&v->vn_countlock);
+
+	/*
+	 * If the file still has links, cache the vnode; the list gets
+	 * the reference VOP_DECREF gave us. (We have the only
+	 * reference, so nobody can be changing the link count.)
+	 */
+	if (sv->sv_i.sfi_linkcount > 0) {
+		sfs_lruadd(sfs, sv);
+		sfs_vntrim(sfs, SFS_VNCACHE);
+		lock_release(sfs->sfs_vnlock);
+		return 0;
+	}
+
+	result = sfs_vndestroy(sfs, sv);
+	lock_release(sfs->sfs_vnlock);
+	return result;
 }
 
 /*
@@ -150,42 +323,41 @@ int
 sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		 struct sfs_vnode **ret)
 {
-	struct vnode *v;
 	struct sfs_vnode *sv;
 	const struct vnode_ops *ops;
-	unsigned i, num;
 	int result;
 
-	/* Look in the vnodes table */
-	num = vnodearray_num(sfs->sfs_vnodes);
-
-	/* Linear search. Is this too slow? You decide. */
-	for (i=0; i<num; i++) {
-		v = vnodearray_get(sfs->sfs_vnodes, i);
-		sv = v->vn_data;
+	lock_acquire(sfs->sfs_vnlock);
 
+	/* Look in the vnode table */
+	sv = sfs_vnfind(sfs, ino);
+	if (sv != NULL) {
 		/* Every inode in memory must be in an allocated block */
-		if (!sfs_bused(sfs, sv->sv_ino)) {
+		if (!sfs_bused(sfs, ino)) {
 			panic("sfs: %s: Found inode %u in unallocated block\n",
-			      sfs->sfs_sb.sb_volname, sv->sv_ino);
+			      sfs->sfs_sb.sb_volname, ino);
 		}
 
-		if (sv->sv_ino==ino) {
-			/* Found */
-
-			/* forcetype is only allowed when creating objects */
-			KASSERT(forcetype==SFS_TYPE_INVAL);
+		/* forcetype is only allowed when creating objects */
+		KASSERT(forcetype==SFS_TYPE_INVAL);
 
+		if (sv->sv_cached) {
+			/* Take over the cache's reference. */
+			sfs_lruremove(sfs, sv);
+		}
+		else {
 			VOP_INCREF(&sv->sv_absvn);
-			*ret = sv;
-			return 0;
 		}
+		lock_release(sfs->sfs_vnlock);
+		*ret = sv;
+		return 0;
 	}
 
 	/* Didn't have it loaded; load it */
 
 	sv = kmalloc(sizeof(struct sfs_vnode));
 	if (sv==NULL) {
+		lock_release(sfs->sfs_vnlock);
 		return ENOMEM;
 	}
 
@@ -195,15 +367,30 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 		      "unallocated block\n", sfs->sfs_sb.sb_volname, ino);
 	}
 
+	sv->sv_lock = rwlock_create("sfs_vnode");
+	if (sv->sv_lock == NULL) {
+		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
+		return ENOMEM;
+	}
+
 	/* Read the block the inode is in */
 	result = sfs_readblock(sfs, ino, &sv->sv_i, sizeof(sv->sv_i));
 	if (result) {
+		rwlock_destroy(sv->sv_lock);
 		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
 
 	/* Not dirty yet */
 	sv->sv_dirty = false;
+	sv->sv_dirhash = NULL;
+
+	/* Not in the table yet */
+	sv->sv_hashnext = NULL;
+	sv->sv_lruprev = sv->sv_lrunext = NULL;
+	sv->sv_cached = false;
 
 	/*
 	 * FORCETYPE is set if we're creating a new file, because the
@@ -235,7 +422,9 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	/* Call the common vnode initializer */
 	result = vnode_init(&sv->sv_absvn, ops, &sfs->sfs_absfs, sv);
 	if (result) {
+		rwlock_destroy(sv->sv_lock);
 		kfree(sv);
+		lock_release(sfs->sfs_vnlock);
 		return result;
 	}
 
@@ -243,12 +432,9 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 	sv->sv_ino = ino;
 
 	/* Add it to our table */
-	result = vnodearray_add(sfs->sfs_vnodes, &sv->sv_absvn, NULL);
-	if (result) {
-		vnode_cleanup(&sv->sv_absvn);
-		kfree(sv);
-		return result;
-	}
+	sfs_vnhashadd(sfs, sv);
+
+	lock_release(sfs->sfs_vnlock);
 
 	/* Hand it back */
 	*ret = sv;
@@ -256,10 +442,12 @@ sfs_loadvnode(struct sfs_fs *sfs, uint32_t ino, int forcetype,
 }
 
 /*
- * Create a new filesystem object and hand back its vnode.
+ * Create a new filesystem object and hand back its vnode. Its inode
+ * goes near GOAL (the directory it'll be in) if possible.
  */
 int
-sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret)
+sfs_makeobj(struct sfs_fs *sfs, int type, daddr_t goal,
+	    struct sfs_vnode **ret)
 {
 	uint32_t ino;
 	int result;
@@ -269,7 +457,7 @@ sfs_makeobj(struct sfs_fs *sfs, int type, struct sfs_vnode **ret)
 	 * number is the block number, so just get a block.)
 	 */
 
-	result = sfs_balloc(sfs, &ino);
+	result = sfs_balloc(sfs, goal, 1, true, &ino);
 	if (result) {
 		return result;
 	}
@@ -296,25 +484,20 @@ sfs_getroot(struct fs *fs, struct vnode **ret)
 	struct sfs_vnode *sv;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = sfs_loadvnode(sfs, SFS_ROOTDIR_INO, SFS_TYPE_INVAL, &sv);
 	if (result) {
 		kprintf("sfs: %s: getroot: Cannot load root vnode\n",
 			sfs->sfs_sb.sb_volname);
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (sv->sv_i.sfi_type != SFS_TYPE_DIR) {
 		kprintf("sfs: %s: getroot: not directory (type %u)\n",
 			sfs->sfs_sb.sb_volname, sv->sv_i.sfi_type);
-		vfs_biglock_release();
+		VOP_DECREF(&sv->sv_absvn);
 		return EINVAL;
 	}
 
-	vfs_biglock_release();
-
 	*ret = &sv->sv_absvn;
 	return 0;
 }
@@ -36,8 +36,9 @@
 #include <kern/errno.h>
 #include <lib.h>
 #include <uio.h>
-#include <vfs.h>
-#include <device.h>
+#include <synch.h>
+#include <bio.h>
+#include <buf.h>
 #include <sfs.h>
 #include "sfsprivate.h"
 
@@ -46,74 +47,33 @@
 // Basic block-level I/O routines
 
 /*
+ * All block I/O goes through the buffer cache (see buf.h). Writes
+ * are write-back; sfs_sync flushes the cache.
+ *
  * Note: sfs_readblock is used to read the superblock
  * early in mount, before sfs is fully (or even mostly)
  * initialized, and so may not use anything from sfs
  * except sfs_device.
  */
 
-/*
- * Read or write a block, retrying I/O errors.
- */
-static
-int
-sfs_rwblock(struct sfs_fs *sfs, struct uio *uio)
-{
-	int result;
-	int tries=0;
-
-	KASSERT(vfs_biglock_do_i_hold());
-
-	DEBUG(DB_SFS, "sfs: %s %llu\n",
-	      uio->uio_rw == UIO_READ ? "read" : "write",
-	      uio->uio_offset / SFS_BLOCKSIZE);
-
- retry:
-	result = DEVOP_IO(sfs->sfs_device, uio);
-	if (result == EINVAL) {
-		/*
-		 * This means the sector we requested was out of range,
-		 * or the seek address we gave wasn't sector-aligned,
-		 * or a couple of other things that are our fault.
-		 */
-		panic("sfs: %s: DEVOP_IO returned EINVAL\n",
-		      sfs->sfs_sb.sb_volname);
-	}
-	if (result == EIO) {
-		if (tries == 0) {
-			tries++;
-			kprintf("sfs: %s: block %llu I/O error, retrying\n",
-				sfs->sfs_sb.sb_volname,
-				uio->uio_offset / SFS_BLOCKSIZE);
-			goto retry;
-		}
-		else if (tries < 10) {
-			tries++;
-			goto retry;
-		}
-		else {
-			kprintf("sfs: %s: block %llu I/O error, giving up "
-				"after %d retries\n",
-				sfs->sfs_sb.sb_volname,
-				uio->uio_offset / SFS_BLOCKSIZE, tries);
-		}
-	}
-	return result;
-}
-
 /*
  * Read a block.
  */
 int
 sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 {
-	struct iovec iov;
-	struct uio ku;
+	struct buf *b;
+	int result;
 
 	KASSERT(len == SFS_BLOCKSIZE);
 
-	SFSUIO(&iov, &ku, data, block, UIO_READ);
-	return sfs_rwblock(sfs, &ku);
+	result = buf_read(sfs->sfs_device, block, &b);
+	if (result) {
+		return result;
+	}
+	memcpy(data, b->b_data, len);
+	buf_release(b);
+	return 0;
 }
 
 /*
@@ -122,13 +82,20 @@ sfs_readblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 int
 sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 {
-	struct iovec iov;
-	struct uio ku;
+	struct buf *b;
+	int result;
 
 	KASSERT(len == SFS_BLOCKSIZE);
 
-	SFSUIO(&iov, &ku, data, block, UIO_WRITE);
-	return sfs_rwblock(sfs, &ku);
+	/* We're replacing the whole block, so don't read it first. */
+	result = buf_get(sfs->sfs_device, block, &b);
+	if (result) {
+		return result;
+	}
+	memcpy(b->b_data, data, len);
+	buf_markdirty(b);
+	buf_release(b);
+	return 0;
 }
 
 ////////////////////////////////////////////////////////////
@@ -137,8 +104,8 @@ sfs_writeblock(struct sfs_fs *sfs, daddr_t block, void *data, size_t len)
 
 /*
  * Do I/O to a block of a file that doesn't cover the whole block.  We
- * need to read in the original block first, even if we're writing, so
- * we don't clobber the portion of the block we're not intending to
+ * need the original block in the cache first, even if we're writing,
+ * so we don't clobber the portion of the block we're not intending to
  * write over.
  *
  * SKIPSTART is the number of bytes to skip past at the beginning of
@@ -150,16 +117,8 @@ int
 sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	      uint32_t skipstart, uint32_t len)
 {
-	/*
-	 * I/O buffer for handling partial sectors.
-	 *
-	 * Note: in real life (and when you've done the fs assignment)
-	 * you would get space from the disk buffer cache for this,
-	 * not use a static area.
-	 */
-	static char iobuf[SFS_BLOCKSIZE];
-
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *b;
 	daddr_t diskblock;
 	uint32_t fileblock;
 	int result;
@@ -169,9 +128,6 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 
 	KASSERT(skipstart + len <= SFS_BLOCKSIZE);
 
-	/* We're using a global static buffer; it had better be locked */
-	KASSERT(vfs_biglock_do_i_hold());
-
 	/* Compute the block offset of this block in the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
 
@@ -184,40 +140,33 @@ sfs_partialio(struct sfs_vnode *sv, struct uio *uio,
 	if (diskblock == 0) {
 		/*
 		 * There was no block mapped at this point in the file.
-		 * Zero the buffer.
+		 * Read zeros.
 		 */
 		KASSERT(uio->uio_rw == UIO_READ);
-		bzero(iobuf, sizeof(iobuf));
+		return uiomovezeros(len, uio);
 	}
-	else {
-		/*
-		 * Read the block.
-		 */
-		result = sfs_readblock(sfs, diskblock, iobuf, sizeof(iobuf));
-		if (result) {
-			return result;
-		}
+
+	/* Get the block. */
+	result = buf_read(sfs->sfs_device, diskblock, &b);
+	if (result) {
+		return result;
 	}
 
 	/*
 	 * Now perform the requested operation into/out of the buffer.
 	 */
-	result = uiomove(iobuf+skipstart, len, uio);
-	if (result) {
-		return result;
-	}
+	result = uiomove((char *)b->b_data + skipstart, len, uio);
 
 	/*
-	 * If it was a write, write back the modified block.
+	 * If it was a write, the buffer now needs writing back. (Even
+	 * if uiomove failed partway, since part of it may have changed.)
 	 */
 	if (uio->uio_rw == UIO_WRITE) {
-		result = sfs_writeblock(sfs, diskblock, iobuf, sizeof(iobuf));
-		if (result) {
-			return result;
-		}
+		buf_markdirty(b);
 	}
+	buf_release(b);
 
-	return 0;
+	return result;
 }
 
 /*
@@ -228,20 +177,30 @@ int
 sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *b;
 	daddr_t diskblock;
 	uint32_t fileblock;
+	size_t resid;
 	int result;
-	bool doalloc = (uio->uio_rw==UIO_WRITE);
-	off_t saveoff;
-	off_t diskoff;
-	off_t saveres;
-	off_t diskres;
+	bool isnew;
 
 	/* Get the block number within the file */
 	fileblock = uio->uio_offset / SFS_BLOCKSIZE;
 
-	/* Look up the disk block number */
-	result = sfs_bmap(sv, fileblock, doalloc, &diskblock);
+	/*
+	 * Look up the disk block number. If writing, we'll overwrite
+	 * the whole block, so a new one doesn't need zeroing, and the
+	 * rest of this write can go in the blocks after it.
+	 */
+	if (uio->uio_rw == UIO_WRITE) {
+		result = sfs_bmapfill(sv, fileblock,
+				      uio->uio_resid / SFS_BLOCKSIZE,
+				      &diskblock, &isnew);
+	}
+	else {
+		result = sfs_bmap(sv, fileblock, false, &diskblock);
+		isnew = false;
+	}
 	if (result) {
 		return result;
 	}
@@ -257,42 +216,103 @@ sfs_blockio(struct sfs_vnode *sv, struct uio *uio)
 		return uiomovezeros(SFS_BLOCKSIZE, uio);
 	}
 
-	/*
-	 * Do the I/O directly to the uio region. Save the uio_offset,
-	 * and substitute one that makes sense to the device.
-	 */
-	saveoff = uio->uio_offset;
-	diskoff = diskblock * SFS_BLOCKSIZE;
-	uio->uio_offset = diskoff;
-
-	/*
-	 * Temporarily set the residue to be one block size.
-	 */
 	KASSERT(uio->uio_resid >= SFS_BLOCKSIZE);
-	saveres = uio->uio_resid;
-	diskres = SFS_BLOCKSIZE;
-	uio->uio_resid = diskres;
 
-	result = sfs_rwblock(sfs, uio);
+	if (uio->uio_rw == UIO_READ) {
+		result = buf_read(sfs->sfs_device, diskblock, &b);
+		if (result) {
+			return result;
+		}
+		result = uiomove(b->b_data, SFS_BLOCKSIZE, uio);
+		buf_release(b);
+		return result;
+	}
 
 	/*
-	 * Now, restore the original uio_offset and uio_resid and update
-	 * them by the amount of I/O done.
+	 * Writing the whole block: no need to read it in first. If
+	 * the copy fails partway, a buffer that didn't hold the block
+	 * before must stay invalid; one that did has been changed and
+	 * needs writing back. A new block was never zeroed, so zero
+	 * whatever the copy didn't get to.
 	 */
-	uio->uio_offset = (uio->uio_offset - diskoff) + saveoff;
-	uio->uio_resid = (uio->uio_resid - diskres) + saveres;
-
+	result = buf_get(sfs->sfs_device, diskblock, &b);
+	if (result) {
+		return result;
+	}
+	resid = uio->uio_resid;
+	result = uiomove(b->b_data, SFS_BLOCKSIZE, uio);
+	if (result && isnew) {
+		bzero((char *)b->b_data + (resid - uio->uio_resid),
+		      SFS_BLOCKSIZE - (resid - uio->uio_resid));
+	}
+	if (result == 0 || b->b_valid || isnew) {
+		buf_markdirty(b);
+	}
+	buf_release(b);
 	return result;
 }
 
+/*
+ * Start reading the blocks of the file from POS to POS+LEN into the
+ * buffer cache in the background, up to SFS_RABATCH blocks at a time.
+ * Holes and anything past EOF are skipped. This is only a hint, so
+ * errors are ignored. Call with the vnode locked (shared is enough).
+ */
+void
+sfs_prefetch(struct sfs_vnode *sv, off_t pos, off_t len)
+{
+	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	daddr_t diskblocks[SFS_RABATCH];
+	struct bioplug plug;
+	uint32_t fileblock, endblock;
+	unsigned i, n;
+	off_t end;
+
+	end = pos + len;
+	if (end > (off_t)sv->sv_i.sfi_size) {
+		end = sv->sv_i.sfi_size;
+	}
+	if (pos >= end) {
+		return;
+	}
+	fileblock = pos / SFS_BLOCKSIZE;
+	endblock = (end + SFS_BLOCKSIZE - 1) / SFS_BLOCKSIZE;
+
+	while (fileblock < endblock) {
+		/*
+		 * Look up a batch first: sfs_bmap may need a buffer for
+		 * an indirect block, and the buffers on the plug stay
+		 * busy until it's unplugged.
+		 */
+		n = 0;
+		while (n < SFS_RABATCH && fileblock < endblock) {
+			if (sfs_bmap(sv, fileblock, false, &diskblocks[n])) {
+				endblock = fileblock;
+				break;
+			}
+			if (diskblocks[n] != 0) {
+				n++;
+			}
+			fileblock++;
+		}
+
+		bio_plug(&plug);
+		for (i=0; i<n; i++) {
+			buf_readahead(sfs->sfs_device, diskblocks[i], &plug);
+		}
+		bio_unplug(&plug);
+	}
+}
+
 /*
  * Do I/O of a whole region of data, whether or not it's block-aligned.
+ * Call with the vnode locked; exclusively if writing.
  */
 int
 sfs_io(struct sfs_vnode *sv, struct uio *uio)
 {
 	uint32_t blkoff;
-	uint32_t nblocks, i;
+	uint32_t nblocks, i, n;
 	int result = 0;
 	uint32_t origresid, extraresid = 0;
 
@@ -353,6 +373,19 @@ sfs_io(struct sfs_vnode *sv, struct uio *uio)
 	KASSERT(uio->uio_offset % SFS_BLOCKSIZE == 0);
 	nblocks = uio->uio_resid / SFS_BLOCKSIZE;
 	for (i=0; i<nblocks; i++) {
+		/*
+		 * For a long read, keep up to two batches of blocks on
+		 * their way while we copy out this one.
+		 */
+		if (uio->uio_rw == UIO_READ && nblocks > 1 &&
+		    i % SFS_RABATCH == 0) {
+			n = nblocks - i;
+			if (n > 2 * SFS_RABATCH) {
+				n = 2 * SFS_RABATCH;
+			}
+			sfs_prefetch(sv, uio->uio_offset,
+				     (off_t)n * SFS_BLOCKSIZE);
+		}
 		result = sfs_blockio(sv, uio);
 		if (result) {
 			goto out;
@@ -407,6 +440,7 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 	   enum uio_rw rw)
 {
 	struct sfs_fs *sfs = sv->sv_absvn.vn_fs->fs_data;
+	struct buf *b;
 	off_t endpos;
 	uint32_t vnblock;
 	uint32_t blockoffset;
@@ -414,17 +448,7 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 	bool doalloc;
 	int result;
 
-	/*
-	 * I/O buffer for metadata ops.
-	 *
-	 * Note: in real life (and when you've done the fs assignment) you
-	 * would get space from the disk buffer cache for this, not use a
-	 * static area.
-	 */
-	static char metaiobuf[SFS_BLOCKSIZE];
-
-	/* We're using a global static buffer; it had better be locked */
-	KASSERT(vfs_biglock_do_i_hold());
+	KASSERT(rw == UIO_READ || rwlock_do_i_hold_write(sv->sv_lock));
 
 	/* Figure out which block of the vnode (directory, whatever) this is */
 	vnblock = actualpos / SFS_BLOCKSIZE;
@@ -446,26 +470,22 @@ sfs_metaio(struct sfs_vnode *sv, off_t actualpos, void *data, size_t len,
 		return 0;
 	}
 
-	/* Read the block */
-	result = sfs_readblock(sfs, diskblock, metaiobuf, sizeof(metaiobuf));
+	/* Get the block */
+	result = buf_read(sfs->sfs_device, diskblock, &b);
 	if (result) {
 		return result;
 	}
 
 	if (rw == UIO_READ) {
 		/* Copy out the selected region */
-		memcpy(data, metaiobuf + blockoffset, len);
+		memcpy(data, (char *)b->b_data + blockoffset, len);
+		buf_release(b);
 	}
 	else {
-		/* Update the selected region */
-		memcpy(metaiobuf + blockoffset, data, len);
-
-		/* Write the block back */
-		result = sfs_writeblock(sfs, diskblock,
-					metaiobuf, sizeof(metaiobuf));
-		if (result) {
-			return result;
-		}
+		/* Update the selected region; it goes to disk later */
+		memcpy((char *)b->b_data + blockoffset, data, len);
+		buf_markdirty(b);
+		buf_release(b);
 
 		/* Update the vnode size if needed */
 		endpos = actualpos + len;
@@ -35,6 +35,7 @@
  */
 
 
+#include <limits.h>
 #include <vm.h>
 #include "opt-dumbvm.h"
 
@@ -42,6 +43,12 @@
 #define ADDRSP_STACKSIZE 1024
 /* Number of heap pages to begin with for each addrspace load. */
 #define ADDRSP_HEAP_PAGES 1
+/*
+ * Pages of user stack for each extra thread (see thread_create). The
+ * UTHREAD_MAX thread stacks sit one after another right below the
+ * main stack, slot 0 highest.
+ */
+#define ADDRSP_THREADSTACK_PAGES 16
 
 struct vnode;
 
@@ -76,15 +83,18 @@ struct addrspace {
         paddr_t as_pbase2;
         size_t as_npages2;
         paddr_t as_stackpbase;
+        paddr_t as_tstackpbase[UTHREAD_MAX];	/* 0 if never used */
 #else
 	struct area *segments;		// Segments from as_define_region
 	struct pentry *stack;		// Stack pages
 	struct pentry *heap;		// Heap pages
+	struct pentry *tstack[UTHREAD_MAX];	// Extra thread stacks
 
 	vaddr_t as_heap_start;
 	vaddr_t as_heap_end;
 
 #endif
+	unsigned as_copiedpages;	/* Pages as_copy copied to make this */
 };
 
 /*
@@ -124,6 +134,13 @@ struct addrspace {
  *                (Normally called *after* as_complete_load().) Hands
  *                back the initial stack pointer for the new process.
  *
+ *    as_define_thread_stack - set up the stack for extra thread SLOT
+ *                (0 to UTHREAD_MAX-1) and hand back its initial stack
+ *                pointer. The stack is zeroed.
+ *
+ *    as_free_thread_stack - release the stack of thread SLOT once the
+ *                thread is gone for good.
+ *
  * Note that when using dumbvm, addrspace.c is not used and these
  * functions are found in dumbvm.c.
  */
@@ -142,6 +159,9 @@ int               as_define_region(struct addrspace *as,
 int               as_prepare_load(struct addrspace *as);
 int               as_complete_load(struct addrspace *as);
 int               as_define_stack(struct addrspace *as, vaddr_t *initstackptr);
+int               as_define_thread_stack(struct addrspace *as, unsigned slot,
+                                         vaddr_t *initstackptr);
+void              as_free_thread_stack(struct addrspace *as, unsigned slot);
 void		  as_zero_segment(struct area *seg);
 
 /*
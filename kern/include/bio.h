@@ -0,0 +1,83 @@
+/*
+ * Asynchronous block I/O.
+ */
+
+#ifndef _BIO_H_
+#define _BIO_H_
+
+#include <uio.h>	/* for enum uio_rw */
+
+struct device;	/* in device.h */
+
+/*
+ * The bio layer sits between the buffer cache (or any other block
+ * user) and block devices. A caller fills in a struct bio describing
+ * a transfer of whole blocks between a kernel buffer and a device,
+ * and bio_submit queues it and returns at once; a pool of bio
+ * threads does the DEVOP_IO calls, so several transfers can be in
+ * flight, and calls bio_done in thread context (with no locks held)
+ * when each one finishes. The struct bio belongs to the bio layer
+ * from bio_submit until bio_done is called. bio_done may take sleep
+ * locks, but mustn't wait for other block I/O, since it's running on
+ * one of the threads that would do it.
+ *
+ * Queued requests are kept sorted by device and block, and a request
+ * that extends another one still waiting in the queue (same device,
+ * same direction, the next blocks) is merged into it, so they go to
+ * the device as one transfer. To give merging a chance, a caller
+ * issuing a batch of requests can plug: bio_plugsubmit collects them
+ * on a private list, merging as it goes, and bio_unplug hands the
+ * whole batch to the queue at once.
+ *
+ * I/O errors (EIO) are retried a few times before being reported.
+ *
+ * Functions:
+ *     bio_bootstrap  - set up the queue and start the bio threads.
+ *     bio_submit     - queue a request.
+ *     bio_plug       - start collecting requests on a plug.
+ *     bio_plugsubmit - add a request to a plug.
+ *     bio_unplug     - queue everything on a plug.
+ *     bio_rw         - synchronous wrapper: do a transfer and wait
+ *                      for it.
+ *     bio_printstats - print request counts.
+ *     bio_resetstats - zero the counters.
+ */
+
+#define BIO_NTHREADS	4	/* threads doing device I/O */
+#define BIO_MAXMERGE	16	/* most requests merged into one transfer */
+
+struct bio {
+	/* Filled in by the caller */
+	struct device *bio_dev;		/* device */
+	daddr_t bio_block;		/* first block */
+	unsigned bio_nblocks;		/* number of blocks */
+	void *bio_data;			/* kernel buffer */
+	enum uio_rw bio_rw;		/* UIO_READ or UIO_WRITE */
+	void (*bio_done)(struct bio *bio);	/* completion callback */
+	void *bio_arg;			/* for bio_done's use */
+
+	/* Set before bio_done is called */
+	int bio_error;			/* 0 or error code */
+
+	/* Private to the bio layer */
+	struct bio *bio_next;		/* queue */
+	struct bio *bio_merged;		/* requests merged after this one */
+	unsigned bio_mergecount;	/* length of the merged chain + 1 */
+	unsigned bio_mergeblocks;	/* total blocks, merged chain included */
+};
+
+struct bioplug {
+	struct bio *bp_list;		/* sorted, merged requests */
+};
+
+void bio_bootstrap(void);
+void bio_submit(struct bio *bio);
+void bio_plug(struct bioplug *plug);
+void bio_plugsubmit(struct bioplug *plug, struct bio *bio);
+void bio_unplug(struct bioplug *plug);
+int bio_rw(struct device *dev, daddr_t block, unsigned nblocks, void *data,
+	   enum uio_rw rw);
+void bio_printstats(void);
+void bio_resetstats(void);
+
+#endif /* _BIO_H_ */
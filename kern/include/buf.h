@@ -0,0 +1,93 @@
+/*
+ * Buffer cache for block devices.
+ */
+
+#ifndef _BUF_H_
+#define _BUF_H_
+
+#include <bio.h>
+
+struct device;	/* in device.h */
+struct buf_batch;	/* private to buf.c */
+
+/*
+ * The buffer cache keeps recently used disk blocks in memory, keyed
+ * on (device, block number). Buffers are found through a hash table;
+ * the ones nobody is using are kept on an LRU list, and a new block
+ * takes over the least recently used of them once the cache has
+ * grown to its maximum size. Writes are write-back: a modified buffer
+ * is marked dirty and goes to disk later, when it's evicted, when the
+ * filesystem calls buf_flush (from its sync and fsync routines), or
+ * when the flusher thread gets to it. The flusher wakes up every
+ * BUF_FLUSHINTERVAL seconds and writes out the buffers that have been
+ * dirty for BUF_FLUSHAGE seconds or more, or all of them if the cache
+ * has had to evict dirty buffers since the last time. Disk I/O goes
+ * through the bio layer; buf_flush and the flusher submit all their
+ * writes at once, plugged, so runs of adjacent dirty blocks go out
+ * sorted and merged.
+ *
+ * A buffer handed out by buf_read or buf_get is busy, i.e. owned by
+ * the caller, until it's passed to buf_release; anyone else who wants
+ * the same block waits. Don't hold more than a few at once, or you
+ * can starve (or, with a small cache, deadlock) other threads.
+ *
+ * The cache only sees I/O done through it, so raw access to a device
+ * with mounted blocks can see stale data.
+ *
+ * Functions:
+ *     buf_bootstrap  - set up the cache at boot.
+ *     buf_read       - get a buffer for a block, reading it in if needed.
+ *     buf_get        - get a buffer for a block without reading it,
+ *                      for a caller that will overwrite all of it.
+ *                      The contents are garbage unless b_valid is set.
+ *     buf_readahead  - start reading a block into the cache in the
+ *                      background, if it isn't there already and a
+ *                      buffer is free; submitted on the caller's plug.
+ *     buf_markdirty  - record that the caller changed (or filled) the
+ *                      buffer's data.
+ *     buf_release    - give a buffer back.
+ *     buf_flush      - write out every dirty buffer for a device.
+ *     buf_invalidate - flush, then forget, every buffer for a device
+ *                      (for unmount).
+ *     buf_setmax     - change the maximum number of buffers.
+ *     buf_printstats - print hit/miss and disk operation counts.
+ *     buf_resetstats - zero the counters.
+ */
+
+#define BUF_BLOCKSIZE	512	/* size of each buffer */
+#define BUF_HASHSIZE	256	/* hash buckets; must be a power of 2 */
+#define BUF_DEFAULTMAX	128	/* default maximum number of buffers */
+#define BUF_MINMAX	16	/* smallest maximum allowed */
+#define BUF_FLUSHINTERVAL 3	/* seconds between flusher runs */
+#define BUF_FLUSHAGE	5	/* seconds dirty before the flusher writes */
+
+struct buf {
+	struct device *b_dev;		/* device, or NULL if unused */
+	daddr_t b_block;		/* block number on the device */
+	void *b_data;			/* BUF_BLOCKSIZE bytes of data */
+	bool b_valid;			/* b_data holds the block */
+	bool b_dirty;			/* b_data is newer than the disk */
+	bool b_busy;			/* handed out to someone */
+	bool b_readahead;		/* read ahead, not yet asked for */
+	time_t b_dirtytime;		/* when it last became dirty */
+	unsigned b_dirtygen;		/* buf_dirtygen when it did */
+	struct buf *b_hashnext;		/* hash chain */
+	struct buf *b_lruprev;		/* LRU list (idle buffers only) */
+	struct buf *b_lrunext;
+	struct bio b_bio;		/* for asynchronous I/O */
+	struct buf_batch *b_batch;	/* batch the I/O belongs to */
+};
+
+void buf_bootstrap(void);
+int buf_read(struct device *dev, daddr_t block, struct buf **ret);
+int buf_get(struct device *dev, daddr_t block, struct buf **ret);
+void buf_readahead(struct device *dev, daddr_t block, struct bioplug *plug);
+void buf_markdirty(struct buf *b);
+void buf_release(struct buf *b);
+int buf_flush(struct device *dev);
+int buf_invalidate(struct device *dev);
+int buf_setmax(unsigned max);
+void buf_printstats(void);
+void buf_resetstats(void);
+
+#endif /* _BUF_H_ */
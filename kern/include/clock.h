@@ -48,6 +48,17 @@
 void hardclock_bootstrap(void);
 void hardclock(void);
 
+/*
+ * The time of day as seen by user programs without a system call,
+ * in the page mapped at USERCLOCK_ADDR in every process (see
+ * <kern/userinfo.h>). hardclock keeps it current on cpu 0 once
+ * userclock_start has been called, which must wait until the clock
+ * device is attached.
+ */
+struct userclock; /* in kern/userinfo.h */
+extern struct userclock *userclock;
+void userclock_start(void);
+
 /*
  * timerclock() is called on one CPU once a second to allow simple
  * timed operations. (This is a fairly simpleminded interface.)
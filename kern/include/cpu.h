@@ -35,6 +35,8 @@
 #include <threadlist.h>
 #include <machine/vm.h>  /* for TLBSHOOTDOWN_MAX */
 
+struct sysstat; /* in sysstat.h */
+
 extern unsigned num_cpus;
 
 /*
@@ -62,6 +64,7 @@ struct cpu {
 	struct threadlist c_zombies;	/* List of exited threads */
 	unsigned c_hardclocks;		/* Counter of hardclock() calls */
 	unsigned c_spinlocks;		/* Counter of spinlocks held */
+	struct sysstat *c_sysstat;	/* Per-syscall counters (sysstat.h) */
 
 	/*
 	 * Accessed by other cpus.
@@ -111,11 +114,24 @@ void cpu_machdep_init(struct cpu *);
 /*ASMLINKAGE*/ void cpu_start_secondary(void);
 void cpu_hatch(unsigned software_number);
 
+/*
+ * Return cpu number NUM, for 0 <= NUM < num_cpus. CPUs are never
+ * destroyed, so the pointer stays good.
+ */
+struct cpu *cpu_get(unsigned num);
+
 /*
  * Produce a string describing the CPU type.
  */
 void cpu_identify(char *buf, size_t max);
 
+/*
+ * Read the processor's free-running cycle counter. The value wraps,
+ * so only the (unsigned) difference between two readings taken on
+ * the same CPU is meaningful.
+ */
+uint32_t cpu_getcycles(void);
+
 /*
  * Hardware-level interrupt on/off, for the current CPU.
  *
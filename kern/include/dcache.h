@@ -0,0 +1,64 @@
+/*
+ * Name lookup cache.
+ */
+
+#ifndef _DCACHE_H_
+#define _DCACHE_H_
+
+struct vnode;	/* in vnode.h */
+struct fs;	/* in fs.h */
+
+/*
+ * The name cache remembers what a name in a directory refers to, so
+ * that vfs_lookup and vfs_lookparent can walk a path one component
+ * at a time without going to the filesystem for components they've
+ * seen before. Each entry maps (directory vnode, name) to the vnode
+ * the name refers to, or, for a negative entry, to nothing: the
+ * lookup failed with ENOENT. An entry holds a reference to both
+ * vnodes.
+ *
+ * Only directories that belong to a filesystem are cached, and not
+ * "." or "..", or names longer than DCACHE_NAMELEN. The cache is
+ * limited to DCACHE_MAX entries; past that, the least recently used
+ * entry is reused.
+ *
+ * The cache doesn't know when a name changes, so the VFS layer has
+ * to tell it: every operation that creates or removes a name purges
+ * the entry for it, and unmounting purges the whole filesystem's
+ * entries (and the references they hold). Changes a filesystem makes
+ * other than through the vfs_* calls (e.g. an emufs host removing a
+ * file) aren't seen.
+ *
+ * Functions:
+ *     dcache_bootstrap  - set up the cache.
+ *     dcache_lookup     - look up a name. Returns true if it's in the
+ *                         cache, and hands back its vnode (with a
+ *                         reference) or NULL if it's a negative entry.
+ *                         On a miss, hands back a generation number
+ *                         to pass to dcache_enter.
+ *     dcache_enter      - add what a lookup that missed found; a null
+ *                         vnode adds a negative entry. Nothing is
+ *                         added if the cache was purged since the
+ *                         lookup, as the result may be out of date.
+ *     dcache_purge      - forget a name in a directory, and, if it
+ *                         was a directory, the names in it.
+ *     dcache_purgefs    - forget everything on a filesystem.
+ *     dcache_printstats - print hit/miss counts.
+ *     dcache_resetstats - zero the counters.
+ */
+
+#define DCACHE_MAX	128	/* most entries */
+#define DCACHE_HASHSIZE	64	/* hash buckets; must be a power of 2 */
+#define DCACHE_NAMELEN	31	/* longest name cached */
+
+void dcache_bootstrap(void);
+bool dcache_lookup(struct vnode *dir, const char *name, struct vnode **ret,
+		   unsigned *gen);
+void dcache_enter(struct vnode *dir, const char *name, struct vnode *vn,
+		  unsigned gen);
+void dcache_purge(struct vnode *dir, const char *name);
+void dcache_purgefs(struct fs *fs);
+void dcache_printstats(void);
+void dcache_resetstats(void);
+
+#endif /* _DCACHE_H_ */
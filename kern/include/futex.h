@@ -0,0 +1,23 @@
+/*
+ * Kernel side of the futex() system call.
+ */
+
+#ifndef _FUTEX_H_
+#define _FUTEX_H_
+
+struct addrspace; /* in addrspace.h */
+
+/*
+ * Threads sleeping in FUTEX_WAIT are kept in a fixed-size hash table
+ * keyed on (address space, user address), one spinlock and wait
+ * channel per bucket. FUTEX_HASHSIZE should be a power of two.
+ */
+#define FUTEX_HASHSIZE	64
+
+/* Call once during system startup to allocate data structures. */
+void futex_bootstrap(void);
+
+/* Wake every thread waiting on a futex in AS; for process exit. */
+void futex_wakeall(struct addrspace *as);
+
+#endif /* _FUTEX_H_ */
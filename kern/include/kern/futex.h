@@ -0,0 +1,22 @@
+/*
+ * Operation codes for the futex() system call. Shared between the
+ * kernel and libc.
+ */
+
+#ifndef _KERN_FUTEX_H_
+#define _KERN_FUTEX_H_
+
+/*
+ * futex(addr, FUTEX_WAIT, val): if the int at ADDR still contains
+ * VAL, sleep until woken by FUTEX_WAKE on the same address. Fails
+ * with EAGAIN without sleeping if it doesn't.
+ *
+ * futex(addr, FUTEX_WAKE, n): wake up to N threads sleeping on ADDR.
+ * Returns the number woken.
+ *
+ * ADDR must be aligned. Futexes are private to an address space.
+ */
+#define FUTEX_WAIT	0
+#define FUTEX_WAKE	1
+
+#endif /* _KERN_FUTEX_H_ */
@@ -0,0 +1,65 @@
+/*
+ * The I/O ring used by the ioring_enter() system call. Shared between
+ * the kernel and libc.
+ */
+
+#ifndef _KERN_IORING_H_
+#define _KERN_IORING_H_
+
+/*
+ * A ring lives in the process's own memory. The process queues
+ * operations on the submission queue (ir_sq) and advances ir_sqtail;
+ * ioring_enter(ring) then does every queued operation, in order, in
+ * one trip into the kernel. The kernel advances ir_sqhead past each
+ * operation it takes and posts a completion for it on ir_cq,
+ * advancing ir_cqtail. The process reads completions and advances
+ * ir_cqhead.
+ *
+ * The indices run freely and wrap; the slot for index I is
+ * I % IORING_SIZE. The kernel stops early, leaving operations on the
+ * submission queue, if the completion queue fills up.
+ *
+ * Operations:
+ *   IORING_OP_READ	read(fd, buf, len)
+ *   IORING_OP_WRITE	write(fd, buf, len)
+ *   IORING_OP_LSEEK	lseek(fd, offset, len), with LEN as whence
+ *   IORING_OP_CLOSE	close(fd)
+ *
+ * Each completion carries the operation's sqe_data, its result (byte
+ * count or new position) and its error code, 0 on success. A failed
+ * operation doesn't stop the ones after it.
+ */
+
+#define IORING_SIZE	32	/* must be a power of 2 */
+
+#define IORING_OP_NOP	0
+#define IORING_OP_READ	1
+#define IORING_OP_WRITE	2
+#define IORING_OP_LSEEK	3
+#define IORING_OP_CLOSE	4
+
+struct ioring_sqe {
+	int sqe_op;		/* IORING_OP_* */
+	int sqe_fd;		/* file handle */
+	void *sqe_buf;		/* buffer for read/write */
+	unsigned sqe_len;	/* length, or whence for lseek */
+	unsigned sqe_data;	/* passed back in the completion */
+	off_t sqe_offset;	/* position for lseek */
+};
+
+struct ioring_cqe {
+	unsigned cqe_data;	/* sqe_data of the operation */
+	int cqe_err;		/* error code, or 0 */
+	off_t cqe_res;		/* result if no error */
+};
+
+struct ioring {
+	volatile unsigned ir_sqhead;	/* advanced by the kernel */
+	volatile unsigned ir_sqtail;	/* advanced by the process */
+	volatile unsigned ir_cqhead;	/* advanced by the process */
+	volatile unsigned ir_cqtail;	/* advanced by the kernel */
+	struct ioring_sqe ir_sq[IORING_SIZE];
+	struct ioring_cqe ir_cq[IORING_SIZE];
+};
+
+#endif /* _KERN_IORING_H_ */
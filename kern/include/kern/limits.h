@@ -82,6 +82,9 @@
 /* Max open files per process */
 #define __OPEN_MAX      128
 
+/* Max threads per process besides the initial one (see thread_create) */
+#define __UTHREAD_MAX   16
+
 /* Max bytes for atomic pipe I/O -- see description in the pipe() man page */
 #define __PIPE_BUF      512
 
@@ -52,8 +52,8 @@
 #define SYS_execv        2
 #define SYS__exit        3
 #define SYS_waitpid      4
-#define SYS_getpid       5
-#define SYS_getppid      6
+#define SYS___getpid     5
+#define SYS___getppid    6
 //                              (virtual memory)
 #define SYS_sbrk         7
 #define SYS_mmap         8
@@ -196,6 +196,12 @@
 #define SYS_sync         118
 #define SYS_reboot       119
 //#define SYS___sysctl   120
+#define SYS_futex        121
+#define SYS_spawn        122
+#define SYS___thread_create 123
+#define SYS_thread_join  124
+#define SYS_thread_exit  125
+#define SYS_ioring_enter 126
 
 /*CALLEND*/
 
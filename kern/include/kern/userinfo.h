@@ -0,0 +1,37 @@
+/*
+ * The user info pages. Shared between the kernel and libc.
+ */
+
+#ifndef _KERN_USERINFO_H_
+#define _KERN_USERINFO_H_
+
+/*
+ * Every process can read two pages at fixed addresses without a
+ * system call. Both are read-only.
+ *
+ * USERINFO_ADDR belongs to the process and holds its pid and its
+ * parent's pid. ui_ppid becomes 0 if the parent exits first.
+ *
+ * USERCLOCK_ADDR is the same page in every process and holds the
+ * time of day as of the last clock tick (1/HZ seconds resolution).
+ * The kernel makes uc_seq odd while it updates the time; a reader
+ * should read uc_seq, the time, and uc_seq again, and retry if the
+ * two differ or are odd.
+ *
+ * The addresses are well below the user stacks.
+ */
+#define USERINFO_ADDR	0x7f000000
+#define USERCLOCK_ADDR	0x7f001000
+
+struct userinfo {
+	pid_t ui_pid;
+	pid_t ui_ppid;
+};
+
+struct userclock {
+	volatile unsigned uc_seq;
+	volatile time_t uc_secs;
+	volatile unsigned long uc_nsecs;
+};
+
+#endif /* _KERN_USERINFO_H_ */
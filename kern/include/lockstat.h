@@ -0,0 +1,71 @@
+/*
+ * Lock contention statistics ("lockstat").
+ */
+
+#ifndef _LOCKSTAT_H_
+#define _LOCKSTAT_H_
+
+#include "opt-lockstat.h"
+
+#if OPT_LOCKSTAT
+
+/*
+ * Per-lock statistics record.
+ *
+ * One of these is embedded in every struct spinlock and struct lock
+ * when the kernel is built with "options lockstat". The counters are
+ * only updated by the thread (or cpu) that currently holds the lock,
+ * so they need no locking of their own. All times are in cpu cycles
+ * as returned by cpu_getcycles().
+ *
+ * Live records are kept on a global list so lockstat_dump() can find
+ * them. Records are put on the list by lockstat_init(), or on first
+ * acquire for spinlocks set up with SPINLOCK_INITIALIZER, and taken
+ * off again by lockstat_cleanup(). This means that a spinlock must be
+ * passed to spinlock_cleanup() before the memory it lives in is
+ * freed, which is required anyway.
+ *
+ * ls_magic/ls_self let lockstat_init recognize a record that is
+ * already on the list (e.g. a static spinlock that gets passed to
+ * spinlock_init more than once) without trusting uninitialized
+ * memory.
+ */
+struct lockstat {
+	const char *ls_name;		/* name for reports, or NULL */
+	bool ls_sleeplock;		/* true for struct lock */
+	unsigned ls_acquires;		/* number of acquires */
+	unsigned ls_contended;		/* acquires that had to wait */
+	uint64_t ls_waittotal;		/* total cycles spent waiting */
+	uint32_t ls_waitmax;		/* longest single wait */
+	uint64_t ls_holdtotal;		/* total cycles held */
+	uint32_t ls_holdmax;		/* longest single hold */
+	uint32_t ls_holdstart;		/* cycle count at last acquire */
+	uint32_t ls_magic;		/* LOCKSTAT_MAGIC while listed */
+	struct lockstat *ls_self;	/* points to itself while listed */
+	struct lockstat *ls_next;	/* global list linkage */
+	struct lockstat **ls_prevp;
+};
+
+/* Initializer for statically allocated records (not yet listed). */
+#define LOCKSTAT_INITIALIZER(name) \
+	{ name, false, 0, 0, 0, 0, 0, 0, 0, 0, NULL, NULL, NULL }
+
+/* Set up and list / unlist a record. */
+void lockstat_init(struct lockstat *ls, const char *name, bool sleeplock);
+void lockstat_cleanup(struct lockstat *ls);
+
+/*
+ * Bookkeeping calls, made while holding the lock. START is the cycle
+ * count from before the acquire began; CONTENDED is true if the lock
+ * was not free on the first try.
+ */
+void lockstat_acquired(struct lockstat *ls, uint32_t start, bool contended);
+void lockstat_released(struct lockstat *ls);
+
+/* Print the MAX worst locks by total wait time; zero all counters. */
+void lockstat_dump(unsigned max);
+void lockstat_reset(void);
+
+#endif /* OPT_LOCKSTAT */
+
+#endif /* _LOCKSTAT_H_ */
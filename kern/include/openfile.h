@@ -52,9 +52,14 @@ struct openfile {
 	struct vnode *of_vnode;
 	int of_accmode;	/* from open: O_RDONLY, O_WRONLY, or O_RDWR */
 
-	struct lock *of_offsetlock;	/* lock for of_offset */
+	struct lock *of_offsetlock;	/* lock for of_offset and of_ra* */
 	off_t of_offset;
 
+	/* Sequential read detection (see sys_readwrite) */
+	off_t of_ranext;	/* where a sequential read would start */
+	off_t of_raend;		/* end of what we've asked to read ahead */
+	off_t of_rawindow;	/* how far ahead to read; 0 if not sequential */
+
 	struct spinlock of_reflock;	/* lock for of_refcount */
 	int of_refcount;
 };
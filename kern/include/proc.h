@@ -36,31 +36,36 @@
  * Note: curproc is defined by <current.h>.
  */
 #include <types.h>
+#include <limits.h>
 #include <spinlock.h>
 #include <synch.h>
 
-/* Define nodes for linked list */
+/* Process table entry; one per PID in use */
 struct pnode{
 	/* Process this node represents. */
 	struct proc *myself;	
 	pid_t pid;
 	pid_t pid_parent;
-	struct semaphore *exitsem;
-
-	int busy;
-	int retcode;	// Exit code here. HEAD contains 32766, TAIL contains 32767
-
-	/* Pointer to next node in table. */
-	/* TAIL contains a NULL pointer */
-	struct pnode *next;
-	
 };
 
-/* Linked List Frame */
-struct pnode *_tail;
-struct pnode *_head;
-struct lock *gpll_lock;
-struct cv *gpll_cv;
+/*
+ * Process table
+ *
+ * The table is an array of pnodes indexed by PID plus a bitmap of
+ * PIDs in use, so every lookup and PID allocation is constant time.
+ * A process' PID is also cached in p_pid.
+ *
+ * gpll_rwlock protects the table: hold it for reading around
+ * proc_getptr/proc_get_pnode/verify_unique_pid, and for writing
+ * around proc_assign/proc_nuke. None of those take it themselves.
+ * proc_getpid just reads p_pid and needs no lock.
+ *
+ * Nothing else about fork or exec is global: the child's address
+ * space and file table are copied with only the parent's own state
+ * locked, and the write lock is held just long enough to enter the
+ * new process in the table.
+ */
+extern struct rwlock *gpll_rwlock;
 
 pid_t pidgen(void);
 /* Internal Methods */
@@ -80,8 +85,24 @@ unsigned int proc_rollcall(void);
 
 struct addrspace;
 struct thread;
+struct userinfo;
 struct vnode;
 
+/*
+ * Extra user threads (see thread_create). Thread id N (1 to
+ * UTHREAD_MAX) uses slot N-1 here and thread stack slot N-1 in the
+ * address space; the initial thread is id 0 and has no slot.
+ */
+#define UT_FREE		0	/* slot unused */
+#define UT_RUNNING	1	/* thread alive */
+#define UT_EXITED	2	/* thread gone, not joined yet */
+
+struct uthread {
+	int ut_state;			/* UT_* */
+	bool ut_joining;		/* someone is in thread_join on it */
+	userptr_t ut_retval;		/* value given to thread_exit */
+};
+
 /*
  * Process structure.
  *
@@ -102,13 +123,30 @@ struct vnode;
 struct proc {
 	char *p_name;			/* Name of this process */
 	struct spinlock p_lock;		/* Lock for this structure */
-	struct semaphore *forksem;
 	unsigned p_numthreads;		/* Number of threads in this process */
-
+	pid_t p_pid;			/* PID, or -1 if not in the table */
+
+	/* User threads; protected by p_lock */
+	struct uthread p_uthreads[UTHREAD_MAX];
+	bool p_exiting;			/* other threads must leave */
+
+	/*
+	 * Family. A process is on its parent's p_children list, linked
+	 * through p_sibling, from fork until it is reaped; parent is
+	 * NULL once nobody will wait for it. All of these, and
+	 * p_zombie and p_exitstatus, are protected by the global wait
+	 * lock in proc.c rather than p_lock.
+	 */
 	struct proc *parent;
+	struct proc *p_children;	/* first child */
+	struct proc *p_sibling;		/* next child of our parent */
+	struct cv *p_waitcv;		/* signalled when a child exits */
+	bool p_zombie;			/* exited, waiting to be reaped */
+	int p_exitstatus;		/* wait status, once a zombie */
 
 	/* VM */
 	struct addrspace *p_addrspace;	/* virtual address space */
+	struct userinfo *p_userinfo;	/* page mapped at USERINFO_ADDR */
 
 	/* VFS */
 	struct vnode *p_cwd;		/* current working directory */
@@ -132,6 +170,41 @@ int proc_fork(struct proc **ret);
 /* Destroy a process. */
 void proc_destroy(struct proc *proc);
 
+/*
+ * Make the current thread the only one in its process: every other
+ * thread is made to leave the next time it would return to user mode,
+ * and this waits until they have. Returns EINTR if some other thread
+ * got there first, in which case the caller should just return to
+ * the syscall layer and it will be made to leave too.
+ */
+int proc_stopthreads(void);
+
+/*
+ * Called on the way back to user mode: leave (never return) if
+ * another thread is stopping this process' threads.
+ */
+void proc_checkexiting(void);
+
+/*
+ * Exit the current thread with RETVAL for thread_join. If it's the
+ * last thread, the process exits with status 0. Does not return.
+ */
+__DEAD void proc_thread_exit(userptr_t retval);
+
+/*
+ * Exit the current process with wait status STATUS (as made by
+ * _MKWAIT_EXIT). Its children are reaped or orphaned; it stays a
+ * zombie until its parent waits for it. Does not return.
+ */
+__DEAD void proc_exit(int status);
+
+/*
+ * Wait for a child of the current process: PID, or any child if PID
+ * is -1. With WNOHANG in OPTIONS, return 0 in RET instead of
+ * sleeping if no suitable child has exited yet.
+ */
+int proc_wait(pid_t pid, int options, int *status, pid_t *ret);
+
 /* Attach a thread to a process. Must not already have a process. */
 int proc_addthread(struct proc *proc, struct thread *t);
 
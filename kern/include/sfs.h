@@ -50,25 +50,58 @@
 
 /*
  * In-memory inode
+ *
+ * sv_lock covers sv_i, sv_dirty, and the file's contents. Reads
+ * take it shared; anything that changes the inode, the file, or a
+ * directory's entries takes it exclusive. sv_ino and the inode type
+ * never change once the vnode is loaded. A directory's name hash
+ * (see sfs_dir.c) is also covered by sv_lock, except that it may be
+ * installed under sfs_vnlock by a lookup holding sv_lock shared.
  */
+struct sfs_dirhash;	/* private to sfs_dir.c */
+
 struct sfs_vnode {
 	struct vnode sv_absvn;          /* abstract vnode structure */
+	struct rwlock *sv_lock;         /* lock for the fields below */
 	struct sfs_dinode sv_i;		/* copy of on-disk inode */
 	uint32_t sv_ino;                /* inode number */
 	bool sv_dirty;                  /* true if sv_i modified */
+	struct sfs_dirhash *sv_dirhash; /* directory name hash, or NULL */
+
+	/* These are covered by sfs_vnlock instead. */
+	struct sfs_vnode *sv_hashnext;  /* vnode table chain */
+	struct sfs_vnode *sv_lruprev;   /* list of cached vnodes */
+	struct sfs_vnode *sv_lrunext;
+	bool sv_cached;                 /* on that list */
 };
 
+/* Number of buckets in a volume's vnode table; must be a power of 2 */
+#define SFS_VNHASHSIZE 64
+
 /*
  * In-memory info for a whole fs volume
+ *
+ * sfs_vnlock covers the table of loaded vnodes (hashed by inode
+ * number) and the list of cached ones; sfs_fslock covers the freemap
+ * and superblock. Lock order: a directory's sv_lock,
+ * then a file's, then sfs_vnlock, then sfs_fslock. The volume name
+ * is never changed while mounted and needs no lock.
  */
 struct sfs_fs {
 	struct fs sfs_absfs;            /* abstract filesystem structure */
+	struct lock *sfs_fslock;        /* lock for freemap and superblock */
 	struct sfs_superblock sfs_sb;	/* copy of on-disk superblock */
 	bool sfs_superdirty;            /* true if superblock modified */
 	struct device *sfs_device;      /* device mounted on */
-	struct vnodearray *sfs_vnodes;  /* vnodes loaded into memory */
+	struct lock *sfs_vnlock;        /* lock for the vnode table */
+	struct sfs_vnode *sfs_vntable[SFS_VNHASHSIZE]; /* loaded vnodes */
+	unsigned sfs_nvnodes;           /* number of loaded vnodes */
+	struct sfs_vnode *sfs_lruhead;  /* cached vnodes, oldest first */
+	struct sfs_vnode *sfs_lrutail;
+	unsigned sfs_ncached;           /* number of cached vnodes */
 	struct bitmap *sfs_freemap;     /* blocks in use are marked 1 */
 	bool sfs_freemapdirty;          /* true if freemap modified */
+	daddr_t sfs_freehint;           /* no free blocks below this one */
 };
 
 /*
@@ -0,0 +1,46 @@
+/*
+ * Sleep queues.
+ *
+ * Threads sleep on a key, which is just an address -- normally the
+ * address of the synchronization primitive being waited for. All
+ * sleeping threads live in one global hash table of SLEEPQ_HASHSIZE
+ * buckets, each with its own spinlock, so a primitive needs no
+ * storage of its own for waiters and creating one doesn't allocate.
+ *
+ * As with wait channels, the caller's spinlock LK protects the
+ * condition being waited for and must be held across each call. The
+ * lock order is LK, then the bucket lock, then the run queue locks.
+ */
+
+#ifndef _SLEEPQ_H_
+#define _SLEEPQ_H_
+
+struct spinlock; /* in spinlock.h */
+
+/* Number of hash buckets; must be a power of 2. */
+#define SLEEPQ_HASHSIZE	128
+
+/* Call once during system startup, before anything sleeps. */
+void sleepq_bootstrap(void);
+
+/*
+ * Sleep on KEY. NAME is shown as the thread's wait channel name. LK
+ * must be held and is the only spinlock that may be held; it is
+ * released while sleeping and reacquired before returning.
+ */
+void sleepq_sleep(const void *key, const char *name, struct spinlock *lk);
+
+/*
+ * Wake the longest sleeping thread, or all threads, sleeping on KEY.
+ */
+void sleepq_wakeone(const void *key, struct spinlock *lk);
+void sleepq_wakeall(const void *key, struct spinlock *lk);
+
+/*
+ * Return true if nothing is sleeping on KEY. For diagnostics and
+ * assertions only.
+ */
+bool sleepq_isempty(const void *key, struct spinlock *lk);
+
+
+#endif /* _SLEEPQ_H_ */
@@ -45,24 +45,44 @@
 /* Get the machine-dependent bits. */
 #include <machine/spinlock.h>
 
+/* Contention statistics, if configured. */
+#include <lockstat.h>
+
 /*
  * Basic spinlock.
  *
  * Note that spinlocks are held by CPUs, not by threads.
  *
+ * This is a ticket lock: an acquiring CPU takes the next number from
+ * splk_next and spins until splk_owner reaches it, so CPUs get the
+ * lock in the order they asked for it and none can be starved.
+ *
  * This structure is made public so spinlocks do not have to be
  * malloc'd; however, code that uses spinlocks should not look inside
  * the structure directly but always use the spinlock API functions.
  */
 struct spinlock {
-	volatile spinlock_data_t splk_lock; /* Memory word where we spin. */
+	volatile spinlock_data_t splk_next;  /* Next ticket to hand out. */
+	volatile spinlock_data_t splk_owner; /* Ticket being served; we spin here. */
 	struct cpu *splk_holder;	    /* CPU holding this lock. */
+#if OPT_LOCKSTAT
+	struct lockstat splk_stat;	    /* Contention statistics. */
+#endif
 };
 
 /*
  * Initializer for cases where a spinlock needs to be static or global.
+ * The _NAMED form gives the lock a name for lockstat reports.
  */
-#define SPINLOCK_INITIALIZER	{ SPINLOCK_DATA_INITIALIZER, NULL }
+#if OPT_LOCKSTAT
+#define SPINLOCK_INITIALIZER_NAMED(name) \
+	{ SPINLOCK_DATA_INITIALIZER, SPINLOCK_DATA_INITIALIZER, NULL, \
+	  LOCKSTAT_INITIALIZER(name) }
+#else
+#define SPINLOCK_INITIALIZER_NAMED(name) \
+	{ SPINLOCK_DATA_INITIALIZER, SPINLOCK_DATA_INITIALIZER, NULL }
+#endif
+#define SPINLOCK_INITIALIZER	SPINLOCK_INITIALIZER_NAMED(NULL)
 
 /*
  * Spinlock functions.
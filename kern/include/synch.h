@@ -32,6 +32,10 @@
 
 /*
  * Header file for synchronization primitives.
+ *
+ * Waiting threads sleep in the global sleep queues (see sleepq.h),
+ * keyed on the primitive's address, so apart from the name nothing
+ * is allocated beyond the structure itself.
  */
 
 
@@ -45,7 +49,6 @@
  */
 struct semaphore {
 	char *sem_name;
-	struct wchan *sem_wchan;
 	struct spinlock sem_lock;
 	volatile unsigned sem_count;
 };
@@ -74,10 +77,12 @@ void V(struct semaphore *);
  */
 struct lock {
         char *lk_name;
-	struct wchan *lk_wchan;
 	struct spinlock lk_spinlock;
 	struct thread *lk_holder;	// Pointer to thread holding the lock; only the POINTER is unique
 	volatile unsigned lock_count;
+#if OPT_LOCKSTAT
+	struct lockstat lk_stat;	// Contention statistics
+#endif
         // add what you need here
         // (don't forget to mark things volatile as needed)
 };
@@ -117,7 +122,6 @@ bool lock_do_i_hold(struct lock *);
 
 struct cv {
         char *cv_name;
-	struct wchan *cv_wchan;	
 	struct spinlock cv_spinlock; 
         // add what you need here
         // (don't forget to mark things volatile as needed)
@@ -153,23 +157,31 @@ void cv_broadcast(struct cv *cv, struct lock *lock);
  * (should be) made internally.
  */
 
-/* Implementation by: William Burgin (waburgin)
- * My implementation uses conditional variables, rather than semaphores so
- * that there is no cap on the number of readers and/or writers. Two different
- * CV's are used between the four different R/W methods. In addition, volatile
- * counters are used to assist the rwlock in identifying cases of starvation
- * and fixing them. See below.
+/*
+ * The lock is fair with writer preference: once a writer is waiting,
+ * new readers queue behind it instead of barging in, so a stream of
+ * readers cannot starve writers. When a writer releases, every reader
+ * queued at that moment is admitted as one batch (one wakeup) ahead
+ * of any further writers, so a stream of writers cannot starve
+ * readers either.
+ *
+ * All state is protected by rw_spinlock; a reader that finds the lock
+ * free and no writer waiting takes it without ever sleeping. Waiting
+ * readers and writers sleep on separate sleep queue keys.
+ *
+ * rw_readgen counts reader batches. A reader that has to wait records
+ * it and sleeps until it changes, at which point it has already been
+ * counted in rw_readers by the writer that admitted it.
  */
-
 struct rwlock {
         char *rw_name;
-	struct cv *conditional_read;	// BROADCASTED to by write
-	struct cv *conditional_write;	// SIGNALED to by read
-	struct lock *rw_lock;			
+	struct spinlock rw_spinlock;
 
-	volatile unsigned int rw_num_readers;	// Current number of active readers
-	volatile unsigned int anti_starvation;  // Number of read_acquires since last write
-	volatile bool is_writer_waiting;	// Flag representing if a writer is waiting for access
+	unsigned rw_readers;		/* Number of active readers */
+	struct thread *rw_writer;	/* Active writer, if any */
+	unsigned rw_readwait;		/* Number of sleeping readers */
+	unsigned rw_writewait;		/* Number of sleeping writers */
+	unsigned rw_readgen;		/* Reader batch generation */
 };
 
 struct rwlock * rwlock_create(const char *);
@@ -183,6 +195,8 @@ void rwlock_destroy(struct rwlock *);
  *    rwlock_acquire_write - Get the lock for writing. Only one thread can
  *                           hold the write lock at one time.
  *    rwlock_release_write - Free the write lock.
+ *    rwlock_do_i_hold_write - Return true if the current thread holds
+ *                           the write lock.
  *
  * These operations must be atomic. You get to write them.
  */
@@ -191,5 +205,6 @@ void rwlock_acquire_read(struct rwlock *);
 void rwlock_release_read(struct rwlock *);
 void rwlock_acquire_write(struct rwlock *);
 void rwlock_release_write(struct rwlock *);
+bool rwlock_do_i_hold_write(struct rwlock *);
 
 #endif /* _SYNCH_H_ */
@@ -33,11 +33,6 @@
 
 #include <cdefs.h> /* for __DEAD */
 struct trapframe; /* from <machine/trapframe.h> */
-struct forkimage{
-	struct trapframe *trap;
-	struct addrspace *addr;
-	struct filetable *filetab;
-};
 
 struct arg{
 	char *str;
@@ -50,11 +45,20 @@ struct arg{
 
 void syscall(struct trapframe *tf);
 
+/*
+ * Size of the dispatch table: one more than the highest call number
+ * in <kern/syscall.h>. Bump it when adding a call past the end.
+ */
+#define SYSCALL_NUM	127
+
+/* Name of call number CALLNO, or NULL if there is no such call. */
+const char *syscall_name(unsigned callno);
+
 /*
  * Support functions.
  */
 
-/* Helper for fork(). You write this. */
+/* Helper for fork(). Takes ownership of TF, which must be kmalloc'd. */
 void enter_forked_process(struct trapframe *tf);
 
 /* Enter user mode. Does not return. */
@@ -82,13 +86,27 @@ int sys_lseek(int fd, off_t offset, int code, off_t *retval);
 int sys_chdir(const_userptr_t path);
 int sys___getcwd(userptr_t buf, size_t buflen, int *retval);
 
-void child(void * fk_img, long unsigned int data2);
+void child(void *tf, long unsigned int data2);
 int sys_fork(struct trapframe *tf, int32_t *childpid);
-int sys_execv(char * program, userptr_t **args, int *retval);
 
-int sys_waitpid(pid_t pid, int *status, int options, int *childpid);
+/* Fork statistics, for the forkstat menu command. */
+void forkstat_print(void);
+void forkstat_reset(void);
+int sys_execv(const_userptr_t program, const_userptr_t args);
+int sys_spawn(const_userptr_t program, const_userptr_t args,
+	      int32_t *childpid);
+
+int sys_waitpid(pid_t pid, userptr_t status, int options, int *childpid);
 int sys__exit(int exitcode);
 
 int sys_getpid(int32_t *retval);
 
+int sys_futex(userptr_t uaddr, int op, int val, int *retval);
+int sys_ioring_enter(userptr_t ring, int *retval);
+
+int sys___thread_create(userptr_t start, userptr_t func, userptr_t arg,
+			int32_t *retval);
+int sys_thread_join(int tid, userptr_t retvalp);
+int sys_thread_exit(userptr_t retval);
+
 #endif /* _SYSCALL_H_ */
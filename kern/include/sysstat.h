@@ -0,0 +1,46 @@
+/*
+ * System call statistics ("sysstat").
+ */
+
+#ifndef _SYSSTAT_H_
+#define _SYSSTAT_H_
+
+struct cpu; /* in cpu.h */
+
+/*
+ * Counters for one call number on one cpu. Each cpu has a table of
+ * SYSCALL_NUM of these (c_sysstat), updated only by that cpu, so
+ * they need no lock. Times are in cycles as returned by
+ * cpu_getcycles().
+ *
+ * Calls are counted on the way in but timed on the way out, so calls
+ * that don't return (_exit, a successful execv, thread_exit) add to
+ * ss_calls but not to the times.
+ */
+struct sysstat {
+	unsigned ss_calls;		/* number of calls */
+	uint64_t ss_cycles;		/* total cycles in the call */
+	uint32_t ss_maxcycles;		/* longest single call */
+};
+
+/* Set up the table for a new cpu. Called by cpu_create. */
+void sysstat_cpuinit(struct cpu *c);
+
+/*
+ * Called by syscall() around each call. sysstat_enter counts the
+ * call and returns the starting cycle count to pass to sysstat_exit.
+ */
+uint32_t sysstat_enter(unsigned callno);
+void sysstat_exit(unsigned callno, uint32_t start);
+
+/*
+ * Report and clear the counters, summed over all cpus. The report is
+ * also readable from user level as the device "sysstat:".
+ */
+void sysstat_print(void);
+void sysstat_reset(void);
+
+/* Create the sysstat: device. */
+void sysstat_bootstrap(void);
+
+#endif /* _SYSSTAT_H_ */
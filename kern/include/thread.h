@@ -82,6 +82,7 @@ struct thread {
 
 	char t_name[MAX_NAME_LENGTH];
 	const char *t_wchan_name;	/* Name of wait channel, if sleeping */
+	const void *t_sleepkey;		/* Sleep queue key, if sleeping */
 	threadstate_t t_state;		/* State this thread is in */
 
 	/*
@@ -115,6 +116,8 @@ struct thread {
 	 * Public fields
 	 */
 
+	int t_tid;			/* User thread id; 0 = initial thread */
+
 	/* add more here as needed */
 };
 
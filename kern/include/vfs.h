@@ -185,8 +185,9 @@ DECLARRAY(vnode, VFSINLINE);
 DEFARRAY(vnode, VFSINLINE);
 
 /*
- * Global one-big-lock for all filesystem operations.
- * You must remove this for the filesystem assignment.
+ * Global one-big-lock for filesystem operations. The mount table
+ * code and emufs still use it; SFS has its own locks (see sfs.h)
+ * and doesn't.
  */
 void vfs_biglock_acquire(void);
 void vfs_biglock_release(void);
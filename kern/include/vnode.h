@@ -85,6 +85,11 @@ struct vnode {
  *                      amount read, and updating uio_offset to match.
  *                      Not allowed on directories or symlinks.
  *
+ *    vop_readahead   - Hint that the LEN bytes at offset POS in a file
+ *                      are about to be read; the file system may start
+ *                      reading them into memory in the background. It's
+ *                      only a hint, so there's no error return.
+ *
  *    vop_readlink    - Read the contents of a symlink into a uio.
  *                      Not allowed on other types of object.
  *
@@ -185,6 +190,7 @@ struct vnode_ops {
 
 
 	int (*vop_read)(struct vnode *file, struct uio *uio);
+	void (*vop_readahead)(struct vnode *file, off_t pos, off_t len);
 	int (*vop_readlink)(struct vnode *link, struct uio *uio);
 	int (*vop_getdirentry)(struct vnode *dir, struct uio *uio);
 	int (*vop_write)(struct vnode *file, struct uio *uio);
@@ -229,6 +235,7 @@ struct vnode_ops {
 #define VOP_RECLAIM(vn)                 (__VOP(vn, reclaim)(vn))
 
 #define VOP_READ(vn, uio)               (__VOP(vn, read)(vn, uio))
+#define VOP_READAHEAD(vn, pos, len)     (__VOP(vn, readahead)(vn, pos, len))
 #define VOP_READLINK(vn, uio)           (__VOP(vn, readlink)(vn, uio))
 #define VOP_GETDIRENTRY(vn, uio)        (__VOP(vn,getdirentry)(vn, uio))
 #define VOP_WRITE(vn, uio)              (__VOP(vn, write)(vn, uio))
@@ -286,6 +293,7 @@ int vopfail_uio_notdir(struct vnode *vn, struct uio *uio);
 int vopfail_uio_isdir(struct vnode *vn, struct uio *uio);
 int vopfail_uio_inval(struct vnode *vn, struct uio *uio);
 int vopfail_uio_nosys(struct vnode *vn, struct uio *uio);
+void vopfail_readahead_ignore(struct vnode *vn, off_t pos, off_t len);
 int vopfail_mmap_isdir(struct vnode *vn /* add stuff */);
 int vopfail_mmap_perm(struct vnode *vn /* add stuff */);
 int vopfail_mmap_nosys(struct vnode *vn /* add stuff */);
@@ -131,6 +131,82 @@ bitmap_translate(unsigned bitno, unsigned *ix, WORD_TYPE *mask)
         *mask = ((WORD_TYPE)1) << offset;
 }
 
+int
+bitmap_alloc_near(struct bitmap *b, unsigned goal, unsigned want,
+                  unsigned *index)
+{
+        unsigned ix, bitno, n, runstart, runlen, first;
+        WORD_TYPE mask;
+        bool found;
+
+        if (goal >= b->nbits) {
+                goal = 0;
+        }
+        if (want == 0) {
+                want = 1;
+        }
+
+        /*
+         * Walk every bit once, starting at GOAL. Runs don't continue
+         * across the wraparound, which is fine for a preference.
+         */
+        found = false;
+        first = 0;
+        runstart = 0;
+        runlen = 0;
+        for (n = 0; n < b->nbits; n++) {
+                bitno = goal + n;
+                if (bitno >= b->nbits) {
+                        bitno -= b->nbits;
+                }
+                if (bitno == 0) {
+                        runlen = 0;
+                }
+                bitmap_translate(bitno, &ix, &mask);
+
+                /* Skip full words quickly. */
+                if (bitno % BITS_PER_WORD == 0 && b->v[ix] == WORD_ALLBITS &&
+                    bitno + BITS_PER_WORD <= b->nbits &&
+                    n + BITS_PER_WORD <= b->nbits) {
+                        n += BITS_PER_WORD - 1;
+                        runlen = 0;
+                        continue;
+                }
+
+                if (b->v[ix] & mask) {
+                        runlen = 0;
+                        continue;
+                }
+
+                if (!found) {
+                        found = true;
+                        first = bitno;
+                        if (n == 0) {
+                                /* GOAL itself is free */
+                                break;
+                        }
+                }
+                if (runlen == 0) {
+                        runstart = bitno;
+                }
+                runlen++;
+                if (runlen >= want) {
+                        first = runstart;
+                        break;
+                }
+        }
+
+        if (!found) {
+                return ENOSPC;
+        }
+
+        bitmap_translate(first, &ix, &mask);
+        KASSERT((b->v[ix] & mask) == 0);
+        b->v[ix] |= mask;
+        *index = first;
+        return 0;
+}
+
 void
 bitmap_mark(struct bitmap *b, unsigned index)
 {
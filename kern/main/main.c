@@ -45,8 +45,13 @@
 #include <vm.h>
 #include <mainbus.h>
 #include <vfs.h>
+#include <bio.h>
+#include <buf.h>
+#include <dcache.h>
+#include <futex.h>
 #include <device.h>
 #include <syscall.h>
+#include <sysstat.h>
 #include <test.h>
 #include <kern/test161.h>
 #include <version.h>
@@ -112,6 +117,11 @@ boot(void)
 	thread_bootstrap();
 	hardclock_bootstrap();
 	vfs_bootstrap();
+	dcache_bootstrap();
+	bio_bootstrap();
+	buf_bootstrap();
+	futex_bootstrap();
+	sysstat_bootstrap();
 	kheap_nextgeneration();
 	
 	gpll_bootstrap();
@@ -120,6 +130,7 @@ boot(void)
 	KASSERT(curthread->t_curspl > 0);
 	mainbus_bootstrap();
 	KASSERT(curthread->t_curspl == 0);
+	userclock_start();
 	/* Now do pseudo-devices. */
 	pseudoconfig();
 	kprintf("\n");
@@ -39,14 +39,20 @@
 #include <thread.h>
 #include <proc.h>
 #include <vfs.h>
+#include <bio.h>
+#include <buf.h>
+#include <dcache.h>
 #include <sfs.h>
 #include <syscall.h>
 #include <test.h>
 #include <prompt.h>
+#include <lockstat.h>
+#include <sysstat.h>
 #include "opt-sfs.h"
 #include "opt-net.h"
 #include "opt-synchprobs.h"
 #include "opt-automationtest.h"
+#include "opt-lockstat.h"
 
 /*
  * In-kernel menu and command dispatcher.
@@ -94,8 +100,8 @@ cmd_progthread(void *ptr, unsigned long nargs)
 	if (result) {
 		kprintf("Running program %s failed: %s\n", args[0],
 			strerror(result));
-		//sys__exit(1);
-		return;
+		/* Exit properly so common_prog's wait returns. */
+		sys__exit(1);
 	}
 
 	sys__exit(0);
@@ -118,10 +124,9 @@ static
 int
 common_prog(int nargs, char **args)
 {
-	struct pnode *pnode;
 	struct proc *proc;
+	pid_t pid, retval;
 	int childexit; 
-	int retval;
 	int result;
 	unsigned tc;
 
@@ -135,16 +140,9 @@ common_prog(int nargs, char **args)
 		return ENOMEM;
 	}
 
-	pnode = proc_get_pnode(proc);
-	if (pnode == NULL){
-		kprintf("Error grabbing process node.\n");
-		return result;
-	}	
+	/* Get this now; proc belongs to the wait code once it runs. */
+	pid = proc->p_pid;
 
-	/* New process is a child, simulate having a parent */
-	//struct proc *parentproc;
-	//parentproc = kmalloc(sizeof(*parentproc));
-	//proc->parent = parentproc;
 	tc = thread_count;
 
 	result = thread_fork(args[0] /* thread name */,
@@ -157,18 +155,13 @@ common_prog(int nargs, char **args)
 		return result;
 	}
 	
-	sys_waitpid(pnode->pid, &childexit, 0, &retval); 
+	/* Reaping the child destroys its process. */
+	result = proc_wait(pid, 0, &childexit, &retval);
 	if(result){
 		kprintf("Thread wait failed at menu fork.\n");
-		proc_destroy(proc);
 		return result;
 	}
 
-	/*
-	 * The new process will be destroyed when the program exits...
-	 * once you write the code for handling that.
-	 */
-
 	// Wait for all threads to finish cleanup, otherwise khu be a bit behind,
 	// especially once swapping is enabled.
 	thread_wait_for_count(tc);
@@ -451,6 +444,139 @@ cmd_kheapdump(int nargs, char **args)
 	return 0;
 }
 
+/*
+ * Command for printing fork statistics.
+ */
+static
+int
+cmd_forkstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		forkstat_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		forkstat_reset();
+	}
+	else {
+		kprintf("Usage: forkstat [reset]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Command for printing system call statistics.
+ */
+static
+int
+cmd_sysstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		sysstat_print();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		sysstat_reset();
+	}
+	else {
+		kprintf("Usage: sysstat [reset]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Command for printing buffer cache statistics, or setting the
+ * maximum number of buffers.
+ */
+static
+int
+cmd_bufstat(int nargs, char **args)
+{
+	int max, result;
+
+	if (nargs == 1) {
+		buf_printstats();
+		bio_printstats();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		buf_resetstats();
+		bio_resetstats();
+	}
+	else if (nargs == 3 && !strcmp(args[1], "size")) {
+		max = atoi(args[2]);
+		if (max < BUF_MINMAX) {
+			kprintf("bufstat: size must be at least %d\n",
+				BUF_MINMAX);
+			return EINVAL;
+		}
+		result = buf_setmax(max);
+		if (result) {
+			kprintf("bufstat: %s\n", strerror(result));
+			return result;
+		}
+	}
+	else {
+		kprintf("Usage: bufstat [reset | size buffers]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Command for printing name cache statistics.
+ */
+static
+int
+cmd_dcstat(int nargs, char **args)
+{
+	if (nargs == 1) {
+		dcache_printstats();
+	}
+	else if (nargs == 2 && !strcmp(args[1], "reset")) {
+		dcache_resetstats();
+	}
+	else {
+		kprintf("Usage: dcstat [reset]\n");
+		return EINVAL;
+	}
+
+	return 0;
+}
+
+#if OPT_LOCKSTAT
+/*
+ * Command for printing lock contention statistics.
+ */
+static
+int
+cmd_lockstat(int nargs, char **args)
+{
+	int max;
+
+	if (nargs == 2 && !strcmp(args[1], "reset")) {
+		lockstat_reset();
+		return 0;
+	}
+	if (nargs > 2) {
+		kprintf("Usage: lockstat [count | reset]\n");
+		return EINVAL;
+	}
+
+	max = (nargs == 2) ? atoi(args[1]) : 20;
+	if (max <= 0) {
+		kprintf("Usage: lockstat [count | reset]\n");
+		return EINVAL;
+	}
+
+	lockstat_dump(max);
+
+	return 0;
+}
+#endif
+
 ////////////////////////////////////////
 //
 // Menus.
@@ -536,6 +662,8 @@ static const char *testmenu[] = {
 	"[rwt3] RW lock test 3        (1?)   ",
 	"[rwt4] RW lock test 4        (1?)   ",
 	"[rwt5] RW lock test 5        (1?)   ",
+	"[rwt6] RW lock throughput     (1)    ",
+	"[spt1] Spinlock stress test  (1)    ",
 #if OPT_SYNCHPROBS
 	"[sp1] Whalemating test       (1)    ",
 	"[sp2] Stoplight test         (1)    ",
@@ -598,6 +726,13 @@ static const char *mainmenu[] = {
 	"[khu] Kernel heap usage             ",
 	"[khgen] Next kernel heap generation ",
 	"[khdump] Dump kernel heap           ",
+	"[forkstat] Fork statistics          ",
+	"[sysstat] System call statistics    ",
+	"[bufstat] Buffer cache statistics   ",
+	"[dcstat] Name cache statistics      ",
+#if OPT_LOCKSTAT
+	"[lockstat] Lock contention stats    ",
+#endif
 	"[q] Quit and shut down              ",
 	NULL
 };
@@ -651,6 +786,13 @@ static struct {
 	{ "khu",        cmd_kheapused },
 	{ "khgen",      cmd_kheapgeneration },
 	{ "khdump",     cmd_kheapdump },
+	{ "forkstat",   cmd_forkstat },
+	{ "sysstat",    cmd_sysstat },
+	{ "bufstat",    cmd_bufstat },
+	{ "dcstat",     cmd_dcstat },
+#if OPT_LOCKSTAT
+	{ "lockstat",   cmd_lockstat },
+#endif
 
 	/* base system tests */
 	{ "at",		arraytest },
@@ -684,6 +826,8 @@ static struct {
 	{ "rwt3",	rwtest3 },
 	{ "rwt4",	rwtest4 },
 	{ "rwt5",	rwtest5 },
+	{ "rwt6",	rwtest6 },
+	{ "spt1",	spinlocktest },
 #if OPT_SYNCHPROBS
 	{ "sp1",	whalemating },
 	{ "sp2",	stoplight },
@@ -46,12 +46,17 @@
 #include <limits.h>
 #include <lib.h>
 #include <kern/errno.h>
+#include <kern/wait.h>
+#include <kern/userinfo.h>
 #include <spl.h>
 #include <proc.h>
 #include <current.h>
+#include <thread.h>
+#include <sleepq.h>
 #include <addrspace.h>
 #include <vnode.h>
 #include <filetable.h>
+#include <futex.h>
 
 /*
  * The process for the kernel; this holds all the kernel-only threads.
@@ -59,132 +64,164 @@
 struct proc *kproc;
 volatile unsigned int num_processes;
 
+/*
+ * Process table. proc_table is indexed directly by PID; pid_map has
+ * a bit set for every PID in use (including the reserved ones below
+ * __PID_MIN), so allocation is a scan for a word that isn't all
+ * ones. pid_next is where the next scan starts: PIDs are handed out
+ * in increasing order and wrap around, so a PID isn't reused until
+ * the rest of the space has been cycled through, and the scan
+ * normally stops at the first word it looks at.
+ */
+#define PID_WORDS	((__PID_MAX + 1 + 31) / 32)
+
+struct rwlock *gpll_rwlock;
+static struct pnode *proc_table[__PID_MAX + 1];
+static uint32_t pid_map[PID_WORDS];
+static pid_t pid_next;
+
+/*
+ * The wait lock protects every process' family links and exit state
+ * (parent, p_children, p_sibling, p_zombie, p_exitstatus). Exit and
+ * wait only look at the process' own children, never the whole
+ * table. The order is proc_waitlock, then gpll_rwlock.
+ */
+static struct lock *proc_waitlock;
+
+/* Allocate an unused PID, or return -1 if there are none. */
 pid_t
 pidgen(void){
-	// Return a random pid between 2 and 32767
-	return (pid_t)(random() % (__PID_MAX + 1 - __PID_MIN) + __PID_MIN);	
+	unsigned word, bit, i;
+	uint32_t used;
+	pid_t pid;
+
+	/*
+	 * Look at every word once, starting with pid_next's, then at
+	 * pid_next's word again in case the only free PIDs left are
+	 * the ones below pid_next in it.
+	 */
+	word = pid_next / 32;
+	for (i = 0; i <= PID_WORDS; i++) {
+		used = pid_map[word];
+		if (i == 0) {
+			used |= (1U << (pid_next % 32)) - 1;
+		}
+		if (used != 0xffffffff) {
+			for (bit = 0; used & (1U << bit); bit++) {
+				/* nothing */
+			}
+			pid = word * 32 + bit;
+			KASSERT(pid >= __PID_MIN && pid <= __PID_MAX);
+			pid_map[word] |= 1U << bit;
+			pid_next = (pid == __PID_MAX) ? __PID_MIN : pid + 1;
+			return pid;
+		}
+		word = (word + 1) % PID_WORDS;
+	}
+
+	return -1;
+}
+
+/* Release a PID for reuse. */
+static
+void
+pidfree(pid_t pid){
+	KASSERT(pid >= __PID_MIN && pid <= __PID_MAX);
+	KASSERT(pid_map[pid / 32] & (1U << (pid % 32)));
+	pid_map[pid / 32] &= ~(1U << (pid % 32));
 }
 
 
 /* Initialize process table. Called in: main.c */
 void
 gpll_bootstrap(void){			// Stands for global-processes linked list
-	_tail = kmalloc(sizeof(struct pnode));
-	_tail->myself = NULL;
-	_tail->pid = -2;
-	_tail->retcode = 32767;
-	_tail->next = NULL;
+	pid_t pid;
 
-	_head = kmalloc(sizeof(struct pnode));
-	_head->myself = NULL;
-	_head->pid = -1;
-	_head->retcode = 32766;
-	_head->next = _tail;
+	for (pid = 0; pid <= __PID_MAX; pid++) {
+		proc_table[pid] = NULL;
+	}
+	bzero(pid_map, sizeof(pid_map));
+
+	/* PIDs below __PID_MIN (and any bits past __PID_MAX) are never used. */
+	for (pid = 0; pid < PID_WORDS * 32; pid++) {
+		if (pid < __PID_MIN || pid > __PID_MAX) {
+			pid_map[pid / 32] |= 1U << (pid % 32);
+		}
+	}
+	pid_next = __PID_MIN;
 
-	gpll_lock = lock_create("GPLL Lock");
-	gpll_cv = cv_create("GPLL CV");
+	gpll_rwlock = rwlock_create("GPLL RWLock");
+	proc_waitlock = lock_create("proc wait");
 
 	num_processes = 0;
 
-	KASSERT(_tail != NULL);
-	KASSERT(_head != NULL);
+	KASSERT(gpll_rwlock != NULL);
+	KASSERT(proc_waitlock != NULL);
 
 	return;
 }
 
-/* Assigns a process to the process list. This is the function that physically adds new nodes
- * to the global linked-list that keeps track of all processes. Each process is assigned it's
- * own, unique PID. This function also assigns the process as "active", meaning it can/is running
- * in the system currently. On the contrary, processes that are not active, but exist in the linked
- * list are children who have exited, but are still waiting on their parent to collect the exit
- * code.
+/* Assigns a process to the process table. This creates the process' pnode and gives the
+ * process it's own, unique PID, which is also cached in the proc so nothing has to look it
+ * up. The pnode stays in the table after the process exits, until its parent has collected
+ * the exit status (see proc_wait).
  */
 
 void
 proc_assign(struct proc *process){
 
 	struct pnode *node;
+	pid_t pid;
 	
-	//kprintf("Assign.\n");
 	// Create pnode and fill it with some information
 	node = kmalloc(sizeof(*node));
-	node->retcode = 0;
 	if( node == NULL ){
-		//kprintf("Node.\n");
-		kfree(node);
 		return;
 	}
+	node->pid_parent = -1;
 
-	node->exitsem = sem_create("exitsem", 0);
-	
-	// Generate a UNIQUE process ID and assign it
-	pid_t attempt = pidgen();
-	while( verify_unique_pid(attempt) == false ){
-		attempt = pidgen();
+	// Get a PID that nobody else has
+	pid = pidgen();
+	if( pid < 0 ){
+		kfree(node);
+		return;
 	}
-	node->pid = attempt;
-	//kprintf("Created: %d\n", attempt);
+	node->pid = pid;
 
 	/* Make the node aware of it's own process */
 	node->myself = process;		// Do not move.
 
-	/* Now fill into front of linked list (after _head of course) */
-	struct pnode *nptr;
-	nptr = _head->next;
-	_head->next = node;
-	node->next = nptr;
+	KASSERT(proc_table[pid] == NULL);
+	proc_table[pid] = node;
+	process->p_pid = pid;
 
 	num_processes++;
-	//kprintf("Num: %d\n", num_processes);
 
 	return;
 }
 
 
-/* Destroys a process and associated pnode completely. This is called by parents processes
- * who exit as well as by children after their exit code has been collected or respective
- * parent has exited.
+/* Destroys a process' pnode completely and frees its PID. This is called by parents
+ * processes who exit as well as by children after their exit code has been collected
+ * or respective parent has exited.
  */
 
 int
 proc_nuke(struct proc *process){
-	// Find the pnode the process is in
-	struct pnode *current;
-	struct pnode *last;
-	
-	//kprintf("Nuking: ");
-	
-	//current = kmalloc(sizeof(*current));
-	//last = kmalloc(sizeof(*last));
-	
-	current = _head;	
-
-	while( current->next != NULL ){
-		if( (current->next)->myself == process ){		// Compare pointers
-			last = current;
-			current = current->next;
-			break;
-		}		
-
-		current = current->next;
-	}
-	//kprintf("Del: %d\n", current->pid);
+	struct pnode *node;
 
-	if( current->pid == -1 || current->pid == -2){
+	node = proc_get_pnode(process);
+	if( node == NULL ){
 		kprintf("Err.\n");
 		return ENOMEM;
-	}	
+	}
 
-	
-	// Reassign pointers
-	last->next = current->next;
+	proc_table[node->pid] = NULL;
+	pidfree(node->pid);
+	process->p_pid = -1;
 
-	sem_destroy(current->exitsem);
-	// Free memory at process' pnode
-	
-	kfree(current);
+	kfree(node);
 	num_processes--;
-	//kprintf("Num: %d\n", num_processes);
 
 	return 0;
 }
@@ -192,53 +229,30 @@ proc_nuke(struct proc *process){
 /* Returns a pointer to a process with supplied PID */
 struct proc *
 proc_getptr(pid_t id){
-	struct pnode *current;
-	//current = kmalloc(sizeof(*current));
-	current = _head->next;
-
-	while( current->next != NULL ){
-		if(current->pid == id){
-			return current->myself;
-		}
-
-		current = current->next;
+	if( id < __PID_MIN || id > __PID_MAX || proc_table[id] == NULL ){
+		return NULL;
 	}
-
-	return NULL;
+	return proc_table[id]->myself;
 }
 
 /* Returns PID of a process with supplied process ptr */
 pid_t
 proc_getpid(struct proc *process){
-	struct pnode *current;
-	//current = kmalloc(sizeof(*current));
-	current = _head->next;
-
-	while( current->next != NULL ){
-		if(current->myself == process){
-			return current->pid;
-		}
-		current = current->next;
+	if( process == NULL ){
+		return -1;
 	}
-
-	return -1;
+	return process->p_pid;
 }
 
 /* Gets a pointer to the pnode that contains the given process */
 struct pnode *
 proc_get_pnode(struct proc *process){
-	struct pnode *current;
-	//current = kmalloc(sizeof(*current));
-	current = _head->next;
-
-	while( current->next != NULL ){
-		if(current->myself == process){
-			return current;
-		}
-		current = current->next;
+	if( process == NULL || process->p_pid < 0 ){
+		return NULL;
 	}
-
-	return NULL;
+	KASSERT(proc_table[process->p_pid] != NULL);
+	KASSERT(proc_table[process->p_pid]->myself == process);
+	return proc_table[process->p_pid];
 }
 /* Returns the current number of user processes */
 unsigned int
@@ -246,43 +260,58 @@ proc_rollcall(void){
 	return num_processes;
 }
 
-/*
-struct pnode *
-proc_get_pnodelst(struct proc *process){
-	struct pnode *current;
-	current = _head;
-	
-	while( current->next != NULL){
-		int id = proc_getpid(current->pid);
-		if( id		
-
+/* Returns false if the PID is in use. */
+bool
+verify_unique_pid(pid_t id){
+	if( id < 0 || id > __PID_MAX ){
+		return false;
 	}
+	return (pid_map[id / 32] & (1U << (id % 32))) == 0;
 }
-*/
 
-/* Compares a PID to the enitre process list and returns false 
- * if the PID is not unique. 
+
+
+
+/*
+ * Make PROC a child of the current process. PROC must be new.
  */
-bool
-verify_unique_pid(pid_t id){
-	struct pnode *current;
-	//current = kmalloc(sizeof(*current));
-	current = _head;	
-
-	// Traverse until _tail
-	while( current->next != NULL ){
-		if(current->pid == id){
-			return false;
-		}
-		
-		current = current->next;
-	}
+static
+void
+proc_adopt(struct proc *proc)
+{
+	KASSERT(proc->parent == NULL);
 
-	return true;
+	lock_acquire(proc_waitlock);
+	proc->parent = curproc;
+	proc->p_sibling = curproc->p_children;
+	curproc->p_children = proc;
+	proc->p_userinfo->ui_pid = proc->p_pid;
+	proc->p_userinfo->ui_ppid = curproc->p_pid;
+	lock_release(proc_waitlock);
 }
 
+/*
+ * Take PROC off its parent's list of children. Call with the wait
+ * lock held.
+ */
+static
+void
+proc_unlink(struct proc *proc)
+{
+	struct proc **pp;
 
+	KASSERT(lock_do_i_hold(proc_waitlock));
+	KASSERT(proc->parent != NULL);
 
+	for (pp = &proc->parent->p_children; *pp != proc;
+	     pp = &(*pp)->p_sibling) {
+		KASSERT(*pp != NULL);
+	}
+	*pp = proc->p_sibling;
+	proc->p_sibling = NULL;
+	proc->parent = NULL;
+	proc->p_userinfo->ui_ppid = 0;
+}
 
 /*
  * Create a proc structure.
@@ -293,6 +322,7 @@ struct proc *
 proc_create(const char *name)
 {
 	struct proc *proc;
+	unsigned i;
 
 	proc = kmalloc(sizeof(*proc));
 	if (proc == NULL) {
@@ -305,14 +335,34 @@ proc_create(const char *name)
 	}
 
 	proc->p_numthreads = 0;
+	proc->p_pid = -1;
 	spinlock_init(&proc->p_lock);
-	
-	proc->forksem = sem_create("forksem", 0);
-	if (proc->forksem == NULL){
+
+	for (i = 0; i < UTHREAD_MAX; i++) {
+		proc->p_uthreads[i].ut_state = UT_FREE;
+		proc->p_uthreads[i].ut_joining = false;
+		proc->p_uthreads[i].ut_retval = NULL;
+	}
+	proc->p_exiting = false;
+
+	proc->p_waitcv = cv_create("p_waitcv");
+	if (proc->p_waitcv == NULL) {
+		kfree(proc->p_name);
 		kfree(proc);
 		return NULL;
 	}
 
+	/* A whole page, so kmalloc hands back a page-aligned one. */
+	proc->p_userinfo = kmalloc(PAGE_SIZE);
+	if (proc->p_userinfo == NULL) {
+		cv_destroy(proc->p_waitcv);
+		kfree(proc->p_name);
+		kfree(proc);
+		return NULL;
+	}
+	bzero(proc->p_userinfo, PAGE_SIZE);
+	proc->p_userinfo->ui_pid = -1;
+	
 	/* VM fields */
 	proc->p_addrspace = NULL;
 
@@ -321,6 +371,10 @@ proc_create(const char *name)
 	proc->p_filetable = NULL;
 	
 	proc->parent = NULL;
+	proc->p_children = NULL;
+	proc->p_sibling = NULL;
+	proc->p_zombie = false;
+	proc->p_exitstatus = 0;
 
 	return proc;
 }
@@ -350,7 +404,15 @@ proc_destroy(struct proc *proc)
 	 * reference to this structure. (Otherwise it would be
 	 * incorrect to destroy it.)
 	 */
-	
+
+	/* Family: only a child that never ran still has a parent here. */
+	if (proc->parent != NULL) {
+		lock_acquire(proc_waitlock);
+		proc_unlink(proc);
+		lock_release(proc_waitlock);
+	}
+	KASSERT(proc->p_children == NULL);
+
 	/* VFS fields */
 	if (proc->p_cwd) {
 		VOP_DECREF(proc->p_cwd);
@@ -362,10 +424,14 @@ proc_destroy(struct proc *proc)
 	}
 	
 	int result;
-	// Remove from process list
-	result = proc_nuke(proc);
-	if(result){
-		return;
+	// Remove from process table, unless it never got a PID
+	if (proc->p_pid >= 0) {
+		rwlock_acquire_write(gpll_rwlock);
+		result = proc_nuke(proc);
+		rwlock_release_write(gpll_rwlock);
+		if(result){
+			return;
+		}
 	}
 
 	/* VM fields */
@@ -418,9 +484,10 @@ proc_destroy(struct proc *proc)
 
 
 	KASSERT(proc->p_numthreads == 0);
+	cv_destroy(proc->p_waitcv);
+	kfree(proc->p_userinfo);
 	spinlock_cleanup(&proc->p_lock);
 
-	sem_destroy(proc->forksem);
 	
 	kfree(proc->p_name);
 	kfree(proc);
@@ -475,8 +542,17 @@ proc_create_runprogram(const char *name)
 	}
 	spinlock_release(&curproc->p_lock);
 
-	// Add to process list
+	// Add to process table
+	rwlock_acquire_write(gpll_rwlock);
 	proc_assign(newproc);
+	rwlock_release_write(gpll_rwlock);
+	if (newproc->p_pid < 0) {
+		proc_destroy(newproc);
+		return NULL;
+	}
+
+	/* The menu waits for it like any other parent. */
+	proc_adopt(newproc);
 
 	return newproc;
 }
@@ -527,26 +603,198 @@ proc_fork(struct proc **ret)
 	}
 	spinlock_release(&curproc->p_lock);
 
-	// Assign parent to new forked process
-	proc->parent = curproc;
-
-	*ret = proc;
-	
-	// Add to process list
-	proc_assign(*ret);
+	// Add to process table
+	rwlock_acquire_write(gpll_rwlock);
+	proc_assign(proc);
 
 	struct pnode *node;
-	struct pnode *parnode;
-	parnode = proc_get_pnode(curproc);
 	node = proc_get_pnode(proc);
-	if(node != NULL && parnode != NULL){
-		node->pid_parent = parnode->pid;
+	if(node != NULL){
+		node->pid_parent = curproc->p_pid;
 	}	
+	rwlock_release_write(gpll_rwlock);
+
+	if (proc->p_pid < 0) {
+		/* Out of PIDs (or memory for the pnode) */
+		proc_destroy(proc);
+		return ENPROC;
+	}
+
+	proc_adopt(proc);
+
+	*ret = proc;
 
 
 	return 0;
 }
 
+/*
+ * Exit the current process.
+ *
+ * Any other threads are stopped first (see proc_stopthreads); if
+ * another thread is already exiting or exec'ing, this one just goes.
+ * The address space, files and cwd are released right away; a zombie
+ * needs nothing but its exit status. Then the thread leaves the
+ * process, so whoever destroys the proc doesn't have to wait for it.
+ * Children that have already exited are reaped here and the rest are
+ * orphaned: with no parent, they destroy themselves when they exit.
+ * Likewise if nobody is left to wait for us.
+ */
+void
+proc_exit(int status)
+{
+	struct proc *proc = curproc;
+	struct proc *child;
+	struct addrspace *as;
+	struct filetable *tbl;
+	struct vnode *cwd;
+
+	KASSERT(proc != NULL);
+	KASSERT(proc != kproc);
+
+	if (proc_stopthreads()) {
+		proc_remthread(curthread);
+		thread_exit();
+	}
+
+	as = proc_setas(NULL);
+	as_deactivate();
+	if (as != NULL) {
+		as_destroy(as);
+	}
+
+	spinlock_acquire(&proc->p_lock);
+	tbl = proc->p_filetable;
+	proc->p_filetable = NULL;
+	cwd = proc->p_cwd;
+	proc->p_cwd = NULL;
+	spinlock_release(&proc->p_lock);
+
+	if (tbl != NULL) {
+		filetable_destroy(tbl);
+	}
+	if (cwd != NULL) {
+		VOP_DECREF(cwd);
+	}
+
+	/* From here on we're just a kernel thread; curproc is NULL. */
+	proc_remthread(curthread);
+
+	lock_acquire(proc_waitlock);
+	while ((child = proc->p_children) != NULL) {
+		proc->p_children = child->p_sibling;
+		child->p_sibling = NULL;
+		child->parent = NULL;
+		child->p_userinfo->ui_ppid = 0;
+		if (child->p_zombie) {
+			proc_destroy(child);
+		}
+	}
+
+	proc->p_exitstatus = status;
+	if (proc->parent == NULL) {
+		lock_release(proc_waitlock);
+		proc_destroy(proc);
+	}
+	else {
+		proc->p_zombie = true;
+		cv_broadcast(proc->parent->p_waitcv, proc_waitlock);
+		lock_release(proc_waitlock);
+	}
+
+	thread_exit();
+}
+
+/*
+ * Wait for a child of the current process to exit and reap it.
+ *
+ * Only our own children are looked at. A child that has exited is
+ * taken off the list and destroyed after the wait lock is dropped;
+ * nobody else can reach it by then.
+ */
+int
+proc_wait(pid_t pid, int options, int *status, pid_t *ret)
+{
+	struct proc *proc = curproc;
+	struct proc *child, *found;
+	bool any;
+
+	if ((options & ~(WNOHANG | WUNTRACED)) != 0) {
+		return EINVAL;
+	}
+	if (pid == 0 || pid < -1) {
+		/* No process groups. */
+		return ENOSYS;
+	}
+
+	lock_acquire(proc_waitlock);
+	while (1) {
+		any = false;
+		found = NULL;
+		for (child = proc->p_children; child != NULL;
+		     child = child->p_sibling) {
+			if (pid != -1 && child->p_pid != pid) {
+				continue;
+			}
+			any = true;
+			if (child->p_zombie) {
+				found = child;
+				break;
+			}
+		}
+		if (found != NULL || !any || (options & WNOHANG) ||
+		    proc->p_exiting) {
+			break;
+		}
+		cv_wait(proc->p_waitcv, proc_waitlock);
+	}
+
+	if (found == NULL && proc->p_exiting) {
+		/* Another thread is exiting; we're going away. */
+		lock_release(proc_waitlock);
+		return EINTR;
+	}
+	if (found == NULL) {
+		lock_release(proc_waitlock);
+		if (!any) {
+			return ECHILD;
+		}
+		/* WNOHANG, and nothing has exited yet */
+		*ret = 0;
+		return 0;
+	}
+
+	proc_unlink(found);
+	lock_release(proc_waitlock);
+
+	*status = found->p_exitstatus;
+	*ret = found->p_pid;
+	proc_destroy(found);
+	return 0;
+}
+
+/*
+ * Detach T from PROC with p_lock held. If the process' threads are
+ * being stopped, let proc_stopthreads know one more has gone.
+ */
+static
+void
+proc_remthread_locked(struct proc *proc, struct thread *t)
+{
+	int spl;
+
+	KASSERT(spinlock_do_i_hold(&proc->p_lock));
+	KASSERT(proc->p_numthreads > 0);
+	proc->p_numthreads--;
+	if (proc->p_exiting) {
+		sleepq_wakeall(&proc->p_numthreads, &proc->p_lock);
+	}
+
+	spl = splhigh();
+	t->t_proc = NULL;
+	splx(spl);
+}
+
 /*
  * Add a thread to a process. Either the thread or the process might
  * or might not be current.
@@ -564,6 +812,11 @@ proc_addthread(struct proc *proc, struct thread *t)
 	KASSERT(t->t_proc == NULL);
 
 	spinlock_acquire(&proc->p_lock);
+	if (proc->p_exiting) {
+		/* Too late; proc_stopthreads wants everyone out. */
+		spinlock_release(&proc->p_lock);
+		return EINTR;
+	}
 	proc->p_numthreads++;
 	spinlock_release(&proc->p_lock);
 
@@ -587,19 +840,115 @@ void
 proc_remthread(struct thread *t)
 {
 	struct proc *proc;
-	int spl;
 
 	proc = t->t_proc;
 	KASSERT(proc != NULL);
 
 	spinlock_acquire(&proc->p_lock);
-	KASSERT(proc->p_numthreads > 0);
-	proc->p_numthreads--;
+	proc_remthread_locked(proc, t);
 	spinlock_release(&proc->p_lock);
+}
 
-	spl = splhigh();
-	t->t_proc = NULL;
-	splx(spl);
+/*
+ * Make the current thread the only one in its process.
+ *
+ * p_exiting tells the others to leave: they check it on the way back
+ * to user mode (proc_checkexiting), proc_addthread refuses new ones,
+ * and anything sleeping where it could stay forever -- thread_join,
+ * waitpid, futex waits -- is woken so it gets there. Threads blocked
+ * elsewhere in the kernel (e.g. reading the console) hold this up
+ * until they return. Each leaving thread wakes us from
+ * proc_remthread_locked.
+ */
+int
+proc_stopthreads(void)
+{
+	struct proc *proc = curproc;
+	struct addrspace *as;
+	unsigned i;
+
+	spinlock_acquire(&proc->p_lock);
+	if (proc->p_exiting) {
+		spinlock_release(&proc->p_lock);
+		return EINTR;
+	}
+	if (proc->p_numthreads == 1) {
+		/* Nobody else; nobody can be creating any either. */
+		spinlock_release(&proc->p_lock);
+		return 0;
+	}
+	proc->p_exiting = true;
+	for (i = 0; i < UTHREAD_MAX; i++) {
+		sleepq_wakeall(&proc->p_uthreads[i], &proc->p_lock);
+	}
+	spinlock_release(&proc->p_lock);
+
+	as = proc_getas();
+	if (as != NULL) {
+		futex_wakeall(as);
+	}
+	lock_acquire(proc_waitlock);
+	cv_broadcast(proc->p_waitcv, proc_waitlock);
+	lock_release(proc_waitlock);
+
+	spinlock_acquire(&proc->p_lock);
+	while (proc->p_numthreads > 1) {
+		sleepq_sleep(&proc->p_numthreads, "stopthreads", &proc->p_lock);
+	}
+	/* All the slots are free again; their stacks go with the as. */
+	for (i = 0; i < UTHREAD_MAX; i++) {
+		proc->p_uthreads[i].ut_state = UT_FREE;
+		proc->p_uthreads[i].ut_joining = false;
+	}
+	proc->p_exiting = false;
+	spinlock_release(&proc->p_lock);
+
+	return 0;
+}
+
+void
+proc_checkexiting(void)
+{
+	struct proc *proc = curproc;
+
+	/* p_exiting is only ever set with p_lock; a stale false is ok */
+	if (proc == NULL || !proc->p_exiting) {
+		return;
+	}
+	proc_remthread(curthread);
+	thread_exit();
+}
+
+/*
+ * Exit the current thread. Whether this is the last thread is
+ * decided under p_lock together with detaching, so of two threads
+ * exiting at once exactly one sees itself as last.
+ */
+void
+proc_thread_exit(userptr_t retval)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+
+	KASSERT(proc != NULL);
+
+	spinlock_acquire(&proc->p_lock);
+	if (proc->p_numthreads == 1) {
+		spinlock_release(&proc->p_lock);
+		proc_exit(_MKWAIT_EXIT(0));
+	}
+
+	if (curthread->t_tid != 0) {
+		ut = &proc->p_uthreads[curthread->t_tid - 1];
+		KASSERT(ut->ut_state == UT_RUNNING);
+		ut->ut_state = UT_EXITED;
+		ut->ut_retval = retval;
+		sleepq_wakeall(ut, &proc->p_lock);
+	}
+	proc_remthread_locked(proc, curthread);
+	spinlock_release(&proc->p_lock);
+
+	thread_exit();
 }
 
 /*
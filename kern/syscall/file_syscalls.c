@@ -104,6 +104,49 @@ sys_open(const_userptr_t upath, int flags, mode_t mode, int *retval)
 	return 0;
 }
 
+/*
+ * Readahead window limits, in bytes.
+ */
+#define RA_MINWINDOW	2048
+#define RA_MAXWINDOW	16384
+
+/*
+ * After a read of FILE from START to END, update the sequential read
+ * detection and maybe ask the file system to read ahead. A read that
+ * starts where the last one left off is sequential and doubles the
+ * window, up to RA_MAXWINDOW; anything else (a seek) resets it. We
+ * ask for more once less than half a window is left in flight, so
+ * the requests come in batches. Call with of_offsetlock held.
+ */
+static
+void
+file_readahead(struct openfile *file, off_t start, off_t end)
+{
+	off_t from;
+
+	if (start != file->of_ranext || end == start) {
+		file->of_rawindow = 0;
+		file->of_raend = 0;
+		file->of_ranext = end;
+		return;
+	}
+	file->of_ranext = end;
+
+	if (file->of_rawindow == 0) {
+		file->of_rawindow = RA_MINWINDOW;
+	}
+	else if (file->of_rawindow < RA_MAXWINDOW) {
+		file->of_rawindow *= 2;
+	}
+
+	if (file->of_raend - end >= file->of_rawindow / 2) {
+		return;
+	}
+	from = file->of_raend > end ? file->of_raend : end;
+	file->of_raend = end + file->of_rawindow;
+	VOP_READAHEAD(file->of_vnode, from, file->of_raend - from);
+}
+
 /*
  * Common logic for read and write.
  *
@@ -154,6 +197,9 @@ sys_readwrite(int fd, userptr_t buf, size_t size, enum uio_rw rw,
 	}
 
 	if (locked) {
+		if (rw == UIO_READ) {
+			file_readahead(file, pos, useruio.uio_offset);
+		}
 		/* set the offset to the updated offset in the uio */
 		file->of_offset = useruio.uio_offset;
 		lock_release(file->of_offsetlock);
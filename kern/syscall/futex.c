@@ -0,0 +1,235 @@
+/*
+ * futex() system call.
+ *
+ * A futex is just an aligned int in user memory. User code does the
+ * uncontended case with atomic instructions and only calls in here
+ * to sleep when it has to wait or to wake a waiter; see the libc
+ * mutex for an example.
+ *
+ * Sleeping threads are found through a hash table keyed on (address
+ * space, user address). Each bucket has a spinlock and a list of
+ * waiters, which live on the sleeping threads' stacks. Each waiter
+ * sleeps in the sleep queues on its own address, so FUTEX_WAKE takes
+ * matching waiters off the list, marks them woken, and wakes exactly
+ * those threads.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/futex.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <sleepq.h>
+#include <proc.h>
+#include <current.h>
+#include <copyinout.h>
+#include <syscall.h>
+#include <futex.h>
+
+struct futex_waiter {
+	struct addrspace *fw_as;
+	vaddr_t fw_addr;
+	bool fw_woken;
+	struct futex_waiter *fw_next;
+};
+
+struct futex_bucket {
+	struct spinlock fb_lock;
+	struct futex_waiter *fb_waiters;
+};
+
+static struct futex_bucket futex_table[FUTEX_HASHSIZE];
+
+void
+futex_bootstrap(void)
+{
+	unsigned i;
+
+	for (i=0; i<FUTEX_HASHSIZE; i++) {
+		spinlock_init(&futex_table[i].fb_lock);
+		futex_table[i].fb_waiters = NULL;
+	}
+}
+
+static
+struct futex_bucket *
+futex_hash(struct addrspace *as, vaddr_t addr)
+{
+	uint32_t h;
+
+	h = (addr >> 2) * 2654435761U;
+	h ^= (uint32_t)(uintptr_t)as >> 4;
+	return &futex_table[(h >> 16) & (FUTEX_HASHSIZE - 1)];
+}
+
+/*
+ * Put W at the end of FB's list, so wakeups are FIFO. Call with
+ * fb_lock held.
+ */
+static
+void
+futex_link(struct futex_bucket *fb, struct futex_waiter *w)
+{
+	struct futex_waiter **pp;
+
+	for (pp = &fb->fb_waiters; *pp != NULL; pp = &(*pp)->fw_next) {
+		/* nothing */
+	}
+	w->fw_next = NULL;
+	*pp = w;
+}
+
+/*
+ * Take W off FB's list if it's still there. Call with fb_lock held.
+ */
+static
+void
+futex_unlink(struct futex_bucket *fb, struct futex_waiter *w)
+{
+	struct futex_waiter **pp;
+
+	for (pp = &fb->fb_waiters; *pp != NULL; pp = &(*pp)->fw_next) {
+		if (*pp == w) {
+			*pp = w->fw_next;
+			return;
+		}
+	}
+}
+
+static
+int
+futex_wait(struct addrspace *as, userptr_t uaddr, int val)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter w;
+	int cur;
+	int result;
+
+	w.fw_as = as;
+	w.fw_addr = (vaddr_t)uaddr;
+	w.fw_woken = false;
+
+	fb = futex_hash(as, w.fw_addr);
+
+	/*
+	 * Get on the list before looking at the value. We can't
+	 * copyin with a spinlock held, and if we checked first a
+	 * FUTEX_WAKE could slip in between the check and the sleep.
+	 * This way any wake issued after the value changes will find
+	 * us.
+	 */
+	spinlock_acquire(&fb->fb_lock);
+	futex_link(fb, &w);
+	spinlock_release(&fb->fb_lock);
+
+	result = copyin((const_userptr_t)uaddr, &cur, sizeof(cur));
+
+	spinlock_acquire(&fb->fb_lock);
+	if (result == 0 && cur == val) {
+		while (!w.fw_woken) {
+			sleepq_sleep(&w, "futex", &fb->fb_lock);
+		}
+	}
+	else if (!w.fw_woken) {
+		futex_unlink(fb, &w);
+		if (result == 0) {
+			result = EAGAIN;
+		}
+	}
+	else {
+		/* Woken while we were looking; count it as a wakeup. */
+		result = 0;
+	}
+	spinlock_release(&fb->fb_lock);
+
+	return result;
+}
+
+static
+int
+futex_wake(struct addrspace *as, userptr_t uaddr, int max, int *retval)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter **pp, *w;
+	int n;
+
+	fb = futex_hash(as, (vaddr_t)uaddr);
+	n = 0;
+
+	spinlock_acquire(&fb->fb_lock);
+	pp = &fb->fb_waiters;
+	while (*pp != NULL && n < max) {
+		w = *pp;
+		if (w->fw_as == as && w->fw_addr == (vaddr_t)uaddr) {
+			*pp = w->fw_next;
+			w->fw_woken = true;
+			sleepq_wakeone(w, &fb->fb_lock);
+			n++;
+		}
+		else {
+			pp = &w->fw_next;
+		}
+	}
+	spinlock_release(&fb->fb_lock);
+
+	*retval = n;
+	return 0;
+}
+
+/*
+ * Wake everything waiting in AS, whatever the address. Used when a
+ * process is exiting so none of its threads stays asleep in here.
+ */
+void
+futex_wakeall(struct addrspace *as)
+{
+	struct futex_bucket *fb;
+	struct futex_waiter **pp, *w;
+	unsigned i;
+
+	for (i=0; i<FUTEX_HASHSIZE; i++) {
+		fb = &futex_table[i];
+		spinlock_acquire(&fb->fb_lock);
+		pp = &fb->fb_waiters;
+		while (*pp != NULL) {
+			w = *pp;
+			if (w->fw_as == as) {
+				*pp = w->fw_next;
+				w->fw_woken = true;
+				sleepq_wakeone(w, &fb->fb_lock);
+			}
+			else {
+				pp = &w->fw_next;
+			}
+		}
+		spinlock_release(&fb->fb_lock);
+	}
+}
+
+int
+sys_futex(userptr_t uaddr, int op, int val, int *retval)
+{
+	struct addrspace *as;
+
+	if ((vaddr_t)uaddr % sizeof(int) != 0) {
+		return EINVAL;
+	}
+
+	as = proc_getas();
+	if (as == NULL) {
+		return EFAULT;
+	}
+
+	*retval = 0;
+
+	switch (op) {
+	    case FUTEX_WAIT:
+		return futex_wait(as, uaddr, val);
+	    case FUTEX_WAKE:
+		if (val <= 0) {
+			return EINVAL;
+		}
+		return futex_wake(as, uaddr, val, retval);
+	}
+	return EINVAL;
+}
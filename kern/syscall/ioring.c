@@ -0,0 +1,146 @@
+/*
+ * ioring_enter: do a batch of file operations in one system call.
+ *
+ * See <kern/ioring.h> for the ring layout. The ring is in user
+ * memory, so we copy the indices and submission queue in at the
+ * start, do the operations with the ordinary file syscalls, and copy
+ * out just the new completions and the two indices we own.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/ioring.h>
+#include <lib.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/*
+ * Do one operation and fill in its completion.
+ */
+static
+void
+ioring_do(const struct ioring_sqe *sqe, struct ioring_cqe *cqe)
+{
+	int res32 = 0;
+	off_t res64 = 0;
+	int err;
+
+	switch (sqe->sqe_op) {
+	    case IORING_OP_NOP:
+		err = 0;
+		break;
+	    case IORING_OP_READ:
+		err = sys_read(sqe->sqe_fd, (userptr_t)sqe->sqe_buf,
+			       sqe->sqe_len, &res32);
+		res64 = res32;
+		break;
+	    case IORING_OP_WRITE:
+		err = sys_write(sqe->sqe_fd, (userptr_t)sqe->sqe_buf,
+				sqe->sqe_len, &res32);
+		res64 = res32;
+		break;
+	    case IORING_OP_LSEEK:
+		err = sys_lseek(sqe->sqe_fd, sqe->sqe_offset, sqe->sqe_len,
+				&res64);
+		break;
+	    case IORING_OP_CLOSE:
+		err = sys_close(sqe->sqe_fd);
+		break;
+	    default:
+		err = EINVAL;
+		break;
+	}
+
+	cqe->cqe_data = sqe->sqe_data;
+	cqe->cqe_err = err;
+	cqe->cqe_res = err ? -1 : res64;
+}
+
+/*
+ * Copy out completions FROM up to (not including) TO. They may wrap
+ * around the end of the queue, so this is at most two copies.
+ */
+static
+int
+ioring_postcq(struct ioring *ring, struct ioring *uring,
+	      unsigned from, unsigned to)
+{
+	unsigned slot, n;
+	int result;
+
+	while (from != to) {
+		slot = from % IORING_SIZE;
+		n = to - from;
+		if (slot + n > IORING_SIZE) {
+			n = IORING_SIZE - slot;
+		}
+		result = copyout(&ring->ir_cq[slot],
+				 (userptr_t)&uring->ir_cq[slot],
+				 n * sizeof(ring->ir_cq[0]));
+		if (result) {
+			return result;
+		}
+		from += n;
+	}
+	return 0;
+}
+
+int
+sys_ioring_enter(userptr_t uringptr, int *retval)
+{
+	struct ioring *uring = (struct ioring *)uringptr;
+	struct ioring *ring;
+	unsigned sqhead, sqtail, cqhead, cqtail, cqstart;
+	int result;
+
+	ring = kmalloc(sizeof(*ring));
+	if (ring == NULL) {
+		return ENOMEM;
+	}
+
+	/* Everything but the completions; we only ever write those. */
+	result = copyin(uringptr, ring,
+			(char *)&ring->ir_cq[0] - (char *)ring);
+	if (result) {
+		kfree(ring);
+		return result;
+	}
+
+	sqhead = ring->ir_sqhead;
+	sqtail = ring->ir_sqtail;
+	cqhead = ring->ir_cqhead;
+	cqtail = ring->ir_cqtail;
+	if (sqtail - sqhead > IORING_SIZE || cqtail - cqhead > IORING_SIZE) {
+		kfree(ring);
+		return EINVAL;
+	}
+
+	cqstart = cqtail;
+	while (sqhead != sqtail && cqtail - cqhead < IORING_SIZE) {
+		ioring_do(&ring->ir_sq[sqhead % IORING_SIZE],
+			  &ring->ir_cq[cqtail % IORING_SIZE]);
+		sqhead++;
+		cqtail++;
+	}
+
+	/*
+	 * Post the completions before moving the tail, so a thread
+	 * watching the tail never sees a slot that isn't filled in.
+	 */
+	result = ioring_postcq(ring, uring, cqstart, cqtail);
+	if (!result) {
+		result = copyout(&cqtail, (userptr_t)&uring->ir_cqtail,
+				 sizeof(cqtail));
+	}
+	if (!result) {
+		result = copyout(&sqhead, (userptr_t)&uring->ir_sqhead,
+				 sizeof(sqhead));
+	}
+	kfree(ring);
+	if (result) {
+		return result;
+	}
+
+	*retval = cqtail - cqstart;
+	return 0;
+}
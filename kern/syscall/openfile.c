@@ -69,6 +69,9 @@ openfile_create(struct vnode *vn, int accmode)
 	file->of_vnode = vn;
 	file->of_accmode = accmode;
 	file->of_offset = 0;
+	file->of_ranext = 0;
+	file->of_raend = 0;
+	file->of_rawindow = 0;
 	file->of_refcount = 1;
 
 	return file;
@@ -195,24 +195,62 @@ runprogram(char *progname)
 	return EINVAL;
 }
 
+/*
+ * Fork statistics: how many forks have completed and how many user
+ * pages as_copy copied for them, so the cost of a fork can be seen
+ * from the menu (forkstat) while running a fork benchmark.
+ */
+static struct spinlock forkstat_lock = SPINLOCK_INITIALIZER_NAMED("forkstat");
+static unsigned forkstat_forks;
+static uint64_t forkstat_pages;
+
+void
+forkstat_print(void)
+{
+	unsigned forks;
+	uint64_t pages;
+
+	spinlock_acquire(&forkstat_lock);
+	forks = forkstat_forks;
+	pages = forkstat_pages;
+	spinlock_release(&forkstat_lock);
+
+	kprintf("%u forks, %llu pages copied", forks,
+		(unsigned long long)pages);
+	if (forks > 0) {
+		kprintf(", %llu pages/fork",
+			(unsigned long long)(pages / forks));
+	}
+	kprintf("\n");
+}
+
+void
+forkstat_reset(void)
+{
+	spinlock_acquire(&forkstat_lock);
+	forkstat_forks = 0;
+	forkstat_pages = 0;
+	spinlock_release(&forkstat_lock);
+}
+
 /* Function for thread_fork to operate off of. Recall that fork clones the
  * current process EXACTLY at the point where fork() was called, so we need
  * to pass the trapframe to the child process. This consists of registers and
  * other ultra-low-level processor information to be loaded by the child when
  * it takes over.
+ *
+ * By the time this runs the parent has finished building the process, so
+ * there is nothing to wait for.
  */
 void
 child(void *tf, long unsigned int data2){
-	(void)data2;
+	// We're a copy of the forking thread, id and all
+	curthread->t_tid = data2;
 
-	// Block until the parent process has finished copying filetable
-	P(curproc->forksem);
-
-	// Load and activate the address space	`	
-	proc_setas( curproc->p_addrspace );	
+	// Activate the address space sys_fork gave us
 	as_activate();	
 	
-	// Pass trapframe, separate stack copy made in method
+	// Enter user mode; this frees the heap trapframe.
 	// See: arch/mips/syscall/syscall.c
 	enter_forked_process( (struct trapframe *)tf );
 
@@ -223,409 +261,511 @@ child(void *tf, long unsigned int data2){
  * argument is the trapframe, which is a struct of processor registers, including
  * the general purpose regs, program counter, etc. This allows the child to
  * load the exact state of the processor when it takes control of execution.
+ *
+ * Each piece of the child is made exactly once and handed over: proc_fork
+ * copies the file table and cwd, as_copy the address space, and the trapframe
+ * is copied to the heap and passed to the child thread, which frees it. The
+ * child is complete before its thread is created.
  */
 int
 sys_fork(struct trapframe *frame, int32_t *childpid){
 
-	/* New process and trapframe copies will be made */
 	struct proc *childproc;
 	struct trapframe *trap;
+	unsigned pages;
 	int result;	
 		
-	lock_acquire(gpll_lock);	
-	// Make a copy of the trapframe on the heap
+	// Make a copy of the trapframe on the heap for the child
 	trap = kmalloc(sizeof(*trap));
 	if(trap == NULL){
-		lock_release(gpll_lock);
 		return ENOMEM;
 	}
 	memcpy(trap, frame, sizeof(*frame));
 
-	// Generate an exact copy of this process and copy the current
-	// process' addrspace to the copy
+	// Generate a copy of this process (file table and cwd included)
 	result = proc_fork(&childproc);
 	if(result){
-		lock_release(gpll_lock);
-		if(curproc->parent != NULL || proc_getpid(curproc->parent) != -1){	
-			sys__exit(1);
-		}
-		return ENOMEM;
+		kfree(trap);
+		return result;
 	}
 
 	result = as_copy(curproc->p_addrspace, &childproc->p_addrspace);
 	if(result){
+		kfree(trap);
 		proc_destroy(childproc);
-		lock_release(gpll_lock);
-		if(curproc->parent != NULL || proc_getpid(curproc->parent) != -1){
-			sys__exit(1);
-		}
-		return ENOMEM;
+		return result;
 	}
-	// Fork the process. Copy the filetable over to the child and increment
-	// the child's semaphore so it knows to continue the fork.
-	result = thread_fork(curproc->p_name, childproc, child, trap, 0);  	 
-	if(result){
-		proc_destroy(childproc);
-		lock_release(gpll_lock);
-		if(curproc->parent != NULL || proc_getpid(curproc->parent) != -1){
-			sys__exit(1);
-		}
-		return ENOMEM;
+
+	// If we're not the initial thread, the child runs on our stack slot
+	if(curthread->t_tid != 0){
+		childproc->p_uthreads[curthread->t_tid - 1].ut_state = UT_RUNNING;
 	}
 
-	result = filetable_copy(curproc->p_filetable, &childproc->p_filetable);
+	// Get these now; the child may run (and exec) as soon as it's forked
+	*childpid = childproc->p_pid;
+	pages = childproc->p_addrspace->as_copiedpages;
+
+	result = thread_fork(curproc->p_name, childproc, child, trap,
+			     curthread->t_tid);
 	if(result){
-		kprintf("FTERROR\n");
+		kfree(trap);
 		proc_destroy(childproc);
-		lock_release(gpll_lock);
-		return ENOMEM;
+		return result;
 	}
 
-	V(childproc->forksem);
-	
-	// Return with child's PID
-	*childpid = proc_getpid(childproc);
+	spinlock_acquire(&forkstat_lock);
+	forkstat_forks++;
+	forkstat_pages += pages;
+	spinlock_release(&forkstat_lock);
 
-	lock_release(gpll_lock);
-	
 	return 0;
 }
 
+/*
+ * Wait for a child to exit. PID -1 means any child; WNOHANG makes it
+ * return 0 instead of sleeping when no such child has exited yet.
+ * The real work, including reaping, is in proc_wait.
+ */
 int
-sys_waitpid(pid_t pid, int *status, int options, int *childpid){
-	(void)options;
-
-	/* Semaphore = 20 Bytes */
-	/* Lock      = 24 Bytes */
-	/* Condition = 16 Bytes */
-	/* Check all of the args for errors */
+sys_waitpid(pid_t pid, userptr_t status, int options, int *childpid){
+	int exitstatus;
+	int result;
 
-	if( pid < __PID_MIN || pid > __PID_MAX ){
-		return ESRCH;
-	}else if( pid == proc_getpid(curproc) ){
-		return EFAULT;
+	result = proc_wait(pid, options, &exitstatus, childpid);
+	if(result){
+		return result;
 	}
-	if( options != 0 ){
-		return EINVAL;
+
+	if(status != NULL && *childpid != 0){
+		/*
+		 * The child is gone already, so there is no way to
+		 * give its status back if this fails. Same as Unix.
+		 */
+		result = copyout(&exitstatus, status, sizeof(exitstatus));
+		if(result){
+			return result;
+		}
 	}
 
+	return 0;
+}
 
-	// Check status pointer
-	if(status < (int *)(USERSTACK - 450000)){
-		return EFAULT;
-	}else if( status == (void *)(0x80000000) ){
-		return EFAULT;
-	}else if( (uint32_t)status % 4 != 0 ){
-		return EFAULT;
-	}
+int
+sys__exit(int exitcode){
+	// Frees what it can and leaves a zombie for the parent; never returns
+	proc_exit(_MKWAIT_EXIT(exitcode));
+}
 
-	/* Get waiter process pnode */
-	struct proc *waiterprocess;
-	struct pnode *childnode;
+/*
+ * Argument marshalling for execv and spawn.
+ *
+ * The user's argv is copied into a single ARG_MAX staging buffer laid
+ * out exactly as it will sit on the new user stack: the pointer array
+ * (argc+1 slots) followed by the strings, each padded to 4 bytes.
+ * While the block is in the kernel the slots hold offsets into it;
+ * argbuf_copyout turns them into user addresses once the stack
+ * location is known and then copies the whole block out at once.
+ */
+struct argbuf {
+	char *ab_data;		/* staging buffer, ARG_MAX bytes */
+	size_t ab_len;		/* bytes in use */
+	int ab_argc;		/* number of arguments */
+};
 
-	lock_acquire(gpll_lock);
-	
-	/* Get process to wait on and it's respective pnode in the GPLL */
-	waiterprocess = proc_getptr(pid);
-	childnode = proc_get_pnode(waiterprocess);
+static
+int
+argbuf_copyin(struct argbuf *ab, const_userptr_t uargv)
+{
+	vaddr_t *slots;
+	userptr_t uarg;
+	size_t off, len;
+	int argc, i, result;
 
-	
-	//childnode->busy = pid;
-	
-	/* Determine if waiter process exists */
-	if( waiterprocess == NULL || childnode == NULL ){
-		lock_release(gpll_lock);
-		return ECHILD;	
-	}else if( pid == childnode->busy ){
-		lock_release(gpll_lock);
-		return EFAULT;
+	ab->ab_data = kmalloc(ARG_MAX);
+	if (ab->ab_data == NULL) {
+		return ENOMEM;
+	}
+	slots = (vaddr_t *)ab->ab_data;
+
+	/* Fetch the pointer array first; that gives us argc. */
+	argc = 0;
+	do {
+		if ((argc + 1) * sizeof(vaddr_t) > ARG_MAX) {
+			kfree(ab->ab_data);
+			return E2BIG;
+		}
+		result = copyin((const_userptr_t)((vaddr_t)uargv +
+						  argc * sizeof(vaddr_t)),
+				&slots[argc], sizeof(vaddr_t));
+		if (result) {
+			kfree(ab->ab_data);
+			return result;
+		}
+	} while (slots[argc++] != 0);
+	argc--;
+
+	/* Now the strings, right after the array. */
+	off = (argc + 1) * sizeof(vaddr_t);
+	for (i=0; i<argc; i++) {
+		uarg = (userptr_t)slots[i];
+		result = copyinstr(uarg, ab->ab_data + off, ARG_MAX - off, &len);
+		if (result) {
+			kfree(ab->ab_data);
+			return result == ENAMETOOLONG ? E2BIG : result;
+		}
+		slots[i] = off;
+		off += len;
+		while (off % sizeof(vaddr_t) != 0) {
+			if (off == ARG_MAX) {
+				kfree(ab->ab_data);
+				return E2BIG;
+			}
+			ab->ab_data[off++] = 0;
+		}
 	}
 
-	// Controls whether or not _exit() destroys the process. In this
-	// case, we will manually destroy it after waiting.
-	waiterprocess->parent = curproc;
+	ab->ab_len = off;
+	ab->ab_argc = argc;
+	return 0;
+}
 
-	lock_release(gpll_lock);
+/*
+ * Copy the block to the top of the stack at *STACKPTR in the current
+ * address space. Updates *STACKPTR and returns the user argv in UARGV.
+ */
+static
+int
+argbuf_copyout(struct argbuf *ab, vaddr_t *stackptr, userptr_t *uargv)
+{
+	vaddr_t *slots;
+	vaddr_t base;
+	int i;
 
-	P(childnode->exitsem);
+	/* Keep the stack doubleword aligned. */
+	base = (*stackptr - ab->ab_len) & ~(vaddr_t)7;
 
-	if(status != NULL){
-		*status = childnode->retcode;
+	slots = (vaddr_t *)ab->ab_data;
+	for (i=0; i<ab->ab_argc; i++) {
+		slots[i] += base;
 	}
-	
-	// Destroy the process we were waiting on since it's confirmed exited.
-	proc_destroy(waiterprocess);
 
-	*childpid = pid;
+	*stackptr = base;
+	*uargv = (userptr_t)base;
+	return copyout(ab->ab_data, (userptr_t)base, ab->ab_len);
+}
 
-	return 0;
+static
+void
+argbuf_cleanup(struct argbuf *ab)
+{
+	kfree(ab->ab_data);
+	ab->ab_data = NULL;
+}
 
+/*
+ * Copy in the program name for execv or spawn.
+ */
+static
+int
+progname_copyin(const_userptr_t program, char **ret)
+{
+	char *progname;
+	int result;
+
+	progname = kmalloc(PATH_MAX);
+	if (progname == NULL) {
+		return ENOMEM;
+	}
+	result = copyinstr(program, progname, PATH_MAX, NULL);
+	if (result) {
+		kfree(progname);
+		return result;
+	}
+	if (progname[0] == '\0') {
+		kfree(progname);
+		return EINVAL;
+	}
+	*ret = progname;
+	return 0;
 }
 
+/*
+ * Where a freshly loaded program starts: what enter_new_process needs.
+ */
+struct progstart {
+	vaddr_t ps_entrypoint;
+	vaddr_t ps_stackptr;
+	userptr_t ps_argv;
+	int ps_argc;
+};
+
+/*
+ * Load PROGNAME into the current address space, which must be fresh,
+ * and copy the arguments onto its stack. Destroys PROGNAME (via
+ * vfs_open).
+ */
+static
 int
-sys__exit(int exitcode){
+load_image(char *progname, struct argbuf *ab, struct progstart *ps)
+{
+	struct vnode *v;
+	int result;
 
-	// Find current pnode of the process to exit
-	struct pnode *current;
-	current = proc_get_pnode(curproc);	
-	
-	// If NULL, pnode does not exist (bad)
-	if(current == NULL){
-		return -1;
-	}	
+	result = vfs_open(progname, O_RDONLY, 0, &v);
+	if (result) {
+		return result;
+	}
 
-	/* Generate the current process' exit code and increment the
-	 * exit semaphore to let waitpid() know curproc has exited.
-	 */
-	current->busy = 0;
-	current->retcode = _MKWAIT_EXIT(exitcode);
-	V(current->exitsem);	
+	result = load_elf(v, &ps->ps_entrypoint);
+	vfs_close(v);
+	if (result) {
+		return result;
+	}
 
-	// If this process called exit on it's own (without waitpid), just destroy it
-	if( curproc->parent == NULL ){
-		proc_destroy(curproc);
+	result = as_define_stack(proc_getas(), &ps->ps_stackptr);
+	if (result) {
+		return result;
 	}
 
-	// Actually exit the process
-	thread_exit();
+	result = argbuf_copyout(ab, &ps->ps_stackptr, &ps->ps_argv);
+	ps->ps_argc = ab->ab_argc;
+	return result;
+}
 
-	return 0;
+/*
+ * What sys_spawn hands the child thread: the program to load, and
+ * where to report how that went. Lives on the parent's stack.
+ */
+struct spawnload {
+	char *sl_progname;
+	struct argbuf *sl_args;
+	struct semaphore *sl_done;	/* V'd once the load is over */
+	int sl_result;
+};
+
+/*
+ * The child side of spawn: load the program into the child's own
+ * address space (so the parent's process never sees it), tell the
+ * parent how it went, and start it. If it failed, throw the address
+ * space away and leave the proc; the parent destroys it.
+ */
+static
+void
+spawn_child(void *data1, unsigned long data2)
+{
+	struct spawnload *sl = data1;
+	struct addrspace *as;
+	struct progstart ps;
+	int result;
+
+	(void)data2;
+
+	as_activate();
+	result = load_image(sl->sl_progname, sl->sl_args, &ps);
+	sl->sl_result = result;
+
+	if (result) {
+		as = proc_setas(NULL);
+		as_deactivate();
+		as_destroy(as);
+		proc_remthread(curthread);
+		V(sl->sl_done);
+		thread_exit();
+	}
+
+	/* SL is gone once the parent wakes up. */
+	V(sl->sl_done);
+	enter_new_process(ps.ps_argc, ps.ps_argv, NULL,
+			  ps.ps_stackptr, ps.ps_entrypoint);
 }
 
-/* Exec takes a program written by the user, loads it and then proceeds to execute it.
- * This is now shell works, as well as all the userland tests and allows arguments to
- * be passed. However, it would be dangerous to just simply let the user pass any
- * argument pointer they want into the kernel space, so we use copyin/copyout functions
- * protected by setjmp/longjmp to do so. It's important that the algorithm for copying
- * user arguments uses as little memory as possible.
- *
- * The number of arguments is unlimited; it would be a serious limitation to limit these
- * and not really be a true execv. Instead, the max amount of arguments is set by the size
- * of those arguments: 64K.
- *
- * NOTE: execv is ultra sensitive to memory usage.
+/*
+ * Load PROGNAME into the fresh address space AS and copy the
+ * arguments onto its stack. AS is made current while this runs, so
+ * load_elf and copyout work on it, and the caller's address space is
+ * put back before returning, so on failure nothing else has changed.
+ * The caller must be the only thread in its process. Destroys
+ * PROGNAME (via vfs_open).
+ */
+static
+int
+load_program(struct addrspace *as, char *progname, struct argbuf *ab,
+	     struct progstart *ps)
+{
+	struct addrspace *oldas;
+	int result;
+
+	oldas = proc_setas(as);
+	as_activate();
+
+	result = load_image(progname, ab, ps);
+
+	proc_setas(oldas);
+	as_activate();
+	return result;
+}
+
+/*
+ * Start PROGRAM with ARGS in a new child process, as fork followed
+ * immediately by execv would, but without ever copying the parent's
+ * address space: the child gets the parent's file table and cwd (as
+ * with fork) and a brand new address space, which its own thread
+ * loads straight from the executable. The parent waits for that, so
+ * errors loading the program are returned to the parent, and no
+ * child is left behind.
  */
 int
-sys_execv(char *program, userptr_t **args, int *retval){
+sys_spawn(const_userptr_t program, const_userptr_t args, int32_t *childpid)
+{
+	struct proc *childproc;
 	struct addrspace *as;
-	struct vnode *v;
-	vaddr_t entrypoint, stackptr;
+	struct spawnload sl;
+	struct argbuf ab;
+	char *progname;
+	pid_t pid;
 	int result;
-	size_t pr_length;
-
-	// Check to make sure program & arg pointers aren't null.
-	if(program == NULL){
-		*retval = -1;
-		return EFAULT;
-	}else if (args == NULL){
-		*retval = -1;
-		return EFAULT;
-	}
-
-	lock_acquire(gpll_lock);
-
-	void *testptr = kmalloc(2);
-	// Check args pointer for validity.
-	if((void **)args < (void **)(USERSTACK - 450000)){
-		lock_release(gpll_lock);
-		return EFAULT;
-	}else if( (void **)args == (void **)(0x80000000) ){
-		lock_release(gpll_lock);
-		return EFAULT;
-	}else if( copyin( (const_userptr_t)args[0], testptr, 1 ) ){
-		lock_release(gpll_lock);
-		return EFAULT;
+
+	result = progname_copyin(program, &progname);
+	if (result) {
+		return result;
 	}
-	
-	// Allocate space for the program name. This is a max of 255 chars.	
-	char *pr_name;
-	pr_name = kmalloc(PATH_MAX * sizeof(char));
-	
-	// Lookahead to see how many args we have to deal with
-	int num_args = 0;
-	while( args[num_args] != NULL ){
-		num_args++;
-	}
-
-	// Allocate a kernel-side storage place for the user arguements
-	char **bigbuffer = (char **)kmalloc(sizeof(char *) * num_args);	
-	if( bigbuffer == NULL ){
-		*retval = -1;
-		kprintf("BigBuffer\n");
-		lock_release(gpll_lock);
-		return ENOMEM;
+
+	result = argbuf_copyin(&ab, args);
+	if (result) {
+		kfree(progname);
+		return result;
 	}
-	
-	// Get program name
-	result = copyinstr((userptr_t)program, pr_name, PATH_MAX, &pr_length);
-	if(result){
-		lock_release(gpll_lock);
-		return EFAULT;
+
+	sl.sl_progname = progname;
+	sl.sl_args = &ab;
+	sl.sl_result = 0;
+	sl.sl_done = sem_create("spawn", 0);
+	if (sl.sl_done == NULL) {
+		result = ENOMEM;
+		goto out_args;
 	}
-	// Check for empty string program
-	if(strcmp(pr_name, "") == 0){
-		lock_release(gpll_lock);
-		return EINVAL;
+
+	as = as_create();
+	if (as == NULL) {
+		result = ENOMEM;
+		goto out_sem;
 	}
-	
-	/* Copy user arguments to the kernel, using a safe method. It's very easy to
-	 * run out of memory here, so we need to see the length of the argument that
-	 * were about to copy in, before actually copying. */
-	int argcounter = 0;
-	while(args[argcounter] != NULL && argcounter < num_args+1 ){
-		size_t inlength;	// Input length from copyinstr()	
-		char *tempstr;
-		
+
+	// File table and cwd, as for fork, but no address space copy
+	result = proc_fork(&childproc);
+	if (result) {
+		as_destroy(as);
+		goto out_sem;
+	}
+	/* we have the only reference to childproc, so no lock needed */
+	childproc->p_addrspace = as;
+	pid = childproc->p_pid;
+
+	result = thread_fork(curproc->p_name, childproc, spawn_child, &sl, 0);
+	if (result) {
+		proc_destroy(childproc);
+		goto out_sem;
+	}
+
+	P(sl.sl_done);
+	result = sl.sl_result;
+	if (result) {
+		/* The child thread has left it; nobody else can see it. */
+		proc_destroy(childproc);
+	}
+	else {
+		*childpid = pid;
+	}
+
+ out_sem:
+	sem_destroy(sl.sl_done);
+ out_args:
+	argbuf_cleanup(&ab);
+	kfree(progname);
+	return result;
+}
+
 /*
-		if(argcounter == 0){
-			tempstr = kmalloc(sizeof(char) * PATH_MAX);
-		}else{
-			tempstr = kmalloc(sizeof(char) * arg_maxsize);
-		}
-		if(tempstr == NULL){
-			kprintf("%s\n", (char *)args[argcounter]);
-			lock_release(gpll_lock);
-			return ENOMEM;
-		}		
-*/
-		if( (void *)args[argcounter] == (void *)0x40000000 ){
-			lock_release(gpll_lock);
-			return EFAULT;
-		}
-		// Kmalloc only enough to fit the argument and it's NULL terminator.
-		unsigned int arglen = strlen((char *)args[argcounter]) + 1;
-		tempstr = kmalloc( arglen * sizeof(char) );		
-		if(tempstr == NULL){
-			kprintf("%s\n", (char *)args[argcounter]);	
-			lock_release(gpll_lock);
-			return ENOMEM;
-		}
+ * Replace the current program with PROGRAM, passing it ARGS.
+ *
+ * Any other threads in the process are stopped first, since the new
+ * address space is made current while it's loaded and they mustn't
+ * run (or fault) against a half-loaded image. The new program is
+ * then loaded into a new address space and its arguments are put on
+ * its stack (see argbuf above); only once that has all worked is the
+ * old one thrown away. So a failed exec returns to the caller with
+ * its program intact, though as its only thread.
+ *
+ * Apart from the program name, the only memory used is the one
+ * ARG_MAX staging buffer, however many arguments there are.
+ */
+int
+sys_execv(const_userptr_t program, const_userptr_t args)
+{
+	struct addrspace *as, *oldas;
+	struct progstart ps;
+	struct argbuf ab;
+	char *progname;
+	int result;
 
-		// Copy string from userspace. Returned length includes the null terminator.
-		result = copyinstr((const_userptr_t)args[argcounter], tempstr, ARG_MAX, &inlength);
-		if(result){
-			lock_release(gpll_lock);
-			return EFAULT;
-		}
-		KASSERT(inlength == arglen);
-		
-		bigbuffer[argcounter] = tempstr;
-		argcounter++;
+	result = progname_copyin(program, &progname);
+	if (result) {
+		return result;
 	}
-	// Set total number of args and terminate the pointer string with NULL
-	bigbuffer[num_args] = NULL;
 
-	/* Open the file. */
-	
-	result = vfs_open(pr_name, O_RDONLY, 0, &v);
+	result = argbuf_copyin(&ab, args);
 	if (result) {
-		*retval = -1;
-		return ENOENT;
+		kfree(progname);
+		return result;
 	}
-	kfree(pr_name);
 
-	/* Create a new address space. */
 	as = as_create();
 	if (as == NULL) {
-		vfs_close(v);
+		argbuf_cleanup(&ab);
+		kfree(progname);
 		return ENOMEM;
 	}
 
-	/* Switch to it and activate it. */
-	proc_setas(as);
-	as_activate();
-	///////////////////////////////////////////////////////
-	/* Load the executable. */
-	result = load_elf(v, &entrypoint);
+	/* Get rid of our other threads, if any, before touching the as. */
+	result = proc_stopthreads();
 	if (result) {
-		/* p_addrspace will go away when curproc is destroyed */
-		vfs_close(v);
+		/* Someone else is exiting or exec'ing; let them. */
+		as_destroy(as);
+		argbuf_cleanup(&ab);
+		kfree(progname);
 		return result;
 	}
 
-	/* Done with the file now. */
-	vfs_close(v);
-	
-	/* Define the user stack in the address space */
-	result = as_define_stack(as, &stackptr);
+	result = load_program(as, progname, &ab, &ps);
+	argbuf_cleanup(&ab);
+	kfree(progname);
 	if (result) {
-		/* p_addrspace will go away when curproc is destroyed */
+		as_destroy(as);
 		return result;
 	}
-	///////////////////////////////////////////////////////
-	argcounter = 0;
 
-	// Array to keep stackpointer values in	
-	vaddr_t *stacksonstacks;
-	stacksonstacks = (vaddr_t *)kmalloc(sizeof(vaddr_t) * num_args);
-	if(stacksonstacks == NULL){
-		lock_release(gpll_lock);
-		return ENOMEM;
-	}
-
-	/* Copy arguments to new stack; aligned by 4 */
-	while(bigbuffer[argcounter] != NULL){
-		size_t outlen;
-		int mod;
-		int adjust;
-		int length;
-	
-		length = strlen(bigbuffer[argcounter]) + 1;
-
-		// Copy adjusted arguments
-		mod = length % 4;
-			if( mod == 0 ){
-				adjust = 0;
-			}else{		
-				adjust = 4 - mod;
-			}
-	
-		/* Shift stackptr by the length of the argument & buffer */	
-	
-		stackptr -= length;
-		stackptr -= adjust;
-		
-		/* Actually copy to stack */
-		copyoutstr(bigbuffer[argcounter], (userptr_t)stackptr, ARG_MAX, &outlen);
-		kfree(bigbuffer[argcounter]);
-				
-		/* Put a copy of the stackptr in the array */
-		stacksonstacks[argcounter] = stackptr;		
-
-		argcounter++;
-	}
-	// User args are still NULL terminated	
-	stackptr -= 4;
-	copyout(bigbuffer[num_args], (userptr_t)stackptr, 4);
-
-	// Stackpointer still needs references to where args are on the stack.
-	// (thanks Tuesday office hour crew!!)
-	for(int i = num_args; i > 0; i--){
-		stackptr -= 4;
-		result = copyout(&stacksonstacks[i-1], (userptr_t)stackptr, 4);
-	}
-	*retval = 0;
-	
-	// Cleanup
-	kfree(stacksonstacks);
-	kfree(bigbuffer);	
-	lock_release(gpll_lock);
+	/*
+	 * Point of no return: switch over and drop the old program.
+	 * We become the initial thread of the new one.
+	 */
+	curthread->t_tid = 0;
+	oldas = proc_setas(as);
+	as_activate();
+	as_destroy(oldas);
 
 	/* Warp to user mode. */
-	enter_new_process(num_args, (userptr_t)stackptr, NULL, stackptr, entrypoint);
-	
+	enter_new_process(ps.ps_argc, ps.ps_argv, NULL,
+			  ps.ps_stackptr, ps.ps_entrypoint);
+
 	/* enter_new_process does not return. */
 	panic("enter_new_process returned\n");
-	
-	return 0;
-
+	return EINVAL;
 }
 
 int
 sys_getpid(int32_t *retval){
-	// Defined in pr_table.c; function takes a process pointer and returns the PID associated with it
-	
-	*retval = proc_getpid(curproc);
+	// The PID is cached in the proc and never changes while it runs
+	*retval = curproc->p_pid;
 
 	return 0;
 }
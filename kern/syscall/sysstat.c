@@ -0,0 +1,290 @@
+/*
+ * System call statistics.
+ *
+ * See sysstat.h. Each cpu counts its own calls in c_sysstat; a report
+ * adds the tables up. Reports are taken without stopping the other
+ * cpus, so a busy counter can be off by the calls made while it was
+ * being read.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <kern/fcntl.h>
+#include <stdarg.h>
+#include <lib.h>
+#include <cpu.h>
+#include <current.h>
+#include <spl.h>
+#include <uio.h>
+#include <device.h>
+#include <vfs.h>
+#include <syscall.h>
+#include <sysstat.h>
+
+/* Room for the report; enough for every call number to appear. */
+#define SYSSTAT_BUFSIZE	16384
+
+void
+sysstat_cpuinit(struct cpu *c)
+{
+	unsigned i;
+
+	c->c_sysstat = kmalloc(SYSCALL_NUM * sizeof(struct sysstat));
+	if (c->c_sysstat == NULL) {
+		panic("sysstat: Out of memory\n");
+	}
+	for (i=0; i<SYSCALL_NUM; i++) {
+		c->c_sysstat[i].ss_calls = 0;
+		c->c_sysstat[i].ss_cycles = 0;
+		c->c_sysstat[i].ss_maxcycles = 0;
+	}
+}
+
+uint32_t
+sysstat_enter(unsigned callno)
+{
+	int spl;
+
+	if (callno < SYSCALL_NUM) {
+		/* Stay on this cpu while touching its table. */
+		spl = splhigh();
+		curcpu->c_sysstat[callno].ss_calls++;
+		splx(spl);
+	}
+	return cpu_getcycles();
+}
+
+void
+sysstat_exit(unsigned callno, uint32_t start)
+{
+	struct sysstat *ss;
+	uint32_t cycles;
+	int spl;
+
+	if (callno >= SYSCALL_NUM) {
+		return;
+	}
+
+	/*
+	 * The call may have slept and come back on another cpu. Cycle
+	 * counters aren't synchronized across cpus, but they run from
+	 * the same clock, so the difference is still about right.
+	 */
+	cycles = cpu_getcycles() - start;
+
+	spl = splhigh();
+	ss = &curcpu->c_sysstat[callno];
+	ss->ss_cycles += cycles;
+	if (cycles > ss->ss_maxcycles) {
+		ss->ss_maxcycles = cycles;
+	}
+	splx(spl);
+}
+
+/*
+ * Report buffer, filled in with sysstat_append.
+ */
+struct sysstat_buf {
+	char *sb_data;
+	size_t sb_len;
+};
+
+static
+void
+sysstat_append(struct sysstat_buf *sb, const char *fmt, ...)
+{
+	va_list ap;
+	int n;
+
+	if (sb->sb_len >= SYSSTAT_BUFSIZE - 1) {
+		return;
+	}
+	va_start(ap, fmt);
+	n = vsnprintf(sb->sb_data + sb->sb_len, SYSSTAT_BUFSIZE - sb->sb_len,
+		      fmt, ap);
+	va_end(ap);
+
+	sb->sb_len += n;
+	if (sb->sb_len > SYSSTAT_BUFSIZE - 1) {
+		/* truncated */
+		sb->sb_len = SYSSTAT_BUFSIZE - 1;
+	}
+}
+
+/*
+ * Write the report into a new buffer. Returns NULL if out of memory.
+ */
+static
+char *
+sysstat_report(size_t *len)
+{
+	struct sysstat_buf sb;
+	struct sysstat total;
+	const struct sysstat *ss;
+	const char *name;
+	char namebuf[16];
+	unsigned i, j, cpucalls;
+
+	sb.sb_data = kmalloc(SYSSTAT_BUFSIZE);
+	if (sb.sb_data == NULL) {
+		return NULL;
+	}
+	sb.sb_len = 0;
+	sb.sb_data[0] = '\0';
+
+	sysstat_append(&sb, "%-16s %9s %14s %10s %10s\n",
+		       "syscall", "calls", "total-cycles", "avg", "max");
+	for (i=0; i<SYSCALL_NUM; i++) {
+		total.ss_calls = 0;
+		total.ss_cycles = 0;
+		total.ss_maxcycles = 0;
+		for (j=0; j<num_cpus; j++) {
+			ss = &cpu_get(j)->c_sysstat[i];
+			total.ss_calls += ss->ss_calls;
+			total.ss_cycles += ss->ss_cycles;
+			if (ss->ss_maxcycles > total.ss_maxcycles) {
+				total.ss_maxcycles = ss->ss_maxcycles;
+			}
+		}
+		if (total.ss_calls == 0) {
+			continue;
+		}
+
+		name = syscall_name(i);
+		if (name == NULL) {
+			snprintf(namebuf, sizeof(namebuf), "#%u", i);
+			name = namebuf;
+		}
+		sysstat_append(&sb, "%-16s %9u %14llu %10llu %10u\n",
+			       name, total.ss_calls,
+			       (unsigned long long)total.ss_cycles,
+			       (unsigned long long)total.ss_cycles /
+			       total.ss_calls,
+			       total.ss_maxcycles);
+	}
+
+	for (j=0; j<num_cpus; j++) {
+		cpucalls = 0;
+		for (i=0; i<SYSCALL_NUM; i++) {
+			cpucalls += cpu_get(j)->c_sysstat[i].ss_calls;
+		}
+		sysstat_append(&sb, "cpu%u: %u calls\n", j, cpucalls);
+	}
+
+	*len = sb.sb_len;
+	return sb.sb_data;
+}
+
+void
+sysstat_print(void)
+{
+	char *report;
+	size_t len;
+
+	report = sysstat_report(&len);
+	if (report == NULL) {
+		kprintf("sysstat: Out of memory\n");
+		return;
+	}
+	kprintf("%s", report);
+	kfree(report);
+}
+
+void
+sysstat_reset(void)
+{
+	struct sysstat *ss;
+	unsigned i, j;
+
+	for (j=0; j<num_cpus; j++) {
+		for (i=0; i<SYSCALL_NUM; i++) {
+			ss = &cpu_get(j)->c_sysstat[i];
+			ss->ss_calls = 0;
+			ss->ss_cycles = 0;
+			ss->ss_maxcycles = 0;
+		}
+	}
+}
+
+/*
+ * The sysstat: device. Each read formats a fresh report and returns
+ * the part of it at the file offset, so reading it from start to end
+ * (e.g. with cat) gets the whole thing.
+ */
+static
+int
+sysstat_eachopen(struct device *dev, int openflags)
+{
+	(void)dev;
+
+	if ((openflags & O_ACCMODE) != O_RDONLY) {
+		return EIO;
+	}
+	return 0;
+}
+
+static
+int
+sysstat_io(struct device *dev, struct uio *uio)
+{
+	char *report;
+	size_t len;
+	int result;
+
+	(void)dev;
+
+	if (uio->uio_rw != UIO_READ) {
+		return EIO;
+	}
+
+	report = sysstat_report(&len);
+	if (report == NULL) {
+		return ENOMEM;
+	}
+	result = 0;
+	if (uio->uio_offset < (off_t)len) {
+		result = uiomove(report + uio->uio_offset,
+				 len - uio->uio_offset, uio);
+	}
+	kfree(report);
+	return result;
+}
+
+static
+int
+sysstat_ioctl(struct device *dev, int op, userptr_t data)
+{
+	(void)dev;
+	(void)op;
+	(void)data;
+	return EIOCTL;
+}
+
+static const struct device_ops sysstat_devops = {
+	.devop_eachopen = sysstat_eachopen,
+	.devop_io = sysstat_io,
+	.devop_ioctl = sysstat_ioctl,
+};
+
+void
+sysstat_bootstrap(void)
+{
+	struct device *dev;
+	int result;
+
+	dev = kmalloc(sizeof(*dev));
+	if (dev == NULL) {
+		panic("Could not add sysstat device: out of memory\n");
+	}
+
+	dev->d_ops = &sysstat_devops;
+	dev->d_blocks = 0;
+	dev->d_blocksize = 1;
+	dev->d_devnumber = 0; /* assigned by vfs_adddev */
+	dev->d_data = NULL;
+
+	result = vfs_adddev("sysstat", dev, 0);
+	if (result) {
+		panic("Could not add sysstat device: %s\n", strerror(result));
+	}
+}
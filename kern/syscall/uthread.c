@@ -0,0 +1,180 @@
+/*
+ * User threads: thread_create, thread_join and thread_exit.
+ *
+ * A user thread is just another kernel thread in the same struct
+ * proc, so it shares the address space, file table and cwd. Each one
+ * gets a numbered slot in p_uthreads and the matching stack slot in
+ * the address space (as_define_thread_stack); its thread id is the
+ * slot number plus one. The initial thread is id 0 and can't be
+ * joined.
+ *
+ * libc passes a start routine that calls the user's function and then
+ * thread_exit, so the kernel never has to return into user code that
+ * isn't expecting it.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <spinlock.h>
+#include <sleepq.h>
+#include <thread.h>
+#include <current.h>
+#include <proc.h>
+#include <addrspace.h>
+#include <copyinout.h>
+#include <syscall.h>
+
+/* What a new user thread needs to get to user mode. */
+struct uthread_start {
+	vaddr_t us_start;		/* libc start routine */
+	userptr_t us_func;		/* user's function */
+	userptr_t us_arg;		/* and its argument */
+	vaddr_t us_stackptr;		/* top of our stack slot */
+};
+
+static
+void
+uthread_entry(void *data1, unsigned long tid)
+{
+	struct uthread_start us;
+
+	us = *(struct uthread_start *)data1;
+	kfree(data1);
+
+	curthread->t_tid = tid;
+
+	/* Don't start if the process began exiting meanwhile. */
+	proc_checkexiting();
+
+	/*
+	 * enter_new_process puts its argc and argv in a0 and a1,
+	 * which is where the start routine wants FUNC and ARG.
+	 */
+	enter_new_process((int)(vaddr_t)us.us_func, us.us_arg, NULL,
+			  us.us_stackptr, us.us_start);
+}
+
+int
+sys___thread_create(userptr_t start, userptr_t func, userptr_t arg,
+		    int32_t *retval)
+{
+	struct proc *proc = curproc;
+	struct uthread_start *us;
+	struct uthread *ut;
+	unsigned slot;
+	int result;
+
+	/* Claim a slot. */
+	spinlock_acquire(&proc->p_lock);
+	for (slot = 0; slot < UTHREAD_MAX; slot++) {
+		if (proc->p_uthreads[slot].ut_state == UT_FREE) {
+			break;
+		}
+	}
+	if (slot == UTHREAD_MAX) {
+		spinlock_release(&proc->p_lock);
+		return EAGAIN;
+	}
+	ut = &proc->p_uthreads[slot];
+	ut->ut_state = UT_RUNNING;
+	ut->ut_joining = false;
+	ut->ut_retval = NULL;
+	spinlock_release(&proc->p_lock);
+
+	us = kmalloc(sizeof(*us));
+	if (us == NULL) {
+		result = ENOMEM;
+		goto fail;
+	}
+	us->us_start = (vaddr_t)start;
+	us->us_func = func;
+	us->us_arg = arg;
+
+	result = as_define_thread_stack(proc_getas(), slot, &us->us_stackptr);
+	if (result) {
+		kfree(us);
+		goto fail;
+	}
+
+	result = thread_fork(curthread->t_name, proc, uthread_entry, us,
+			     slot + 1);
+	if (result) {
+		kfree(us);
+		as_free_thread_stack(proc_getas(), slot);
+		goto fail;
+	}
+
+	*retval = slot + 1;
+	return 0;
+
+ fail:
+	spinlock_acquire(&proc->p_lock);
+	ut->ut_state = UT_FREE;
+	spinlock_release(&proc->p_lock);
+	return result;
+}
+
+/*
+ * Wait for thread TID to exit and collect its return value. Only one
+ * thread may join a given thread.
+ */
+int
+sys_thread_join(int tid, userptr_t retvalp)
+{
+	struct proc *proc = curproc;
+	struct uthread *ut;
+	userptr_t val;
+
+	if (tid <= 0 || tid > UTHREAD_MAX) {
+		return ESRCH;
+	}
+	if (tid == curthread->t_tid) {
+		/* can't wait for ourselves */
+		return EINVAL;
+	}
+	ut = &proc->p_uthreads[tid - 1];
+
+	spinlock_acquire(&proc->p_lock);
+	if (ut->ut_state == UT_FREE) {
+		spinlock_release(&proc->p_lock);
+		return ESRCH;
+	}
+	if (ut->ut_joining) {
+		spinlock_release(&proc->p_lock);
+		return EINVAL;
+	}
+	ut->ut_joining = true;
+	while (ut->ut_state != UT_EXITED && !proc->p_exiting) {
+		sleepq_sleep(ut, "thread_join", &proc->p_lock);
+	}
+	if (proc->p_exiting) {
+		/* We're about to be stopped; don't bother. */
+		spinlock_release(&proc->p_lock);
+		return EINTR;
+	}
+	val = ut->ut_retval;
+	spinlock_release(&proc->p_lock);
+
+	/*
+	 * The thread is off its user stack for good; give the stack
+	 * back before the slot can be handed out again.
+	 */
+	as_free_thread_stack(proc_getas(), tid - 1);
+
+	spinlock_acquire(&proc->p_lock);
+	ut->ut_state = UT_FREE;
+	ut->ut_joining = false;
+	spinlock_release(&proc->p_lock);
+
+	if (retvalp != NULL) {
+		return copyout(&val, retvalp, sizeof(val));
+	}
+	return 0;
+}
+
+int
+sys_thread_exit(userptr_t retval)
+{
+	proc_thread_exit(retval);
+}
@@ -101,6 +101,28 @@ bitmaptest(int nargs, char **args)
 		KASSERT(data[i]==0);
 	}
 
+	/* Full: nothing near anywhere either. */
+	KASSERT(bitmap_alloc_near(b, 100, 1, &x) != 0);
+
+	/* Free 10-11 and 300-309; the goal is taken if it's clear... */
+	bitmap_unmark(b, 10);
+	bitmap_unmark(b, 11);
+	for (i=300; i<310; i++) {
+		bitmap_unmark(b, i);
+	}
+	KASSERT(bitmap_alloc_near(b, 305, 4, &x) == 0);
+	KASSERT(x == 305);
+
+	/* ...otherwise the search prefers a long enough run... */
+	KASSERT(bitmap_alloc_near(b, 200, 5, &x) == 0);
+	KASSERT(x == 300);
+
+	/* ...falling back to the first clear bit, wrapping around. */
+	KASSERT(bitmap_alloc_near(b, 310, 8, &x) == 0);
+	KASSERT(x == 10);
+
+	bitmap_destroy(b);
+
 	kprintf("Bitmap test complete\n");
 	return 0;
 }
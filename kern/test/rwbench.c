@@ -0,0 +1,175 @@
+/*
+ * rwt6: reader-writer lock throughput test.
+ *
+ * Runs a read-mostly workload (one write per RWT6_WRITEEVERY
+ * operations) against a single rwlock with 1, 2, 4, ... threads up
+ * to twice the number of cpus, and reports operations per second for
+ * each round so read-side scaling can be compared across cpu counts.
+ * Readers also check that they never see a writer in progress or a
+ * half-written buffer; if they do, the test fails.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <thread.h>
+#include <synch.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define RWT6_OPS	2000	/* operations per thread per round */
+#define RWT6_WRITEEVERY	64	/* one write per this many operations */
+#define RWT6_WORDS	32	/* size of the protected buffer */
+
+static struct rwlock *rwt6_lock;
+static struct semaphore *rwt6_startsem;
+static struct semaphore *rwt6_donesem;
+
+static volatile uint32_t rwt6_data[RWT6_WORDS];
+static volatile bool rwt6_writing;
+static volatile bool rwt6_failed;
+
+static
+void
+rwt6_read(void)
+{
+	uint32_t first;
+	unsigned i;
+
+	rwlock_acquire_read(rwt6_lock);
+	if (rwt6_writing) {
+		rwt6_failed = true;
+	}
+	first = rwt6_data[0];
+	for (i=1; i<RWT6_WORDS; i++) {
+		if (rwt6_data[i] != first) {
+			rwt6_failed = true;
+		}
+	}
+	rwlock_release_read(rwt6_lock);
+}
+
+static
+void
+rwt6_write(void)
+{
+	uint32_t val;
+	unsigned i;
+
+	rwlock_acquire_write(rwt6_lock);
+	if (rwt6_writing) {
+		rwt6_failed = true;
+	}
+	rwt6_writing = true;
+	val = rwt6_data[0] + 1;
+	for (i=0; i<RWT6_WORDS; i++) {
+		rwt6_data[i] = val;
+	}
+	rwt6_writing = false;
+	rwlock_release_write(rwt6_lock);
+}
+
+static
+void
+rwt6_thread(void *junk, unsigned long num)
+{
+	unsigned i;
+
+	(void)junk;
+
+	P(rwt6_startsem);
+	for (i=0; i<RWT6_OPS; i++) {
+		/* Stagger the writes so the threads don't write in step. */
+		if ((i + num) % RWT6_WRITEEVERY == 0) {
+			rwt6_write();
+		}
+		else {
+			rwt6_read();
+		}
+	}
+	V(rwt6_donesem);
+}
+
+/*
+ * Run one round with NTHREADS threads and print its throughput.
+ */
+static
+void
+rwt6_round(unsigned nthreads)
+{
+	struct timespec before, after, duration;
+	uint64_t nsecs, ops;
+	unsigned i;
+	int result;
+
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("rwt6", NULL, rwt6_thread, NULL, i);
+		if (result) {
+			panic("rwt6: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&before);
+	for (i=0; i<nthreads; i++) {
+		V(rwt6_startsem);
+	}
+	for (i=0; i<nthreads; i++) {
+		P(rwt6_donesem);
+	}
+	gettime(&after);
+
+	timespec_sub(&after, &before, &duration);
+	nsecs = duration.tv_sec * 1000000000ULL + duration.tv_nsec;
+	ops = (uint64_t)nthreads * RWT6_OPS;
+
+	kprintf_n("rwt6: %3u threads: %llu ops in %llu.%09lu s, "
+		  "%llu ops/sec\n", nthreads, (unsigned long long)ops,
+		  (unsigned long long)duration.tv_sec,
+		  (unsigned long)duration.tv_nsec,
+		  nsecs == 0 ? 0ULL :
+		  (unsigned long long)(ops * 1000000000ULL / nsecs));
+}
+
+int
+rwtest6(int nargs, char **args)
+{
+	unsigned i, nthreads;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting rwt6...\n");
+
+	rwt6_lock = rwlock_create("rwt6");
+	rwt6_startsem = sem_create("rwt6 start", 0);
+	rwt6_donesem = sem_create("rwt6 done", 0);
+	if (rwt6_lock == NULL || rwt6_startsem == NULL ||
+	    rwt6_donesem == NULL) {
+		panic("rwt6: failed to create synch primitives\n");
+	}
+
+	for (i=0; i<RWT6_WORDS; i++) {
+		rwt6_data[i] = 0;
+	}
+	rwt6_writing = false;
+	rwt6_failed = false;
+
+	for (nthreads = 1; nthreads <= 2 * num_cpus; nthreads *= 2) {
+		rwt6_round(nthreads);
+	}
+
+	rwlock_destroy(rwt6_lock);
+	sem_destroy(rwt6_startsem);
+	sem_destroy(rwt6_donesem);
+	rwt6_lock = NULL;
+	rwt6_startsem = rwt6_donesem = NULL;
+
+	if (rwt6_failed) {
+		kprintf_n("rwt6: readers and writers overlapped\n");
+	}
+	success(rwt6_failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "rwt6");
+
+	return 0;
+}
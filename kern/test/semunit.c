@@ -147,7 +147,6 @@ spinlock_not_held(struct spinlock *splk)
  * 1. After a successful sem_create:
  *     - sem_name compares equal to the passed-in name
  *     - sem_name is not the same pointer as the passed-in name
- *     - sem_wchan is not null
  *     - sem_lock is not held and has no owner
  *     - sem_count is the passed-in count
  */
@@ -165,7 +164,6 @@ semu1(int nargs, char **args)
 	}
 	KASSERT(!strcmp(sem->sem_name, name));
 	KASSERT(sem->sem_name != name);
-	KASSERT(sem->sem_wchan != NULL);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 56);
 
@@ -255,7 +253,7 @@ semu5(int nargs, char **args)
 
 /*
  * 6. Passing a semaphore with a waiting thread to sem_destroy asserts
- * (in the wchan code).
+ * (in the sleep queue code).
  */
 int
 semu6(int nargs, char **args)
@@ -266,9 +264,9 @@ semu6(int nargs, char **args)
 
 	sem = makesem(0);
 	makewaiter(sem);
-	kprintf("This should assert that the wchan's threadlist is empty\n");
+	kprintf("This should assert that nothing is sleeping on it\n");
 	sem_destroy(sem);
-	panic("semu6: wchan_destroy with waiters succeeded\n");
+	panic("semu6: sem_destroy with waiters succeeded\n");
 	return 0;
 }
 
@@ -288,7 +286,7 @@ semu7(int nargs, char **args)
 
 	/*
 	 * Check for blocking by taking a spinlock; if we block while
-	 * holding a spinlock, wchan_sleep will assert.
+	 * holding a spinlock, sleepq_sleep will assert.
 	 */
 	spinlock_init(&lk);
 	spinlock_acquire(&lk);
@@ -309,7 +307,6 @@ semu7(int nargs, char **args)
 /*
  * 8/9. After calling V on a semaphore with no threads waiting:
  *    - sem_name is unchanged
- *    - sem_wchan is unchanged
  *    - sem_lock is (still) unheld and has no owner
  *    - sem_count is increased by one
  *
@@ -320,14 +317,12 @@ void
 do_semu89(bool interrupthandler)
 {
 	struct semaphore *sem;
-	struct wchan *wchan;
 	const char *name;
 
 	sem = makesem(0);
 
 	/* check preconditions */
 	name = sem->sem_name;
-	wchan = sem->sem_wchan;
 	KASSERT(!strcmp(name, NAMESTRING));
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 
@@ -354,7 +349,6 @@ do_semu89(bool interrupthandler)
 	/* check postconditions */
 	KASSERT(name == sem->sem_name);
 	KASSERT(!strcmp(name, NAMESTRING));
-	KASSERT(wchan == sem->sem_wchan);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 1);
 
@@ -385,7 +379,6 @@ semu9(int nargs, char **args)
  * 10/11. After calling V on a semaphore with one thread waiting, and giving
  * it time to run:
  *    - sem_name is unchanged
- *    - sem_wchan is unchanged
  *    - sem_lock is (still) unheld and has no owner
  *    - sem_count is still 0
  *    - the other thread does in fact run
@@ -397,7 +390,6 @@ int
 do_semu1011(bool interrupthandler)
 {
 	struct semaphore *sem;
-	struct wchan *wchan;
 	const char *name;
 
 	sem = makesem(0);
@@ -405,7 +397,6 @@ do_semu1011(bool interrupthandler)
 
 	/* check preconditions */
 	name = sem->sem_name;
-	wchan = sem->sem_wchan;
 	KASSERT(!strcmp(name, NAMESTRING));
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	spinlock_acquire(&waiters_lock);
@@ -431,7 +422,6 @@ do_semu1011(bool interrupthandler)
 	/* check postconditions */
 	KASSERT(name == sem->sem_name);
 	KASSERT(!strcmp(name, NAMESTRING));
-	KASSERT(wchan == sem->sem_wchan);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 0);
 	spinlock_acquire(&waiters_lock);
@@ -468,7 +458,6 @@ semu11(int nargs, char **args)
  * 12/13. After calling V on a semaphore with two threads waiting, and
  * giving it time to run:
  *    - sem_name is unchanged
- *    - sem_wchan is unchanged
  *    - sem_lock is (still) unheld and has no owner
  *    - sem_count is still 0
  *    - one of the other threads does in fact run
@@ -479,7 +468,6 @@ void
 semu1213(bool interrupthandler)
 {
 	struct semaphore *sem;
-	struct wchan *wchan;
 	const char *name;
 
 	sem = makesem(0);
@@ -488,9 +476,7 @@ semu1213(bool interrupthandler)
 
 	/* check preconditions */
 	name = sem->sem_name;
-	wchan = sem->sem_wchan;
 	KASSERT(!strcmp(name, NAMESTRING));
-	wchan = sem->sem_wchan;
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	spinlock_acquire(&waiters_lock);
 	KASSERT(waiters_running == 2);
@@ -515,7 +501,6 @@ semu1213(bool interrupthandler)
 	/* check postconditions */
 	KASSERT(name == sem->sem_name);
 	KASSERT(!strcmp(name, NAMESTRING));
-	KASSERT(wchan == sem->sem_wchan);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 0);
 	spinlock_acquire(&waiters_lock);
@@ -671,7 +656,6 @@ semu17(int nargs, char **args)
 /*
  * 18. After calling P on a semaphore with count > 0:
  *    - sem_name is unchanged
- *    - sem_wchan is unchanged
  *    - sem_lock is unheld and has no owner
  *    - sem_count is one less
  */
@@ -679,7 +663,6 @@ int
 semu18(int nargs, char **args)
 {
 	struct semaphore *sem;
-	struct wchan *wchan;
 	const char *name;
 
 	(void)nargs; (void)args;
@@ -689,7 +672,6 @@ semu18(int nargs, char **args)
 	/* preconditions */
 	name = sem->sem_name;
 	KASSERT(!strcmp(name, NAMESTRING));
-	wchan = sem->sem_wchan;
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 1);
 
@@ -698,7 +680,6 @@ semu18(int nargs, char **args)
 	/* postconditions */
 	KASSERT(name == sem->sem_name);
 	KASSERT(!strcmp(name, NAMESTRING));
-	KASSERT(wchan == sem->sem_wchan);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 0);
 
@@ -709,7 +690,6 @@ semu18(int nargs, char **args)
  * 19. After calling P on a semaphore with count == 0 and another
  * thread uses V exactly once to cause a wakeup:
  *    - sem_name is unchanged
- *    - sem_wchan is unchanged
  *    - sem_lock is unheld and has no owner
  *    - sem_count is still 0
  */
@@ -736,7 +716,6 @@ int
 semu19(int nargs, char **args)
 {
 	struct semaphore *sem;
-	struct wchan *wchan;
 	const char *name;
 	int result;
 
@@ -751,7 +730,6 @@ semu19(int nargs, char **args)
 	/* preconditions */
 	name = sem->sem_name;
 	KASSERT(!strcmp(name, NAMESTRING));
-	wchan = sem->sem_wchan;
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 0);
 
@@ -760,7 +738,6 @@ semu19(int nargs, char **args)
 	/* postconditions */
 	KASSERT(name == sem->sem_name);
 	KASSERT(!strcmp(name, NAMESTRING));
-	KASSERT(wchan == sem->sem_wchan);
 	KASSERT(spinlock_not_held(&sem->sem_lock));
 	KASSERT(sem->sem_count == 0);
 
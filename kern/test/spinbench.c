@@ -0,0 +1,153 @@
+/*
+ * spt1: spinlock stress test.
+ *
+ * Runs one thread per cpu (plus a few extra, so the scheduler spreads
+ * them out) hammering a single spinlock for SPT1_SECONDS, then
+ * reports total throughput and how many acquisitions each cpu got.
+ * With a fair lock the per-cpu counts should be close; the max/min
+ * ratio is printed to make starvation easy to spot. Each critical
+ * section also bumps an unprotected counter, and the test fails if
+ * that count doesn't match the number of acquisitions.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <clock.h>
+#include <cpu.h>
+#include <spinlock.h>
+#include <thread.h>
+#include <synch.h>
+#include <current.h>
+#include <test.h>
+#include <kern/test161.h>
+
+#define SPT1_SECONDS	2	/* length of the run */
+#define SPT1_EXTRA	2	/* threads beyond one per cpu */
+#define SPT1_WORK	16	/* loop iterations inside the lock */
+
+static struct spinlock spt1_lock = SPINLOCK_INITIALIZER_NAMED("spt1");
+static struct semaphore *spt1_startsem;
+static struct semaphore *spt1_donesem;
+
+static volatile bool spt1_stop;
+static volatile unsigned long spt1_shared;
+static unsigned long *spt1_percpu;
+
+static
+void
+spt1_thread(void *junk, unsigned long num)
+{
+	volatile unsigned i;
+
+	(void)junk;
+	(void)num;
+
+	P(spt1_startsem);
+	while (!spt1_stop) {
+		spinlock_acquire(&spt1_lock);
+		/* curcpu can't change while we hold a spinlock. */
+		spt1_percpu[curcpu->c_number]++;
+		spt1_shared++;
+		for (i=0; i<SPT1_WORK; i++) {
+			/* hold the lock a little while */
+		}
+		spinlock_release(&spt1_lock);
+	}
+	V(spt1_donesem);
+}
+
+int
+spinlocktest(int nargs, char **args)
+{
+	struct timespec before, after, duration;
+	unsigned long total, min, max;
+	uint64_t nsecs;
+	unsigned i, nthreads;
+	bool failed;
+	int result;
+
+	(void)nargs;
+	(void)args;
+
+	kprintf_n("Starting spt1...\n");
+
+	spt1_percpu = kmalloc(num_cpus * sizeof(spt1_percpu[0]));
+	spt1_startsem = sem_create("spt1 start", 0);
+	spt1_donesem = sem_create("spt1 done", 0);
+	if (spt1_percpu == NULL || spt1_startsem == NULL ||
+	    spt1_donesem == NULL) {
+		panic("spt1: out of memory\n");
+	}
+	for (i=0; i<num_cpus; i++) {
+		spt1_percpu[i] = 0;
+	}
+	spt1_shared = 0;
+	spt1_stop = false;
+
+	nthreads = num_cpus + SPT1_EXTRA;
+	for (i=0; i<nthreads; i++) {
+		result = thread_fork("spt1", NULL, spt1_thread, NULL, i);
+		if (result) {
+			panic("spt1: thread_fork failed: %s\n",
+			      strerror(result));
+		}
+	}
+
+	gettime(&before);
+	for (i=0; i<nthreads; i++) {
+		V(spt1_startsem);
+	}
+	clocksleep(SPT1_SECONDS);
+	spt1_stop = true;
+	for (i=0; i<nthreads; i++) {
+		P(spt1_donesem);
+	}
+	gettime(&after);
+
+	timespec_sub(&after, &before, &duration);
+	nsecs = duration.tv_sec * 1000000000ULL + duration.tv_nsec;
+
+	total = 0;
+	min = max = spt1_percpu[0];
+	for (i=0; i<num_cpus; i++) {
+		kprintf_n("spt1: cpu%u: %lu acquisitions\n", i,
+			  spt1_percpu[i]);
+		total += spt1_percpu[i];
+		if (spt1_percpu[i] < min) {
+			min = spt1_percpu[i];
+		}
+		if (spt1_percpu[i] > max) {
+			max = spt1_percpu[i];
+		}
+	}
+
+	kprintf_n("spt1: %u threads: %lu acquisitions in %llu.%09lu s, "
+		  "%llu per sec\n", nthreads, total,
+		  (unsigned long long)duration.tv_sec,
+		  (unsigned long)duration.tv_nsec,
+		  nsecs == 0 ? 0ULL :
+		  (unsigned long long)total * 1000000000ULL / nsecs);
+	if (min == 0) {
+		kprintf_n("spt1: fairness: max %lu, min 0 (starved)\n", max);
+	}
+	else {
+		kprintf_n("spt1: fairness: max %lu, min %lu, ratio %lu.%02lu\n",
+			  max, min, max / min, (max % min) * 100 / min);
+	}
+
+	failed = (spt1_shared != total);
+	if (failed) {
+		kprintf_n("spt1: lost updates: %lu of %lu\n",
+			  total - spt1_shared, total);
+	}
+
+	sem_destroy(spt1_startsem);
+	sem_destroy(spt1_donesem);
+	kfree(spt1_percpu);
+	spt1_startsem = spt1_donesem = NULL;
+	spt1_percpu = NULL;
+
+	success(failed ? TEST161_FAIL : TEST161_SUCCESS, SECRET, "spt1");
+
+	return 0;
+}
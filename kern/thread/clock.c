@@ -28,8 +28,11 @@
  */
 
 #include <types.h>
+#include <kern/userinfo.h>
 #include <lib.h>
 #include <cpu.h>
+#include <membar.h>
+#include <vm.h>
 #include <wchan.h>
 #include <clock.h>
 #include <thread.h>
@@ -59,6 +62,13 @@
 static struct wchan *lbolt;
 static struct spinlock lbolt_lock;
 
+/*
+ * The user clock page. It's a whole page of its own because it gets
+ * mapped into user address spaces.
+ */
+struct userclock *userclock;
+static bool userclock_running;
+
 /*
  * Setup.
  */
@@ -70,6 +80,39 @@ hardclock_bootstrap(void)
 	if (lbolt == NULL) {
 		panic("Couldn't create lbolt\n");
 	}
+
+	userclock = kmalloc(PAGE_SIZE);
+	if (userclock == NULL) {
+		panic("Couldn't allocate the user clock page\n");
+	}
+	bzero(userclock, PAGE_SIZE);
+}
+
+/*
+ * Copy the time of day into the user clock page. uc_seq is odd while
+ * the time is being changed, so readers can tell they raced with us.
+ * Only cpu 0 does this, so there's only ever one writer.
+ */
+static
+void
+userclock_update(void)
+{
+	struct timespec ts;
+
+	gettime(&ts);
+	userclock->uc_seq++;
+	membar_store_store();
+	userclock->uc_secs = ts.tv_sec;
+	userclock->uc_nsecs = ts.tv_nsec;
+	membar_store_store();
+	userclock->uc_seq++;
+}
+
+void
+userclock_start(void)
+{
+	userclock_update();
+	userclock_running = true;
 }
 
 /*
@@ -97,6 +140,9 @@ hardclock(void)
 	 */
 
 	curcpu->c_hardclocks++;
+	if (userclock_running && curcpu->c_number == 0) {
+		userclock_update();
+	}
 	if ((curcpu->c_hardclocks % MIGRATE_HARDCLOCKS) == 0) {
 		thread_consider_migration();
 	}
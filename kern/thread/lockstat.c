@@ -0,0 +1,270 @@
+/*
+ * Lock contention statistics.
+ *
+ * See lockstat.h. This file is only built with "options lockstat".
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <cpu.h>
+#include <spl.h>
+#include <spinlock.h>
+#include <membar.h>
+#include <lockstat.h>
+
+#define LOCKSTAT_MAGIC	0x10c57a75
+
+/* Length of names in a report; longer ones are truncated. */
+#define LOCKSTAT_NAMELEN 24
+
+/*
+ * The global list of records.
+ *
+ * This can't be protected with a struct spinlock, because then
+ * taking it would update (and possibly list) its own record. Instead
+ * use the machine-level test-and-set directly. Nothing else is ever
+ * acquired while holding it.
+ */
+static volatile spinlock_data_t lockstat_listlock = SPINLOCK_DATA_INITIALIZER;
+static struct lockstat *lockstat_list;
+
+/*
+ * Snapshot of one record, for reporting. We copy the name because
+ * the lock might be destroyed while we're printing.
+ */
+struct lockstat_report {
+	char lr_name[LOCKSTAT_NAMELEN];
+	bool lr_sleeplock;
+	unsigned lr_acquires;
+	unsigned lr_contended;
+	uint64_t lr_waittotal;
+	uint32_t lr_waitmax;
+	uint64_t lr_holdtotal;
+	uint32_t lr_holdmax;
+};
+
+static
+void
+lockstat_lock(void)
+{
+	splraise(IPL_NONE, IPL_HIGH);
+	while (1) {
+		if (spinlock_data_get(&lockstat_listlock) != 0) {
+			continue;
+		}
+		if (spinlock_data_testandset(&lockstat_listlock) != 0) {
+			continue;
+		}
+		break;
+	}
+	membar_store_any();
+}
+
+static
+void
+lockstat_unlock(void)
+{
+	membar_any_store();
+	spinlock_data_set(&lockstat_listlock, 0);
+	spllower(IPL_HIGH, IPL_NONE);
+}
+
+static
+bool
+lockstat_islisted(struct lockstat *ls)
+{
+	return ls->ls_magic == LOCKSTAT_MAGIC && ls->ls_self == ls;
+}
+
+/*
+ * Put a record on the list. Call with the list locked.
+ */
+static
+void
+lockstat_addlist(struct lockstat *ls)
+{
+	ls->ls_magic = LOCKSTAT_MAGIC;
+	ls->ls_self = ls;
+	ls->ls_next = lockstat_list;
+	ls->ls_prevp = &lockstat_list;
+	if (lockstat_list != NULL) {
+		lockstat_list->ls_prevp = &ls->ls_next;
+	}
+	lockstat_list = ls;
+}
+
+static
+void
+lockstat_zero(struct lockstat *ls)
+{
+	ls->ls_acquires = 0;
+	ls->ls_contended = 0;
+	ls->ls_waittotal = 0;
+	ls->ls_waitmax = 0;
+	ls->ls_holdtotal = 0;
+	ls->ls_holdmax = 0;
+}
+
+void
+lockstat_init(struct lockstat *ls, const char *name, bool sleeplock)
+{
+	lockstat_lock();
+	ls->ls_name = name;
+	ls->ls_sleeplock = sleeplock;
+	ls->ls_holdstart = 0;
+	lockstat_zero(ls);
+	if (!lockstat_islisted(ls)) {
+		lockstat_addlist(ls);
+	}
+	lockstat_unlock();
+}
+
+void
+lockstat_cleanup(struct lockstat *ls)
+{
+	lockstat_lock();
+	if (lockstat_islisted(ls)) {
+		*ls->ls_prevp = ls->ls_next;
+		if (ls->ls_next != NULL) {
+			ls->ls_next->ls_prevp = ls->ls_prevp;
+		}
+		ls->ls_next = NULL;
+		ls->ls_prevp = NULL;
+		ls->ls_self = NULL;
+		ls->ls_magic = 0;
+	}
+	lockstat_unlock();
+}
+
+void
+lockstat_acquired(struct lockstat *ls, uint32_t start, bool contended)
+{
+	uint32_t now, wait;
+
+	/* Statically initialized spinlocks get listed on first use. */
+	if (!lockstat_islisted(ls)) {
+		lockstat_lock();
+		if (!lockstat_islisted(ls)) {
+			lockstat_addlist(ls);
+		}
+		lockstat_unlock();
+	}
+
+	now = cpu_getcycles();
+	wait = now - start;
+
+	ls->ls_acquires++;
+	if (contended) {
+		ls->ls_contended++;
+	}
+	ls->ls_waittotal += wait;
+	if (wait > ls->ls_waitmax) {
+		ls->ls_waitmax = wait;
+	}
+	ls->ls_holdstart = now;
+}
+
+void
+lockstat_released(struct lockstat *ls)
+{
+	uint32_t hold;
+
+	hold = cpu_getcycles() - ls->ls_holdstart;
+	ls->ls_holdtotal += hold;
+	if (hold > ls->ls_holdmax) {
+		ls->ls_holdmax = hold;
+	}
+}
+
+/*
+ * Insert a snapshot of LS into TOP, which has room for MAX entries
+ * and currently holds *NUM of them, sorted by decreasing total wait.
+ */
+static
+void
+lockstat_rank(struct lockstat_report *top, unsigned max, unsigned *num,
+	      struct lockstat *ls)
+{
+	unsigned i;
+
+	if (ls->ls_acquires == 0) {
+		return;
+	}
+	if (*num == max && ls->ls_waittotal <= top[max-1].lr_waittotal) {
+		return;
+	}
+
+	i = (*num < max) ? (*num)++ : max - 1;
+	while (i > 0 && top[i-1].lr_waittotal < ls->ls_waittotal) {
+		top[i] = top[i-1];
+		i--;
+	}
+
+	if (ls->ls_name != NULL) {
+		snprintf(top[i].lr_name, LOCKSTAT_NAMELEN, "%s", ls->ls_name);
+	}
+	else {
+		snprintf(top[i].lr_name, LOCKSTAT_NAMELEN, "%p", ls);
+	}
+	top[i].lr_sleeplock = ls->ls_sleeplock;
+	top[i].lr_acquires = ls->ls_acquires;
+	top[i].lr_contended = ls->ls_contended;
+	top[i].lr_waittotal = ls->ls_waittotal;
+	top[i].lr_waitmax = ls->ls_waitmax;
+	top[i].lr_holdtotal = ls->ls_holdtotal;
+	top[i].lr_holdmax = ls->ls_holdmax;
+}
+
+void
+lockstat_dump(unsigned max)
+{
+	struct lockstat_report *top;
+	struct lockstat *ls;
+	unsigned i, num, total;
+
+	KASSERT(max > 0);
+
+	top = kmalloc(max * sizeof(*top));
+	if (top == NULL) {
+		kprintf("lockstat: Out of memory\n");
+		return;
+	}
+
+	num = total = 0;
+	lockstat_lock();
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		lockstat_rank(top, max, &num, ls);
+		total++;
+	}
+	lockstat_unlock();
+
+	kprintf("lockstat: %u locks, top %u by total wait (cycles)\n",
+		total, num);
+	kprintf("%-24s %-4s %9s %9s %12s %10s %12s %10s\n",
+		"name", "type", "acquires", "contended",
+		"wait-total", "wait-max", "hold-total", "hold-max");
+	for (i=0; i<num; i++) {
+		kprintf("%-24s %-4s %9u %9u %12llu %10u %12llu %10u\n",
+			top[i].lr_name,
+			top[i].lr_sleeplock ? "lock" : "spin",
+			top[i].lr_acquires, top[i].lr_contended,
+			(unsigned long long)top[i].lr_waittotal,
+			top[i].lr_waitmax,
+			(unsigned long long)top[i].lr_holdtotal,
+			top[i].lr_holdmax);
+	}
+
+	kfree(top);
+}
+
+void
+lockstat_reset(void)
+{
+	struct lockstat *ls;
+
+	lockstat_lock();
+	for (ls = lockstat_list; ls != NULL; ls = ls->ls_next) {
+		lockstat_zero(ls);
+	}
+	lockstat_unlock();
+}
@@ -50,8 +50,12 @@
 void
 spinlock_init(struct spinlock *splk)
 {
-	spinlock_data_set(&splk->splk_lock, 0);
+	spinlock_data_set(&splk->splk_next, 0);
+	spinlock_data_set(&splk->splk_owner, 0);
 	splk->splk_holder = NULL;
+#if OPT_LOCKSTAT
+	lockstat_init(&splk->splk_stat, NULL, false);
+#endif
 }
 
 /*
@@ -61,7 +65,11 @@ void
 spinlock_cleanup(struct spinlock *splk)
 {
 	KASSERT(splk->splk_holder == NULL);
-	KASSERT(spinlock_data_get(&splk->splk_lock) == 0);
+	KASSERT(spinlock_data_get(&splk->splk_next) ==
+		spinlock_data_get(&splk->splk_owner));
+#if OPT_LOCKSTAT
+	lockstat_cleanup(&splk->splk_stat);
+#endif
 }
 
 /*
@@ -69,12 +77,17 @@ spinlock_cleanup(struct spinlock *splk)
  *
  * First disable interrupts (otherwise, if we get a timer interrupt we
  * might come back to this lock and deadlock), then use a machine-level
- * atomic operation to wait for the lock to be free.
+ * atomic operation to take a ticket and wait for our turn.
  */
 void
 spinlock_acquire(struct spinlock *splk)
 {
 	struct cpu *mycpu;
+	spinlock_data_t ticket;
+#if OPT_LOCKSTAT
+	uint32_t start;
+	bool contended = false;
+#endif
 
 	splraise(IPL_NONE, IPL_HIGH);
 
@@ -90,28 +103,29 @@ spinlock_acquire(struct spinlock *splk)
 		mycpu = NULL;
 	}
 
-	while (1) {
-		/*
-		 * Do test-test-and-set, that is, read first before
-		 * doing test-and-set, to reduce bus contention.
-		 *
-		 * Test-and-set is a machine-level atomic operation
-		 * that writes 1 into the lock word and returns the
-		 * previous value. If that value was 0, the lock was
-		 * previously unheld and we now own it. If it was 1,
-		 * we don't.
-		 */
-		if (spinlock_data_get(&splk->splk_lock) != 0) {
-			continue;
-		}
-		if (spinlock_data_testandset(&splk->splk_lock) != 0) {
-			continue;
-		}
-		break;
+#if OPT_LOCKSTAT
+	start = cpu_getcycles();
+#endif
+	/*
+	 * Take a ticket. This is the only atomic read-modify-write;
+	 * after it we just read splk_owner, which stays in our cache
+	 * until the holder releases, so waiting CPUs don't fight over
+	 * the bus the way test-and-set does. Tickets are served in
+	 * order, so the wait is bounded by the number of CPUs ahead
+	 * of us.
+	 */
+	ticket = spinlock_data_fetchinc(&splk->splk_next);
+	while (spinlock_data_get(&splk->splk_owner) != ticket) {
+#if OPT_LOCKSTAT
+		contended = true;
+#endif
 	}
 
 	membar_store_any();
 	splk->splk_holder = mycpu;
+#if OPT_LOCKSTAT
+	lockstat_acquired(&splk->splk_stat, start, contended);
+#endif
 }
 
 /*
@@ -127,9 +141,14 @@ spinlock_release(struct spinlock *splk)
 		curcpu->c_spinlocks--;
 	}
 
+#if OPT_LOCKSTAT
+	lockstat_released(&splk->splk_stat);
+#endif
 	splk->splk_holder = NULL;
 	membar_any_store();
-	spinlock_data_set(&splk->splk_lock, 0);
+	/* Only the holder writes splk_owner, so no atomic op is needed. */
+	spinlock_data_set(&splk->splk_owner,
+			  spinlock_data_get(&splk->splk_owner) + 1);
 	spllower(IPL_HIGH, IPL_NONE);
 }
 
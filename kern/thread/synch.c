@@ -34,8 +34,9 @@
 
 #include <types.h>
 #include <lib.h>
+#include <cpu.h>
 #include <spinlock.h>
-#include <wchan.h>
+#include <sleepq.h>
 #include <thread.h>
 #include <current.h>
 #include <synch.h>
@@ -60,14 +61,10 @@ sem_create(const char *name, unsigned initial_count)
 		return NULL;
 	}
 
-	sem->sem_wchan = wchan_create(sem->sem_name);
-	if (sem->sem_wchan == NULL) {
-		kfree(sem->sem_name);
-		kfree(sem);
-		return NULL;
-	}
-
 	spinlock_init(&sem->sem_lock);
+#if OPT_LOCKSTAT
+	sem->sem_lock.splk_stat.ls_name = sem->sem_name;
+#endif
 	sem->sem_count = initial_count;
 
 	return sem;
@@ -78,9 +75,12 @@ sem_destroy(struct semaphore *sem)
 {
 	KASSERT(sem != NULL);
 
-	/* wchan_cleanup will assert if anyone's waiting on it */
+	/* Nobody may be waiting on it */
+	spinlock_acquire(&sem->sem_lock);
+	KASSERT(sleepq_isempty(sem, &sem->sem_lock));
+	spinlock_release(&sem->sem_lock);
+
 	spinlock_cleanup(&sem->sem_lock);
-	wchan_destroy(sem->sem_wchan);
 	kfree(sem->sem_name);
 	kfree(sem);
 }
@@ -98,7 +98,7 @@ P(struct semaphore *sem)
 	 */
 	KASSERT(curthread->t_in_interrupt == false);
 
-	/* Use the semaphore spinlock to protect the wchan as well. */
+	/* The semaphore spinlock is the sleep queue's interlock. */
 	spinlock_acquire(&sem->sem_lock);
 	while (sem->sem_count == 0) {
 		/*
@@ -113,7 +113,7 @@ P(struct semaphore *sem)
 		 * Exercise: how would you implement strict FIFO
 		 * ordering?
 		 */
-		wchan_sleep(sem->sem_wchan, &sem->sem_lock);
+		sleepq_sleep(sem, sem->sem_name, &sem->sem_lock);
 	}
 	KASSERT(sem->sem_count > 0);
 	sem->sem_count--;
@@ -129,7 +129,7 @@ V(struct semaphore *sem)
 
 	sem->sem_count++;
 	KASSERT(sem->sem_count > 0);
-	wchan_wakeone(sem->sem_wchan, &sem->sem_lock);
+	sleepq_wakeone(sem, &sem->sem_lock);
 
 	spinlock_release(&sem->sem_lock);
 }
@@ -154,13 +154,11 @@ lock_create(const char *name)
 		return NULL;
 	}
 	
-	lock->lk_wchan = wchan_create(lock->lk_name);
-	if (lock->lk_wchan == NULL) {
-		kfree(lock);
-		return NULL;
-	}
-	
 	spinlock_init(&lock->lk_spinlock);
+#if OPT_LOCKSTAT
+	lock->lk_spinlock.splk_stat.ls_name = lock->lk_name;
+	lockstat_init(&lock->lk_stat, lock->lk_name, true);
+#endif
 	
 	// A lock is similar to a semaphore with only one slot
 	lock->lock_count = 1;
@@ -176,12 +174,19 @@ lock_destroy(struct lock *lock)
 {
 	KASSERT(lock != NULL);
 
+	// Nobody may be waiting for it
+	spinlock_acquire(&lock->lk_spinlock);
+	KASSERT(sleepq_isempty(lock, &lock->lk_spinlock));
+	spinlock_release(&lock->lk_spinlock);
+
 	// Free all memory contained in lock struct
 	spinlock_cleanup(&lock->lk_spinlock);
-	wchan_destroy(lock->lk_wchan);
 	
 	// When lock is destroyed, no thread should be holding it
 	KASSERT(lock->lk_holder == NULL);
+#if OPT_LOCKSTAT
+	lockstat_cleanup(&lock->lk_stat);
+#endif
 	kfree(lock->lk_name);
 	kfree(lock);
 }
@@ -189,16 +194,24 @@ lock_destroy(struct lock *lock)
 void
 lock_acquire(struct lock *lock)
 {	
+#if OPT_LOCKSTAT
+	uint32_t start = cpu_getcycles();
+	bool contended = false;
+#endif
+
 	KASSERT(lock != NULL);	 
 
 	spinlock_acquire(&lock->lk_spinlock);	
 
 	//spinlock_acquire(&lock->lk_spinlock);
 	while(lock->lock_count == 0){
-		// While there are no slots for the lock, wait on		
-		// held wait channel
+		// While there are no slots for the lock, sleep on
+		// the lock's address
 		//spinlock_release(&lock->lk_spinlock);
-		wchan_sleep(lock->lk_wchan, &lock->lk_spinlock);
+#if OPT_LOCKSTAT
+		contended = true;
+#endif
+		sleepq_sleep(lock, lock->lk_name, &lock->lk_spinlock);
 	}
 	
 	KASSERT(lock->lock_count == 1);
@@ -208,6 +221,9 @@ lock_acquire(struct lock *lock)
 
 	// Decrease lock count to 0 to hold it
 	lock->lock_count--;
+#if OPT_LOCKSTAT
+	lockstat_acquired(&lock->lk_stat, start, contended);
+#endif
 	spinlock_release(&lock->lk_spinlock);	
 
 }
@@ -224,14 +240,18 @@ lock_release(struct lock *lock)
 	// Acquire Spinlock
 	spinlock_acquire(&lock->lk_spinlock);		
 	
-	// Increase counter, notify done using lock via wakeup on wait channel
+#if OPT_LOCKSTAT
+	lockstat_released(&lock->lk_stat);
+#endif
+
+	// Increase counter, notify done using lock via wakeup on its sleep queue
 	lock->lock_count++;
 	KASSERT(lock->lock_count > 0);	// But first make sure it was a success!
 	
 	// Remove holder
 	lock->lk_holder = NULL;
 
-	wchan_wakeone(lock->lk_wchan, &lock->lk_spinlock);
+	sleepq_wakeone(lock, &lock->lk_spinlock);
 	
 	// Release spinlock
 	spinlock_release(&lock->lk_spinlock);
@@ -274,17 +294,14 @@ cv_create(const char *name)
 	}
 
 	spinlock_init(&cv->cv_spinlock);	
+#if OPT_LOCKSTAT
+	cv->cv_spinlock.splk_stat.ls_name = cv->cv_name;
+#endif
 	if (&cv->cv_spinlock==NULL) {
 		kfree(cv);
 		return NULL;
 	}
 
-	cv->cv_wchan = wchan_create(name);
-	if (cv->cv_wchan == NULL) {
-		kfree(cv);
-		return NULL;
-	}
-
 	return cv;
 }
 
@@ -295,10 +312,14 @@ cv_destroy(struct cv *cv)
 
 	// Ensure nobody holds the spinlock before imminent destruction	
 	KASSERT(!spinlock_do_i_hold(&cv->cv_spinlock));
+
+	// Nobody may be waiting on it
+	spinlock_acquire(&cv->cv_spinlock);
+	KASSERT(sleepq_isempty(cv, &cv->cv_spinlock));
+	spinlock_release(&cv->cv_spinlock);
 	
-	kfree(cv->cv_name);
-	wchan_destroy(cv->cv_wchan);
 	spinlock_cleanup(&cv->cv_spinlock);
+	kfree(cv->cv_name);
 	kfree(cv);
 }
 
@@ -318,7 +339,7 @@ cv_wait(struct cv *cv, struct lock *lock)
 	lock_release(lock);
 	
 	//wchan_sleep(lock->lk_wchan, &cv->cv_spinlock);	//INCORRECT
-	wchan_sleep(cv->cv_wchan, &cv->cv_spinlock);
+	sleepq_sleep(cv, cv->cv_name, &cv->cv_spinlock);
 	
 	spinlock_release(&cv->cv_spinlock);
 	lock_acquire(lock);
@@ -334,7 +355,7 @@ cv_signal(struct cv *cv, struct lock *lock)
 	spinlock_acquire(&cv->cv_spinlock);
 	
 	//wchan_wakeone(lock->lk_wchan, &cv->cv_spinlock);	//INCORRECT
-	wchan_wakeone(cv->cv_wchan, &cv->cv_spinlock);	
+	sleepq_wakeone(cv, &cv->cv_spinlock);
 	
 	spinlock_release(&cv->cv_spinlock);
 
@@ -349,7 +370,7 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 	spinlock_acquire(&cv->cv_spinlock);
 	
 	//wchan_wakeall(lock->lk_wchan, &cv->cv_spinlock);	//INCORRECT
-	wchan_wakeall(cv->cv_wchan, &cv->cv_spinlock);
+	sleepq_wakeall(cv, &cv->cv_spinlock);
 
 	spinlock_release(&cv->cv_spinlock);	
 
@@ -358,11 +379,22 @@ cv_broadcast(struct cv *cv, struct lock *lock)
 //
 // Read - Write Locks. Written by: William Burgin (waburgin)
 
+/*
+ * Readers and writers sleep on different keys so a writer release
+ * can wake one class without disturbing the other.
+ */
+#define RW_READKEY(rw)	((const void *)&(rw)->rw_readwait)
+#define RW_WRITEKEY(rw)	((const void *)&(rw)->rw_writewait)
+
 struct rwlock *
-rwlock_create(const char *name){
-	
+rwlock_create(const char *name)
+{
 	struct rwlock *rwlock;
+
 	rwlock = kmalloc(sizeof(*rwlock));
+	if (rwlock == NULL) {
+		return NULL;
+	}
 
 	rwlock->rw_name = kstrdup(name);
 	if (rwlock->rw_name == NULL) {
@@ -370,131 +402,146 @@ rwlock_create(const char *name){
 		return NULL;
 	}
 
-	rwlock->conditional_read = cv_create(rwlock->rw_name);
-	if (&rwlock->conditional_read == NULL) {
-		kfree(rwlock);
-		return NULL;
-	}
-	
-	rwlock->conditional_write = cv_create(rwlock->rw_name);
-	if (&rwlock->conditional_write == NULL) {
-		kfree(rwlock);
-		return NULL;
-	}
+	spinlock_init(&rwlock->rw_spinlock);
+#if OPT_LOCKSTAT
+	rwlock->rw_spinlock.splk_stat.ls_name = rwlock->rw_name;
+#endif
 
-	rwlock->rw_lock = lock_create(rwlock->rw_name);	
-	if (&rwlock->rw_lock == NULL) {
-		kfree(rwlock);
-		return NULL;
-	}	
-	
-	// Set current number of readers & anti-starvation guard to 0. No writers waiting at start.
-	rwlock->rw_num_readers = 0;
-	rwlock->anti_starvation = 0;
-	rwlock->is_writer_waiting = false;
+	rwlock->rw_readers = 0;
+	rwlock->rw_writer = NULL;
+	rwlock->rw_readwait = 0;
+	rwlock->rw_writewait = 0;
+	rwlock->rw_readgen = 0;
 
-	return rwlock;	
+	return rwlock;
 }
 
 void
-rwlock_destroy(struct rwlock *rwlock){	
-	
+rwlock_destroy(struct rwlock *rwlock)
+{
 	KASSERT(rwlock != NULL);
-	KASSERT(!lock_do_i_hold(rwlock->rw_lock));
-	
+
+	/* Nobody may hold or be waiting for the lock. */
+	KASSERT(rwlock->rw_readers == 0);
+	KASSERT(rwlock->rw_writer == NULL);
+	KASSERT(rwlock->rw_readwait == 0);
+	KASSERT(rwlock->rw_writewait == 0);
+
+	spinlock_cleanup(&rwlock->rw_spinlock);
 	kfree(rwlock->rw_name);
-	lock_destroy(rwlock->rw_lock);
-	cv_destroy(rwlock->conditional_read);
-	cv_destroy(rwlock->conditional_write);	
 	kfree(rwlock);
-	
-	return;
 }
 
 void
-rwlock_acquire_read(struct rwlock *rwlock){
-	
+rwlock_acquire_read(struct rwlock *rwlock)
+{
+	unsigned gen;
+
 	KASSERT(rwlock != NULL);
-	
-	lock_acquire(rwlock->rw_lock); 
-	
-	// If there is a writer awaiting access, yield to it via cv_wait.
-	// OR, if enough readers have been looking at buffer, allow a writer through.
-	while(rwlock->is_writer_waiting || rwlock->anti_starvation > 6){
+	KASSERT(curthread->t_in_interrupt == false);
 
-		cv_wait(rwlock->conditional_read, rwlock->rw_lock);
-	}	
+	spinlock_acquire(&rwlock->rw_spinlock);
+	KASSERT(rwlock->rw_writer != curthread);
 
-	// Lock acquired. Increment number of readers.
-	rwlock->rw_num_readers++;
-	rwlock->anti_starvation++;	// Read "successful".
-	lock_release(rwlock->rw_lock);
+	/* Fast path: no writer holds the lock or is waiting for it. */
+	if (rwlock->rw_writer == NULL && rwlock->rw_writewait == 0) {
+		rwlock->rw_readers++;
+		spinlock_release(&rwlock->rw_spinlock);
+		return;
+	}
 
-	return;	
+	/*
+	 * Queue behind the writer(s). The next writer to release will
+	 * count us in rw_readers and bump rw_readgen.
+	 */
+	gen = rwlock->rw_readgen;
+	rwlock->rw_readwait++;
+	while (rwlock->rw_readgen == gen) {
+		sleepq_sleep(RW_READKEY(rwlock), rwlock->rw_name,
+			     &rwlock->rw_spinlock);
+	}
+	KASSERT(rwlock->rw_readers > 0);
+	KASSERT(rwlock->rw_writer == NULL);
+
+	spinlock_release(&rwlock->rw_spinlock);
 }
 
 void
-rwlock_release_read(struct rwlock *rwlock){
-	
-	KASSERT(rwlock->rw_num_readers > 0);
-	
-	lock_acquire(rwlock->rw_lock);
-	rwlock->rw_num_readers--;	// Release reader from pool by decrementing total readers
-	
-	// If this is the last reader to release, signal to writer it can proceed
-	if( rwlock->rw_num_readers == 0 ){
-	
-		cv_signal(rwlock->conditional_write, rwlock->rw_lock);
-	}
+rwlock_release_read(struct rwlock *rwlock)
+{
+	KASSERT(rwlock != NULL);
 
-	lock_release(rwlock->rw_lock);
+	spinlock_acquire(&rwlock->rw_spinlock);
+	KASSERT(rwlock->rw_readers > 0);
+	KASSERT(rwlock->rw_writer == NULL);
 
-	return;
+	rwlock->rw_readers--;
+	if (rwlock->rw_readers == 0 && rwlock->rw_writewait > 0) {
+		sleepq_wakeone(RW_WRITEKEY(rwlock), &rwlock->rw_spinlock);
+	}
+
+	spinlock_release(&rwlock->rw_spinlock);
 }
 
 void
-rwlock_acquire_write(struct rwlock *rwlock){
-	
+rwlock_acquire_write(struct rwlock *rwlock)
+{
 	KASSERT(rwlock != NULL);
-	KASSERT(rwlock->rw_num_readers == 0);
-	
-	// Set flag to declare waiting; so readers know they should yield either now, or soon.
-	lock_acquire(rwlock->rw_lock);
-	rwlock->is_writer_waiting = true;
-	
-	// Loop until all readers are on cv_wait. Then proceed.
-	while(rwlock->rw_num_readers > 0){
-		
-		cv_wait(rwlock->conditional_write, rwlock->rw_lock);	
+	KASSERT(curthread->t_in_interrupt == false);
+
+	spinlock_acquire(&rwlock->rw_spinlock);
+	KASSERT(rwlock->rw_writer != curthread);
+
+	/*
+	 * Waiting readers have already been admitted by the time a
+	 * batch is released, so checking rw_readers covers them too.
+	 */
+	if (rwlock->rw_writer != NULL || rwlock->rw_readers > 0) {
+		rwlock->rw_writewait++;
+		do {
+			sleepq_sleep(RW_WRITEKEY(rwlock), rwlock->rw_name,
+				     &rwlock->rw_spinlock);
+		} while (rwlock->rw_writer != NULL || rwlock->rw_readers > 0);
+		rwlock->rw_writewait--;
 	}
 
-	KASSERT(rwlock->rw_num_readers == 0);	
-	
-	// Writer now exclusively owns access, readers are all on cv_wait
-	lock_release(rwlock->rw_lock);
+	rwlock->rw_writer = curthread;
 
-	return;
+	spinlock_release(&rwlock->rw_spinlock);
 }
 
 void
-rwlock_release_write(struct rwlock *rwlock){
-	
+rwlock_release_write(struct rwlock *rwlock)
+{
 	KASSERT(rwlock != NULL);
 
-	// Swap flag back to false when done writing
-	lock_acquire(rwlock->rw_lock);
-	rwlock->is_writer_waiting = false;
-	
-	// Writer got a chance to proceed, reset anti-starvation guard.
-	rwlock->anti_starvation = 0;
+	spinlock_acquire(&rwlock->rw_spinlock);
+	KASSERT(rwlock->rw_writer == curthread);
+	KASSERT(rwlock->rw_readers == 0);
+
+	rwlock->rw_writer = NULL;
 
-	// Let readers on cv_wait know they can resume reading the resource
-	// There may be (and probably is) more than one writer on the wait channel
-	// so broadcast to all of them since access isn't limited to one reader.
-	cv_broadcast(rwlock->conditional_read, rwlock->rw_lock);
-	//cv_signal(rwlock->conditional_read, rwlock->rw_lock);	
+	if (rwlock->rw_readwait > 0) {
+		/*
+		 * Hand the lock to every queued reader at once. Any
+		 * waiting writer goes after this batch drains.
+		 */
+		rwlock->rw_readers = rwlock->rw_readwait;
+		rwlock->rw_readwait = 0;
+		rwlock->rw_readgen++;
+		sleepq_wakeall(RW_READKEY(rwlock), &rwlock->rw_spinlock);
+	}
+	else if (rwlock->rw_writewait > 0) {
+		sleepq_wakeone(RW_WRITEKEY(rwlock), &rwlock->rw_spinlock);
+	}
 
-	lock_release(rwlock->rw_lock);	
+	spinlock_release(&rwlock->rw_spinlock);
+}
+
+bool
+rwlock_do_i_hold_write(struct rwlock *rwlock)
+{
+	KASSERT(rwlock != NULL);
 
-	return;
+	return rwlock->rw_writer == curthread;
 }
@@ -41,6 +41,7 @@
 #include <spl.h>
 #include <spinlock.h>
 #include <wchan.h>
+#include <sleepq.h>
 #include <thread.h>
 #include <threadlist.h>
 #include <threadprivate.h>
@@ -49,18 +50,33 @@
 #include <synch.h>
 #include <addrspace.h>
 #include <mainbus.h>
+#include <sysstat.h>
 #include <vnode.h>
 
 
 /* Magic number used as a guard value on kernel thread stacks. */
 #define THREAD_STACK_MAGIC 0xbaadf00d
 
-/* Wait channel. A wchan is protected by an associated, passed-in spinlock. */
+/*
+ * Wait channel. A wchan is protected by an associated, passed-in
+ * spinlock. Its sleepers are kept in the sleep queues, keyed on the
+ * wchan's address, so all it has to hold is the name.
+ */
 struct wchan {
 	const char *wc_name;		/* name for this channel */
-	struct threadlist wc_threads;	/* list of waiting threads */
 };
 
+/*
+ * Sleep queue hash bucket. The bucket lock protects the list and the
+ * t_sleepkey of every thread on it.
+ */
+struct sleepq {
+	struct spinlock sq_lock;
+	struct threadlist sq_threads;
+};
+
+static struct sleepq sleepq_table[SLEEPQ_HASHSIZE];
+
 /* Master array of CPUs. */
 DECLARRAY(cpu, static __UNUSED inline);
 DEFARRAY(cpu, static __UNUSED inline);
@@ -72,8 +88,8 @@ static struct semaphore *cpu_startup_sem;
 
 /* Used to synchronize exit cleanup. */
 unsigned thread_count = 0;
-static struct spinlock thread_count_lock = SPINLOCK_INITIALIZER;
-static struct wchan *thread_count_wchan;
+static struct spinlock thread_count_lock =
+	SPINLOCK_INITIALIZER_NAMED("thread_count_lock");
 
 ////////////////////////////////////////////////////////////
 
@@ -136,6 +152,7 @@ thread_create(const char *name)
 
 	strcpy(thread->t_name, name);
 	thread->t_wchan_name = "NEW";
+	thread->t_sleepkey = NULL;
 	thread->t_state = S_READY;
 
 	/* Thread subsystem fields */
@@ -145,6 +162,7 @@ thread_create(const char *name)
 	thread->t_context = NULL;
 	thread->t_cpu = NULL;
 	thread->t_proc = NULL;
+	thread->t_tid = 0;
 
 	/* Interrupt state fields */
 	thread->t_in_interrupt = false;
@@ -183,6 +201,7 @@ cpu_create(unsigned hardware_number)
 	threadlist_init(&c->c_zombies);
 	c->c_hardclocks = 0;
 	c->c_spinlocks = 0;
+	sysstat_cpuinit(c);
 
 	c->c_isidle = false;
 	threadlist_init(&c->c_runqueue);
@@ -254,6 +273,13 @@ cpu_create(unsigned hardware_number)
 	return c;
 }
 
+struct cpu *
+cpu_get(unsigned num)
+{
+	KASSERT(num < cpuarray_num(&allcpus));
+	return cpuarray_get(&allcpus, num);
+}
+
 /*
  * Destroy a thread.
  *
@@ -371,6 +397,7 @@ void
 thread_bootstrap(void)
 {
 	cpuarray_init(&allcpus);
+	sleepq_bootstrap();
 
 	/*
 	 * Create the cpu structure for the bootup CPU, the one we're
@@ -430,7 +457,6 @@ thread_start_cpus(void)
 	kprintf("cpu0: %s\n", buf);
 
 	cpu_startup_sem = sem_create("cpu_hatch", 0);
-	thread_count_wchan = wchan_create("thread_count");
 	mainbus_start_cpus();
 
 	num_cpus = cpuarray_num(&allcpus);
@@ -550,7 +576,7 @@ thread_fork(const char *name,
 
 	spinlock_acquire(&thread_count_lock);
 	++thread_count;
-	wchan_wakeall(thread_count_wchan, &thread_count_lock);
+	sleepq_wakeall(&thread_count, &thread_count_lock);
 	spinlock_release(&thread_count_lock);
 
 	/* Set up the switchframe so entrypoint() gets called */
@@ -568,13 +594,14 @@ thread_fork(const char *name,
  * The current thread is queued appropriately and its state is changed
  * to NEWSTATE; another thread to run is selected and switched to.
  *
- * If NEWSTATE is S_SLEEP, the thread is queued on the wait channel
- * WC, protected by the spinlock LK. Otherwise WC and Lk should be
- * NULL.
+ * If NEWSTATE is S_SLEEP, the thread is queued on the sleep queue
+ * bucket SQ, whose lock and the caller's spinlock LK are both held;
+ * both are released once the thread is on the list. Otherwise SQ and
+ * LK should be NULL.
  */
 static
 void
-thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
+thread_switch(threadstate_t newstate, struct sleepq *sq, struct spinlock *lk)
 {
 	struct thread *cur, *next;
 	int spl;
@@ -617,16 +644,15 @@ thread_switch(threadstate_t newstate, struct wchan *wc, struct spinlock *lk)
 		thread_make_runnable(cur, true /*have lock*/);
 		break;
 	    case S_SLEEP:
-		cur->t_wchan_name = wc->wc_name;
 		/*
-		 * Add the thread to the list in the wait channel, and
-		 * unlock same. To avoid a race with someone else
-		 * calling wchan_wake*, we must keep the wchan's
-		 * associated spinlock locked from the point the
-		 * caller of wchan_sleep locked it until the thread is
-		 * on the list.
+		 * Add the thread to the bucket's list, and unlock
+		 * same. To avoid a race with someone else calling
+		 * sleepq_wake*, we must keep the caller's spinlock
+		 * locked from the point the caller of sleepq_sleep
+		 * locked it until the thread is on the list.
 		 */
-		threadlist_addtail(&wc->wc_threads, cur);
+		threadlist_addtail(&sq->sq_threads, cur);
+		spinlock_release(&sq->sq_lock);
 		spinlock_release(lk);
 		break;
 	    case S_ZOMBIE:
@@ -805,10 +831,11 @@ thread_exit(void)
 	cur = curthread;
 
 	/*
-	 * Detach from our process. You might need to move this action
-	 * around, depending on how your wait/exit works.
+	 * Detach from our process, unless proc_exit already has.
 	 */
-	proc_remthread(cur);
+	if (cur->t_proc != NULL) {
+		proc_remthread(cur);
+	}
 
 	/* Make sure we *are* detached (move this only if you're sure!) */
 	KASSERT(cur->t_proc == NULL);
@@ -820,7 +847,7 @@ thread_exit(void)
 	if (thread_count) {
 		spinlock_acquire(&thread_count_lock);
 		--thread_count;
-		wchan_wakeall(thread_count_wchan, &thread_count_lock);
+		sleepq_wakeall(&thread_count, &thread_count_lock);
 		spinlock_release(&thread_count_lock);
 	}
 
@@ -982,53 +1009,48 @@ thread_consider_migration(void)
 ////////////////////////////////////////////////////////////
 
 /*
- * Wait channel functions
+ * Sleep queue and wait channel functions
  */
 
 /*
- * Create a wait channel. NAME is a symbolic string name for it.
- * This is what's displayed by ps -alx in Unix.
+ * Sleep queues.
  *
- * NAME should generally be a string constant. If it isn't, alternate
- * arrangements should be made to free it after the wait channel is
- * destroyed.
+ * Every sleeping thread is on the list of the bucket its key hashes
+ * to. Keys are addresses, so drop the low bits (which are mostly
+ * alignment) and mix the rest with a multiplicative hash.
  */
-struct wchan *
-wchan_create(const char *name)
+void
+sleepq_bootstrap(void)
 {
-	struct wchan *wc;
+	unsigned i;
 
-	wc = kmalloc(sizeof(*wc));
-	if (wc == NULL) {
-		return NULL;
+	for (i=0; i<SLEEPQ_HASHSIZE; i++) {
+		spinlock_init(&sleepq_table[i].sq_lock);
+		threadlist_init(&sleepq_table[i].sq_threads);
 	}
-	threadlist_init(&wc->wc_threads);
-	wc->wc_name = name;
-
-	return wc;
 }
 
-/*
- * Destroy a wait channel. Must be empty and unlocked.
- * (The corresponding cleanup functions require this.)
- */
-void
-wchan_destroy(struct wchan *wc)
+static
+struct sleepq *
+sleepq_hash(const void *key)
 {
-	threadlist_cleanup(&wc->wc_threads);
-	kfree(wc);
+	uint32_t h;
+
+	h = ((uint32_t)(uintptr_t)key >> 2) * 2654435761U;
+	return &sleepq_table[(h >> 16) & (SLEEPQ_HASHSIZE - 1)];
 }
 
 /*
- * Yield the cpu to another process, and go to sleep, on the specified
- * wait channel WC, whose associated spinlock is LK. Calling wakeup on
- * the channel will make the thread runnable again. The spinlock must
- * be locked. The call to thread_switch unlocks it; we relock it
- * before returning.
+ * Yield the cpu to another process, and go to sleep on KEY. Waking
+ * KEY will make the thread runnable again. The spinlock LK must be
+ * locked. The call to thread_switch unlocks it; we relock it before
+ * returning.
  */
 void
-wchan_sleep(struct wchan *wc, struct spinlock *lk)
+sleepq_sleep(const void *key, const char *name, struct spinlock *lk)
 {
+	struct sleepq *sq;
+
 	/* may not sleep in an interrupt handler */
 	KASSERT(!curthread->t_in_interrupt);
 
@@ -1038,22 +1060,42 @@ wchan_sleep(struct wchan *wc, struct spinlock *lk)
 	/* must not hold other spinlocks */
 	KASSERT(curcpu->c_spinlocks == 1);
 
-	thread_switch(S_SLEEP, wc, lk);
+	sq = sleepq_hash(key);
+	spinlock_acquire(&sq->sq_lock);
+	curthread->t_sleepkey = key;
+	curthread->t_wchan_name = name;
+
+	thread_switch(S_SLEEP, sq, lk);
 	spinlock_acquire(lk);
 }
 
 /*
- * Wake up one thread sleeping on a wait channel.
+ * Wake up the first thread sleeping on KEY. Other keys may share the
+ * bucket, so look for a match rather than taking the head.
  */
 void
-wchan_wakeone(struct wchan *wc, struct spinlock *lk)
+sleepq_wakeone(const void *key, struct spinlock *lk)
 {
-	struct thread *target;
+	struct sleepq *sq;
+	struct thread *target, *t;
 
 	KASSERT(spinlock_do_i_hold(lk));
 
-	/* Grab a thread from the channel */
-	target = threadlist_remhead(&wc->wc_threads);
+	sq = sleepq_hash(key);
+	target = NULL;
+
+	spinlock_acquire(&sq->sq_lock);
+	THREADLIST_FORALL(t, sq->sq_threads) {
+		if (t->t_sleepkey == key) {
+			target = t;
+			break;
+		}
+	}
+	if (target != NULL) {
+		threadlist_remove(&sq->sq_threads, target);
+		target->t_sleepkey = NULL;
+	}
+	spinlock_release(&sq->sq_lock);
 
 	if (target == NULL) {
 		/* Nobody was sleeping. */
@@ -1062,35 +1104,45 @@ wchan_wakeone(struct wchan *wc, struct spinlock *lk)
 
 	/*
 	 * Note that thread_make_runnable acquires a runqueue lock
-	 * while we're holding LK. This is ok; all spinlocks
-	 * associated with wchans must come before the runqueue locks,
-	 * as we also bridge from the wchan lock to the runqueue lock
-	 * in thread_switch.
+	 * while we're holding LK. This is ok; all spinlocks passed
+	 * to sleepq_sleep must come before the runqueue locks, as we
+	 * also bridge from LK to the runqueue lock in thread_switch.
 	 */
 
 	thread_make_runnable(target, false);
 }
 
 /*
- * Wake up all threads sleeping on a wait channel.
+ * Wake up all threads sleeping on KEY. Only KEY's bucket is scanned.
  */
 void
-wchan_wakeall(struct wchan *wc, struct spinlock *lk)
+sleepq_wakeall(const void *key, struct spinlock *lk)
 {
-	struct thread *target;
+	struct sleepq *sq;
+	struct thread *target, *t, *next;
 	struct threadlist list;
 
 	KASSERT(spinlock_do_i_hold(lk));
 
+	sq = sleepq_hash(key);
 	threadlist_init(&list);
 
 	/*
-	 * Grab all the threads from the channel, moving them to a
-	 * private list.
+	 * Move the matching threads to a private list, so the bucket
+	 * lock isn't held while we poke the run queues.
 	 */
-	while ((target = threadlist_remhead(&wc->wc_threads)) != NULL) {
-		threadlist_addtail(&list, target);
+	spinlock_acquire(&sq->sq_lock);
+	t = sq->sq_threads.tl_head.tln_next->tln_self;
+	while (t != NULL) {
+		next = t->t_listnode.tln_next->tln_self;
+		if (t->t_sleepkey == key) {
+			threadlist_remove(&sq->sq_threads, t);
+			t->t_sleepkey = NULL;
+			threadlist_addtail(&list, t);
+		}
+		t = next;
 	}
+	spinlock_release(&sq->sq_lock);
 
 	/*
 	 * We could conceivably sort by cpu first to cause fewer lock
@@ -1105,20 +1157,102 @@ wchan_wakeall(struct wchan *wc, struct spinlock *lk)
 }
 
 /*
- * Return nonzero if there are no threads sleeping on the channel.
+ * Return true if no threads are sleeping on KEY.
  * This is meant to be used only for diagnostic purposes.
  */
 bool
-wchan_isempty(struct wchan *wc, struct spinlock *lk)
+sleepq_isempty(const void *key, struct spinlock *lk)
 {
+	struct sleepq *sq;
+	struct thread *t;
 	bool ret;
 
 	KASSERT(spinlock_do_i_hold(lk));
-	ret = threadlist_isempty(&wc->wc_threads);
+
+	sq = sleepq_hash(key);
+	ret = true;
+
+	spinlock_acquire(&sq->sq_lock);
+	THREADLIST_FORALL(t, sq->sq_threads) {
+		if (t->t_sleepkey == key) {
+			ret = false;
+			break;
+		}
+	}
+	spinlock_release(&sq->sq_lock);
 
 	return ret;
 }
 
+/*
+ * Create a wait channel. NAME is a symbolic string name for it.
+ * This is what's displayed by ps -alx in Unix.
+ *
+ * NAME should generally be a string constant. If it isn't, alternate
+ * arrangements should be made to free it after the wait channel is
+ * destroyed.
+ */
+struct wchan *
+wchan_create(const char *name)
+{
+	struct wchan *wc;
+
+	wc = kmalloc(sizeof(*wc));
+	if (wc == NULL) {
+		return NULL;
+	}
+	wc->wc_name = name;
+
+	return wc;
+}
+
+/*
+ * Destroy a wait channel. Must be empty and unlocked.
+ */
+void
+wchan_destroy(struct wchan *wc)
+{
+	struct sleepq *sq;
+	struct thread *t;
+
+	sq = sleepq_hash(wc);
+	spinlock_acquire(&sq->sq_lock);
+	THREADLIST_FORALL(t, sq->sq_threads) {
+		KASSERT(t->t_sleepkey != wc);
+	}
+	spinlock_release(&sq->sq_lock);
+
+	kfree(wc);
+}
+
+/*
+ * Wait channel operations. These are just the sleep queue operations
+ * with the wchan itself as the key.
+ */
+void
+wchan_sleep(struct wchan *wc, struct spinlock *lk)
+{
+	sleepq_sleep(wc, wc->wc_name, lk);
+}
+
+void
+wchan_wakeone(struct wchan *wc, struct spinlock *lk)
+{
+	sleepq_wakeone(wc, lk);
+}
+
+void
+wchan_wakeall(struct wchan *wc, struct spinlock *lk)
+{
+	sleepq_wakeall(wc, lk);
+}
+
+bool
+wchan_isempty(struct wchan *wc, struct spinlock *lk)
+{
+	return sleepq_isempty(wc, lk);
+}
+
 ////////////////////////////////////////////////////////////
 
 /*
@@ -1229,7 +1363,8 @@ void thread_wait_for_count(unsigned tc)
 {
 	spinlock_acquire(&thread_count_lock);
 	while (thread_count != tc) {
-		wchan_sleep(thread_count_wchan, &thread_count_lock);
+		sleepq_sleep(&thread_count, "thread_count",
+			     &thread_count_lock);
 	}
 	spinlock_release(&thread_count_lock);
 }
@@ -0,0 +1,413 @@
+/*
+ * Asynchronous block I/O. See bio.h.
+ *
+ * bio_lock covers the request queue, the elevator position, and the
+ * counters; bio_cv wakes the bio threads when requests are queued.
+ * The bio threads take requests off the queue in C-SCAN order (the
+ * first one at or past where the last transfer ended, wrapping to
+ * the start) and do each one, merged chain and all, as a single
+ * DEVOP_IO with one iovec per request.
+ *
+ * bio_rw's waiters sleep on bio_waitcv, a separate lock and cv, since
+ * completions are delivered without bio_lock held.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <thread.h>
+#include <uio.h>
+#include <device.h>
+#include <bio.h>
+
+/* Number of times to retry a transfer that gets an I/O error */
+#define BIO_IORETRIES	10
+
+static struct lock *bio_lock;
+static struct cv *bio_cv;
+static struct bio *bio_queue;		/* sorted by device, block */
+static struct device *bio_lastdev;	/* elevator position */
+static daddr_t bio_lastblock;
+
+static struct lock *bio_waitlock;
+static struct cv *bio_waitcv;
+
+static struct {
+	unsigned bs_requests;		/* requests submitted */
+	unsigned bs_merges;		/* merged into another request */
+	unsigned bs_transfers;		/* DEVOP_IO calls */
+	unsigned bs_blocks;		/* blocks transferred */
+	unsigned bs_retries;		/* transfers retried after EIO */
+	unsigned bs_errors;		/* transfers that failed */
+} bio_stats;
+
+////////////////////////////////////////////////////////////
+// Sorting and merging
+
+/*
+ * Order requests by device, then block.
+ */
+static
+bool
+bio_before(struct bio *a, struct bio *b)
+{
+	if (a->bio_dev != b->bio_dev) {
+		return (uintptr_t)a->bio_dev < (uintptr_t)b->bio_dev;
+	}
+	return a->bio_block < b->bio_block;
+}
+
+/*
+ * If B (and its merged chain) picks up where A's ends, append it to
+ * A's chain. B's bio_next is the caller's problem.
+ */
+static
+bool
+bio_trymerge(struct bio *a, struct bio *b)
+{
+	struct bio *tail;
+
+	if (a->bio_dev != b->bio_dev || a->bio_rw != b->bio_rw ||
+	    a->bio_block + a->bio_mergeblocks != b->bio_block ||
+	    a->bio_mergecount + b->bio_mergecount > BIO_MAXMERGE) {
+		return false;
+	}
+
+	for (tail = a; tail->bio_merged != NULL; tail = tail->bio_merged) {
+		/* nothing */
+	}
+	tail->bio_merged = b;
+	a->bio_mergecount += b->bio_mergecount;
+	a->bio_mergeblocks += b->bio_mergeblocks;
+	return true;
+}
+
+/*
+ * Put BIO (and its merged chain) on the sorted list *LISTP, merging
+ * it with its neighbours if possible. Returns the number of requests
+ * merged away.
+ */
+static
+unsigned
+bio_insert(struct bio **listp, struct bio *bio)
+{
+	struct bio **pp, *prev, *next;
+
+	prev = NULL;
+	pp = listp;
+	while (*pp != NULL && !bio_before(bio, *pp)) {
+		prev = *pp;
+		pp = &(*pp)->bio_next;
+	}
+	next = *pp;
+
+	if (prev != NULL && bio_trymerge(prev, bio)) {
+		/* It may now close the gap to the next one too. */
+		if (next != NULL && bio_trymerge(prev, next)) {
+			prev->bio_next = next->bio_next;
+			return 2;
+		}
+		return 1;
+	}
+	if (next != NULL && bio_trymerge(bio, next)) {
+		bio->bio_next = next->bio_next;
+		*pp = bio;
+		return 1;
+	}
+	bio->bio_next = next;
+	*pp = bio;
+	return 0;
+}
+
+static
+void
+bio_init(struct bio *bio)
+{
+	KASSERT(bio->bio_nblocks > 0);
+	KASSERT(bio->bio_done != NULL);
+
+	bio->bio_error = 0;
+	bio->bio_next = NULL;
+	bio->bio_merged = NULL;
+	bio->bio_mergecount = 1;
+	bio->bio_mergeblocks = bio->bio_nblocks;
+}
+
+////////////////////////////////////////////////////////////
+// Submitting requests
+
+void
+bio_submit(struct bio *bio)
+{
+	bio_init(bio);
+
+	lock_acquire(bio_lock);
+	bio_stats.bs_requests++;
+	bio_stats.bs_merges += bio_insert(&bio_queue, bio);
+	cv_signal(bio_cv, bio_lock);
+	lock_release(bio_lock);
+}
+
+void
+bio_plug(struct bioplug *plug)
+{
+	plug->bp_list = NULL;
+}
+
+void
+bio_plugsubmit(struct bioplug *plug, struct bio *bio)
+{
+	unsigned merges;
+
+	bio_init(bio);
+	merges = bio_insert(&plug->bp_list, bio);
+
+	lock_acquire(bio_lock);
+	bio_stats.bs_requests++;
+	bio_stats.bs_merges += merges;
+	lock_release(bio_lock);
+}
+
+void
+bio_unplug(struct bioplug *plug)
+{
+	struct bio *bio, *next;
+
+	if (plug->bp_list == NULL) {
+		return;
+	}
+
+	lock_acquire(bio_lock);
+	for (bio = plug->bp_list; bio != NULL; bio = next) {
+		next = bio->bio_next;
+		bio->bio_next = NULL;
+		bio_stats.bs_merges += bio_insert(&bio_queue, bio);
+	}
+	cv_broadcast(bio_cv, bio_lock);
+	lock_release(bio_lock);
+
+	plug->bp_list = NULL;
+}
+
+////////////////////////////////////////////////////////////
+// The bio threads
+
+/*
+ * Take the next request off the queue, elevator style. Call with
+ * bio_lock held and the queue not empty.
+ */
+static
+struct bio *
+bio_dequeue(void)
+{
+	struct bio **pp, *bio;
+
+	pp = &bio_queue;
+	while (*pp != NULL &&
+	       ((uintptr_t)(*pp)->bio_dev < (uintptr_t)bio_lastdev ||
+		((*pp)->bio_dev == bio_lastdev &&
+		 (*pp)->bio_block < bio_lastblock))) {
+		pp = &(*pp)->bio_next;
+	}
+	if (*pp == NULL) {
+		pp = &bio_queue;
+	}
+
+	bio = *pp;
+	*pp = bio->bio_next;
+	bio->bio_next = NULL;
+
+	bio_lastdev = bio->bio_dev;
+	bio_lastblock = bio->bio_block + bio->bio_mergeblocks;
+	return bio;
+}
+
+/*
+ * Do the transfer for BIO and everything merged into it, then call
+ * their completion functions. Call without bio_lock.
+ */
+static
+void
+bio_start(struct bio *bio)
+{
+	struct iovec iov[BIO_MAXMERGE];
+	struct uio ku;
+	struct bio *b, *next;
+	blksize_t blocksize;
+	unsigned i, tries;
+	int result;
+
+	blocksize = bio->bio_dev->d_blocksize;
+
+	for (tries = 0; ; tries++) {
+		ku.uio_resid = 0;
+		for (i = 0, b = bio; b != NULL; i++, b = b->bio_merged) {
+			KASSERT(i < BIO_MAXMERGE);
+			iov[i].iov_kbase = b->bio_data;
+			iov[i].iov_len = b->bio_nblocks * blocksize;
+			ku.uio_resid += iov[i].iov_len;
+		}
+		ku.uio_iov = iov;
+		ku.uio_iovcnt = i;
+		ku.uio_offset = (off_t)bio->bio_block * blocksize;
+		ku.uio_segflg = UIO_SYSSPACE;
+		ku.uio_rw = bio->bio_rw;
+		ku.uio_space = NULL;
+
+		DEBUG(DB_VFS, "bio: %s %u+%u\n",
+		      bio->bio_rw == UIO_READ ? "read" : "write",
+		      bio->bio_block, bio->bio_mergeblocks);
+
+		result = DEVOP_IO(bio->bio_dev, &ku);
+		if (result != EIO || tries == BIO_IORETRIES) {
+			break;
+		}
+		if (tries == 0) {
+			kprintf("bio: blocks %u+%u I/O error, retrying\n",
+				bio->bio_block, bio->bio_mergeblocks);
+		}
+	}
+	if (result == EIO) {
+		kprintf("bio: blocks %u+%u I/O error, giving up after %u "
+			"retries\n", bio->bio_block, bio->bio_mergeblocks,
+			tries);
+	}
+
+	lock_acquire(bio_lock);
+	bio_stats.bs_transfers++;
+	bio_stats.bs_blocks += bio->bio_mergeblocks;
+	bio_stats.bs_retries += tries;
+	if (result) {
+		bio_stats.bs_errors++;
+	}
+	lock_release(bio_lock);
+
+	/* The callback may reuse the bio, so get the next one first. */
+	for (b = bio; b != NULL; b = next) {
+		next = b->bio_merged;
+		b->bio_merged = NULL;
+		b->bio_error = result;
+		b->bio_done(b);
+	}
+}
+
+static
+void
+bio_thread(void *unused1, unsigned long unused2)
+{
+	struct bio *bio;
+
+	(void)unused1;
+	(void)unused2;
+
+	lock_acquire(bio_lock);
+	while (1) {
+		while (bio_queue == NULL) {
+			cv_wait(bio_cv, bio_lock);
+		}
+		bio = bio_dequeue();
+		lock_release(bio_lock);
+		bio_start(bio);
+		lock_acquire(bio_lock);
+	}
+}
+
+void
+bio_bootstrap(void)
+{
+	unsigned i;
+	int result;
+
+	bio_lock = lock_create("bio_lock");
+	if (bio_lock == NULL) {
+		panic("bio_bootstrap: Out of memory\n");
+	}
+	bio_cv = cv_create("bio_cv");
+	if (bio_cv == NULL) {
+		panic("bio_bootstrap: Out of memory\n");
+	}
+	bio_waitlock = lock_create("bio_waitlock");
+	if (bio_waitlock == NULL) {
+		panic("bio_bootstrap: Out of memory\n");
+	}
+	bio_waitcv = cv_create("bio_waitcv");
+	if (bio_waitcv == NULL) {
+		panic("bio_bootstrap: Out of memory\n");
+	}
+
+	for (i=0; i<BIO_NTHREADS; i++) {
+		result = thread_fork("bio", NULL, bio_thread, NULL, i);
+		if (result) {
+			panic("bio_bootstrap: thread_fork: %s\n",
+			      strerror(result));
+		}
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Synchronous I/O
+
+static
+void
+bio_syncdone(struct bio *bio)
+{
+	lock_acquire(bio_waitlock);
+	bio->bio_arg = NULL;
+	cv_broadcast(bio_waitcv, bio_waitlock);
+	lock_release(bio_waitlock);
+}
+
+int
+bio_rw(struct device *dev, daddr_t block, unsigned nblocks, void *data,
+       enum uio_rw rw)
+{
+	struct bio bio;
+
+	bio.bio_dev = dev;
+	bio.bio_block = block;
+	bio.bio_nblocks = nblocks;
+	bio.bio_data = data;
+	bio.bio_rw = rw;
+	bio.bio_done = bio_syncdone;
+	/* Non-null until done. */
+	bio.bio_arg = &bio;
+
+	bio_submit(&bio);
+
+	lock_acquire(bio_waitlock);
+	while (bio.bio_arg != NULL) {
+		cv_wait(bio_waitcv, bio_waitlock);
+	}
+	lock_release(bio_waitlock);
+
+	return bio.bio_error;
+}
+
+////////////////////////////////////////////////////////////
+// Statistics
+
+void
+bio_printstats(void)
+{
+	lock_acquire(bio_lock);
+	kprintf("Block I/O: %u requests, %u merged, %u transfers "
+		"(%u blocks)\n", bio_stats.bs_requests, bio_stats.bs_merges,
+		bio_stats.bs_transfers, bio_stats.bs_blocks);
+	kprintf("    %u retries, %u failed transfers\n",
+		bio_stats.bs_retries, bio_stats.bs_errors);
+	lock_release(bio_lock);
+}
+
+void
+bio_resetstats(void)
+{
+	lock_acquire(bio_lock);
+	bio_stats.bs_requests = 0;
+	bio_stats.bs_merges = 0;
+	bio_stats.bs_transfers = 0;
+	bio_stats.bs_blocks = 0;
+	bio_stats.bs_retries = 0;
+	bio_stats.bs_errors = 0;
+	lock_release(bio_lock);
+}
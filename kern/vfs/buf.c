@@ -0,0 +1,865 @@
+/*
+ * Buffer cache. See buf.h.
+ *
+ * One sleep lock, buf_lock, covers the hash table, the LRU list, the
+ * counters, and every buffer's key and flags; buf_cv is broadcast
+ * whenever a buffer stops being busy. Disk I/O is done with buf_lock
+ * released and the buffer marked busy, so nobody else touches it
+ * meanwhile. The busy owner may change b_data and call buf_markdirty
+ * without the lock.
+ *
+ * Single blocks are read and written with the bio layer's synchronous
+ * bio_rw. buf_flush and the flusher thread instead make the dirty
+ * buffers busy, submit them all to the bio layer as one plugged
+ * batch, and wait for the batch; the completions (in bio threads)
+ * update the buffers.
+ *
+ * Each time a buffer goes from clean to dirty it is stamped with the
+ * next value of buf_dirtygen. buf_flush only writes (and waits for)
+ * buffers stamped no later than when it started, so buffers dirtied
+ * again behind it can't keep it going forever.
+ *
+ * Buffers are allocated as they're needed, up to buf_max, and are
+ * only freed again if buf_max is lowered or their device goes away.
+ */
+
+#include <types.h>
+#include <kern/errno.h>
+#include <lib.h>
+#include <synch.h>
+#include <clock.h>
+#include <thread.h>
+#include <uio.h>
+#include <device.h>
+#include <bio.h>
+#include <buf.h>
+
+/*
+ * A set of buffers whose I/O was submitted together. Lives on the
+ * stack of the thread waiting for it.
+ */
+struct buf_batch {
+	unsigned bb_pending;		/* I/Os not yet done */
+	int bb_error;			/* first error, if any */
+};
+
+static struct lock *buf_lock;
+static struct cv *buf_cv;
+static struct buf *buf_table[BUF_HASHSIZE];
+static struct buf *buf_lruhead;		/* least recently used */
+static struct buf *buf_lrutail;		/* most recently used */
+static unsigned buf_count;		/* buffers allocated */
+static unsigned buf_max;		/* most we'll allocate */
+static unsigned buf_dirtygen;		/* bumped when a buffer gets dirty */
+static bool buf_pressure;		/* had to evict a dirty buffer */
+
+static struct {
+	unsigned bs_hits;		/* block was in the cache */
+	unsigned bs_misses;		/* block wasn't */
+	unsigned bs_reads;		/* disk reads */
+	unsigned bs_writes;		/* disk writes */
+	unsigned bs_evictions;		/* buffers reused for another block */
+	unsigned bs_rablocks;		/* blocks read ahead */
+	unsigned bs_rahits;		/* ...that were then asked for */
+	unsigned bs_flushruns;		/* flusher runs that wrote anything */
+	unsigned bs_flushwrites;	/* buffers the flusher wrote */
+} buf_stats;
+
+static void buf_flusher(void *, unsigned long);
+
+void
+buf_bootstrap(void)
+{
+	int result;
+
+	buf_lock = lock_create("buf_lock");
+	if (buf_lock == NULL) {
+		panic("buf_bootstrap: Out of memory\n");
+	}
+	buf_cv = cv_create("buf_cv");
+	if (buf_cv == NULL) {
+		panic("buf_bootstrap: Out of memory\n");
+	}
+	buf_max = BUF_DEFAULTMAX;
+
+	result = thread_fork("bufflush", NULL, buf_flusher, NULL, 0);
+	if (result) {
+		panic("buf_bootstrap: thread_fork: %s\n", strerror(result));
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Hash table and LRU list. Call with buf_lock held.
+
+static
+struct buf **
+buf_bucket(struct device *dev, daddr_t block)
+{
+	uint32_t h;
+
+	h = block * 2654435761U;
+	h ^= (uint32_t)(uintptr_t)dev >> 4;
+	return &buf_table[(h >> 16) & (BUF_HASHSIZE - 1)];
+}
+
+static
+struct buf *
+buf_find(struct device *dev, daddr_t block)
+{
+	struct buf *b;
+
+	for (b = *buf_bucket(dev, block); b != NULL; b = b->b_hashnext) {
+		if (b->b_dev == dev && b->b_block == block) {
+			return b;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+buf_hashadd(struct buf *b)
+{
+	struct buf **bucket;
+
+	bucket = buf_bucket(b->b_dev, b->b_block);
+	b->b_hashnext = *bucket;
+	*bucket = b;
+}
+
+static
+void
+buf_hashremove(struct buf *b)
+{
+	struct buf **pp;
+
+	pp = buf_bucket(b->b_dev, b->b_block);
+	while (*pp != b) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->b_hashnext;
+	}
+	*pp = b->b_hashnext;
+	b->b_hashnext = NULL;
+}
+
+static
+void
+buf_lruadd(struct buf *b)
+{
+	b->b_lrunext = NULL;
+	b->b_lruprev = buf_lrutail;
+	if (buf_lrutail != NULL) {
+		buf_lrutail->b_lrunext = b;
+	}
+	else {
+		buf_lruhead = b;
+	}
+	buf_lrutail = b;
+}
+
+static
+void
+buf_lruremove(struct buf *b)
+{
+	if (b->b_lruprev != NULL) {
+		b->b_lruprev->b_lrunext = b->b_lrunext;
+	}
+	else {
+		KASSERT(buf_lruhead == b);
+		buf_lruhead = b->b_lrunext;
+	}
+	if (b->b_lrunext != NULL) {
+		b->b_lrunext->b_lruprev = b->b_lruprev;
+	}
+	else {
+		KASSERT(buf_lrutail == b);
+		buf_lrutail = b->b_lruprev;
+	}
+	b->b_lruprev = b->b_lrunext = NULL;
+}
+
+////////////////////////////////////////////////////////////
+// Buffer lifecycle. Call with buf_lock held.
+
+static
+struct buf *
+buf_create(void)
+{
+	struct buf *b;
+
+	b = kmalloc(sizeof(*b));
+	if (b == NULL) {
+		return NULL;
+	}
+	b->b_data = kmalloc(BUF_BLOCKSIZE);
+	if (b->b_data == NULL) {
+		kfree(b);
+		return NULL;
+	}
+	b->b_dev = NULL;
+	b->b_block = 0;
+	b->b_valid = false;
+	b->b_dirty = false;
+	b->b_busy = false;
+	b->b_readahead = false;
+	b->b_dirtytime = 0;
+	b->b_dirtygen = 0;
+	b->b_hashnext = NULL;
+	b->b_lruprev = b->b_lrunext = NULL;
+	b->b_batch = NULL;
+	buf_count++;
+	return b;
+}
+
+/*
+ * Free a clean buffer that's busy (so not on the LRU list) and in
+ * the hash table.
+ */
+static
+void
+buf_destroy(struct buf *b)
+{
+	KASSERT(b->b_busy);
+	KASSERT(!b->b_dirty);
+	buf_hashremove(b);
+	kfree(b->b_data);
+	kfree(b);
+	buf_count--;
+}
+
+/*
+ * A buffer is no longer busy: put it on the LRU list, or free it if
+ * the cache is over its size limit, and wake anyone waiting for it.
+ */
+static
+void
+buf_unbusy(struct buf *b)
+{
+	KASSERT(b->b_busy);
+	if (buf_count > buf_max && !b->b_dirty) {
+		buf_destroy(b);
+	}
+	else {
+		b->b_busy = false;
+		buf_lruadd(b);
+	}
+	cv_broadcast(buf_cv, buf_lock);
+}
+
+////////////////////////////////////////////////////////////
+// Disk I/O
+
+/*
+ * Read or write a buffer's block. Call with the buffer busy and
+ * buf_lock not held.
+ */
+static
+int
+buf_devio(struct buf *b, enum uio_rw rw)
+{
+	int result;
+
+	KASSERT(b->b_busy);
+	KASSERT(!lock_do_i_hold(buf_lock));
+	KASSERT(b->b_dev->d_blocksize == BUF_BLOCKSIZE);
+
+	DEBUG(DB_VFS, "buf: %s %u\n", rw == UIO_READ ? "read" : "write",
+	      b->b_block);
+
+	result = bio_rw(b->b_dev, b->b_block, 1, b->b_data, rw);
+	if (result == EINVAL) {
+		/*
+		 * The block was out of range, or something else that
+		 * is the caller's fault.
+		 */
+		panic("buf: block %u: DEVOP_IO returned EINVAL\n",
+		      b->b_block);
+	}
+	return result;
+}
+
+/*
+ * Completion for a write submitted as part of a batch: update the
+ * buffer, give it back, and count the batch down.
+ */
+static
+void
+buf_writedone(struct bio *bio)
+{
+	struct buf *b = bio->bio_arg;
+	struct buf_batch *bb = b->b_batch;
+
+	lock_acquire(buf_lock);
+	if (bio->bio_error == 0) {
+		b->b_dirty = false;
+	}
+	else if (bb->bb_error == 0) {
+		bb->bb_error = bio->bio_error;
+	}
+	b->b_batch = NULL;
+	KASSERT(bb->bb_pending > 0);
+	bb->bb_pending--;
+	/* This broadcasts buf_cv, which wakes the batch's owner. */
+	buf_unbusy(b);
+	lock_release(buf_lock);
+}
+
+/*
+ * Submit a write of a dirty buffer the caller has made busy, as part
+ * of batch BB. Call with buf_lock held.
+ */
+static
+void
+buf_writeasync(struct buf *b, struct buf_batch *bb, struct bioplug *plug)
+{
+	KASSERT(b->b_busy);
+	KASSERT(b->b_dirty && b->b_valid);
+	KASSERT(b->b_dev->d_blocksize == BUF_BLOCKSIZE);
+
+	buf_stats.bs_writes++;
+	b->b_batch = bb;
+	bb->bb_pending++;
+
+	b->b_bio.bio_dev = b->b_dev;
+	b->b_bio.bio_block = b->b_block;
+	b->b_bio.bio_nblocks = 1;
+	b->b_bio.bio_data = b->b_data;
+	b->b_bio.bio_rw = UIO_WRITE;
+	b->b_bio.bio_done = buf_writedone;
+	b->b_bio.bio_arg = b;
+	bio_plugsubmit(plug, &b->b_bio);
+}
+
+/*
+ * Write out a dirty buffer that the caller has made busy. Called and
+ * returns with buf_lock held, but drops it for the I/O.
+ */
+static
+int
+buf_writeout(struct buf *b)
+{
+	int result;
+
+	KASSERT(b->b_busy);
+	KASSERT(b->b_dirty && b->b_valid);
+
+	buf_stats.bs_writes++;
+	lock_release(buf_lock);
+	result = buf_devio(b, UIO_WRITE);
+	lock_acquire(buf_lock);
+	if (result == 0) {
+		b->b_dirty = false;
+	}
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// Getting and releasing buffers
+
+/*
+ * Find or set up the buffer for DEV/BLOCK and make it busy. Called
+ * and returns with buf_lock held.
+ */
+static
+int
+buf_getbusy(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	KASSERT(dev != NULL);
+
+	while (1) {
+		b = buf_find(dev, block);
+		if (b != NULL) {
+			if (b->b_busy) {
+				cv_wait(buf_cv, buf_lock);
+				continue;
+			}
+			buf_lruremove(b);
+			b->b_busy = true;
+			*ret = b;
+			return 0;
+		}
+
+		/* Not cached. Grow the cache, or reuse the LRU buffer. */
+		b = NULL;
+		if (buf_count < buf_max) {
+			b = buf_create();
+		}
+		if (b == NULL) {
+			b = buf_lruhead;
+			if (b == NULL) {
+				if (buf_count == 0) {
+					return ENOMEM;
+				}
+				/* Everything is busy; wait for one. */
+				cv_wait(buf_cv, buf_lock);
+				continue;
+			}
+			buf_lruremove(b);
+			b->b_busy = true;
+			if (b->b_dirty) {
+				/* Get the flusher to clean up. */
+				buf_pressure = true;
+				result = buf_writeout(b);
+				if (result) {
+					buf_unbusy(b);
+					return result;
+				}
+				if (buf_find(dev, block) != NULL) {
+					/* Someone loaded it meanwhile. */
+					buf_unbusy(b);
+					continue;
+				}
+			}
+			buf_hashremove(b);
+			buf_stats.bs_evictions++;
+		}
+
+		b->b_dev = dev;
+		b->b_block = block;
+		b->b_valid = false;
+		b->b_dirty = false;
+		b->b_busy = true;
+		b->b_readahead = false;
+		buf_hashadd(b);
+		*ret = b;
+		return 0;
+	}
+}
+
+int
+buf_read(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	lock_acquire(buf_lock);
+	result = buf_getbusy(dev, block, &b);
+	if (result) {
+		lock_release(buf_lock);
+		return result;
+	}
+
+	if (b->b_valid) {
+		buf_stats.bs_hits++;
+		if (b->b_readahead) {
+			buf_stats.bs_rahits++;
+		}
+	}
+	else {
+		buf_stats.bs_misses++;
+		buf_stats.bs_reads++;
+		lock_release(buf_lock);
+		result = buf_devio(b, UIO_READ);
+		lock_acquire(buf_lock);
+		if (result) {
+			buf_unbusy(b);
+			lock_release(buf_lock);
+			return result;
+		}
+		b->b_valid = true;
+	}
+	b->b_readahead = false;
+	lock_release(buf_lock);
+
+	*ret = b;
+	return 0;
+}
+
+int
+buf_get(struct device *dev, daddr_t block, struct buf **ret)
+{
+	struct buf *b;
+	int result;
+
+	lock_acquire(buf_lock);
+	result = buf_getbusy(dev, block, &b);
+	if (result) {
+		lock_release(buf_lock);
+		return result;
+	}
+	if (b->b_valid) {
+		buf_stats.bs_hits++;
+		if (b->b_readahead) {
+			buf_stats.bs_rahits++;
+		}
+	}
+	else {
+		buf_stats.bs_misses++;
+	}
+	b->b_readahead = false;
+	lock_release(buf_lock);
+
+	*ret = b;
+	return 0;
+}
+
+/*
+ * Completion for a readahead.
+ */
+static
+void
+buf_readdone(struct bio *bio)
+{
+	struct buf *b = bio->bio_arg;
+
+	lock_acquire(buf_lock);
+	if (bio->bio_error == 0) {
+		b->b_valid = true;
+	}
+	/* If it failed, the buffer stays invalid and buf_read retries. */
+	buf_unbusy(b);
+	lock_release(buf_lock);
+}
+
+void
+buf_readahead(struct device *dev, daddr_t block, struct bioplug *plug)
+{
+	struct buf *b;
+
+	KASSERT(dev->d_blocksize == BUF_BLOCKSIZE);
+
+	lock_acquire(buf_lock);
+	if (buf_find(dev, block) != NULL) {
+		/* Already cached, or on its way. */
+		lock_release(buf_lock);
+		return;
+	}
+
+	/*
+	 * Unlike buf_getbusy, never wait: if there's no free buffer
+	 * or clean idle one to take over, skip it.
+	 */
+	b = NULL;
+	if (buf_count < buf_max) {
+		b = buf_create();
+	}
+	if (b == NULL) {
+		b = buf_lruhead;
+		if (b == NULL || b->b_dirty) {
+			if (b != NULL) {
+				buf_pressure = true;
+			}
+			lock_release(buf_lock);
+			return;
+		}
+		buf_lruremove(b);
+		buf_hashremove(b);
+		buf_stats.bs_evictions++;
+	}
+
+	b->b_dev = dev;
+	b->b_block = block;
+	b->b_valid = false;
+	b->b_dirty = false;
+	b->b_busy = true;
+	b->b_readahead = true;
+	buf_hashadd(b);
+	buf_stats.bs_reads++;
+	buf_stats.bs_rablocks++;
+
+	b->b_bio.bio_dev = dev;
+	b->b_bio.bio_block = block;
+	b->b_bio.bio_nblocks = 1;
+	b->b_bio.bio_data = b->b_data;
+	b->b_bio.bio_rw = UIO_READ;
+	b->b_bio.bio_done = buf_readdone;
+	b->b_bio.bio_arg = b;
+	bio_plugsubmit(plug, &b->b_bio);
+	lock_release(buf_lock);
+}
+
+void
+buf_markdirty(struct buf *b)
+{
+	struct timespec ts;
+
+	KASSERT(b->b_busy);
+	if (!b->b_dirty) {
+		/* Only we can change b_dirty, since it's busy. */
+		gettime(&ts);
+		lock_acquire(buf_lock);
+		b->b_dirtytime = ts.tv_sec;
+		b->b_dirtygen = ++buf_dirtygen;
+		lock_release(buf_lock);
+	}
+	b->b_valid = true;
+	b->b_dirty = true;
+}
+
+void
+buf_release(struct buf *b)
+{
+	lock_acquire(buf_lock);
+	buf_unbusy(b);
+	lock_release(buf_lock);
+}
+
+////////////////////////////////////////////////////////////
+// Whole-device operations
+
+/*
+ * Submit writes, as one plugged batch BB, for every idle dirty buffer
+ * of DEV (or of any device, if DEV is null) that became dirty at or
+ * before time BEFORE and dirty generation GEN. Sets *BUSY if any that
+ * qualify are busy. Returns the number submitted. Call with buf_lock
+ * held.
+ */
+static
+unsigned
+buf_writebatch(struct device *dev, time_t before, unsigned gen,
+	       struct buf_batch *bb, bool *busy)
+{
+	struct bioplug plug;
+	struct buf *b;
+	unsigned i, n;
+
+	n = 0;
+	*busy = false;
+	bio_plug(&plug);
+	for (i=0; i<BUF_HASHSIZE; i++) {
+		for (b = buf_table[i]; b != NULL; b = b->b_hashnext) {
+			if ((dev != NULL && b->b_dev != dev) || !b->b_dirty ||
+			    b->b_dirtytime > before || b->b_dirtygen > gen) {
+				continue;
+			}
+			if (b->b_busy) {
+				*busy = true;
+				continue;
+			}
+			buf_lruremove(b);
+			b->b_busy = true;
+			buf_writeasync(b, bb, &plug);
+			n++;
+		}
+	}
+	bio_unplug(&plug);
+	return n;
+}
+
+int
+buf_flush(struct device *dev)
+{
+	struct buf_batch bb;
+	struct timespec ts;
+	unsigned gen, nsubmitted;
+	bool busy;
+
+	KASSERT(dev != NULL);
+
+	bb.bb_pending = 0;
+	bb.bb_error = 0;
+
+	lock_acquire(buf_lock);
+	/*
+	 * Everything dirtied up to now. Once written, a buffer dirtied
+	 * again gets a later generation, so it isn't waited for.
+	 */
+	gettime(&ts);
+	gen = buf_dirtygen;
+	do {
+		nsubmitted = buf_writebatch(dev, ts.tv_sec, gen, &bb, &busy);
+		if (busy && nsubmitted == 0) {
+			/* Wait for a busy one to be released. */
+			cv_wait(buf_cv, buf_lock);
+		}
+		while (bb.bb_pending > 0) {
+			cv_wait(buf_cv, buf_lock);
+		}
+		/* If some were busy, go around again for them. */
+	} while (busy && bb.bb_error == 0);
+	lock_release(buf_lock);
+
+	return bb.bb_error;
+}
+
+/*
+ * The flusher thread. Buffers that are busy when it looks are left
+ * for next time, as are ones whose writes fail (the bio layer has
+ * already complained about those).
+ */
+static
+void
+buf_flusher(void *unused1, unsigned long unused2)
+{
+	struct buf_batch bb;
+	struct timespec ts;
+	unsigned secs, n;
+	bool busy;
+
+	(void)unused1;
+	(void)unused2;
+
+	secs = 0;
+	while (1) {
+		clocksleep(1);
+		secs++;
+
+		lock_acquire(buf_lock);
+		if (secs < BUF_FLUSHINTERVAL && !buf_pressure) {
+			lock_release(buf_lock);
+			continue;
+		}
+
+		gettime(&ts);
+		if (!buf_pressure) {
+			ts.tv_sec -= BUF_FLUSHAGE;
+		}
+		buf_pressure = false;
+		secs = 0;
+
+		bb.bb_pending = 0;
+		bb.bb_error = 0;
+		n = buf_writebatch(NULL, ts.tv_sec, buf_dirtygen, &bb, &busy);
+		while (bb.bb_pending > 0) {
+			cv_wait(buf_cv, buf_lock);
+		}
+		if (n > 0) {
+			buf_stats.bs_flushruns++;
+			buf_stats.bs_flushwrites += n;
+		}
+		lock_release(buf_lock);
+	}
+}
+
+/*
+ * Is any buffer of DEV busy? Call with buf_lock held.
+ */
+static
+bool
+buf_devbusy(struct device *dev)
+{
+	struct buf *b;
+	unsigned i;
+
+	for (i=0; i<BUF_HASHSIZE; i++) {
+		for (b = buf_table[i]; b != NULL; b = b->b_hashnext) {
+			if (b->b_dev == dev && b->b_busy) {
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+/*
+ * The filesystem is done with DEV by now, but buffers of it can
+ * still be busy: read-ahead buffers stay busy (and clean) until
+ * buf_readdone runs in a bio thread, and the flusher may have some
+ * in flight. Wait for all of those before throwing anything away.
+ */
+int
+buf_invalidate(struct device *dev)
+{
+	struct buf *b, *next;
+	unsigned i;
+	int result;
+
+	result = buf_flush(dev);
+	if (result) {
+		return result;
+	}
+
+	lock_acquire(buf_lock);
+	while (buf_devbusy(dev)) {
+		cv_wait(buf_cv, buf_lock);
+	}
+	for (i=0; i<BUF_HASHSIZE; i++) {
+		for (b = buf_table[i]; b != NULL; b = next) {
+			next = b->b_hashnext;
+			if (b->b_dev != dev) {
+				continue;
+			}
+			KASSERT(!b->b_busy);
+			KASSERT(!b->b_dirty);
+			buf_lruremove(b);
+			b->b_busy = true;
+			buf_destroy(b);
+		}
+	}
+	lock_release(buf_lock);
+	return 0;
+}
+
+int
+buf_setmax(unsigned max)
+{
+	struct buf *b;
+	int result = 0;
+
+	if (max < BUF_MINMAX) {
+		return EINVAL;
+	}
+
+	lock_acquire(buf_lock);
+	buf_max = max;
+
+	/* Drop idle buffers, oldest first; busy ones go when released. */
+	while (buf_count > buf_max && buf_lruhead != NULL) {
+		b = buf_lruhead;
+		buf_lruremove(b);
+		b->b_busy = true;
+		if (b->b_dirty) {
+			result = buf_writeout(b);
+			if (result) {
+				buf_unbusy(b);
+				break;
+			}
+		}
+		buf_destroy(b);
+		cv_broadcast(buf_cv, buf_lock);
+	}
+	lock_release(buf_lock);
+	return result;
+}
+
+////////////////////////////////////////////////////////////
+// Statistics
+
+void
+buf_printstats(void)
+{
+	struct buf *b;
+	unsigned ndirty = 0;
+	unsigned lookups;
+
+	lock_acquire(buf_lock);
+	for (b = buf_lruhead; b != NULL; b = b->b_lrunext) {
+		if (b->b_dirty) {
+			ndirty++;
+		}
+	}
+	lookups = buf_stats.bs_hits + buf_stats.bs_misses;
+
+	kprintf("Buffer cache: %u of %u buffers allocated, %u idle dirty\n",
+		buf_count, buf_max, ndirty);
+	kprintf("    %u lookups: %u hits, %u misses (%u%% hits)\n",
+		lookups, buf_stats.bs_hits, buf_stats.bs_misses,
+		lookups ? buf_stats.bs_hits * 100 / lookups : 0);
+	kprintf("    %u disk reads, %u disk writes, %u evictions\n",
+		buf_stats.bs_reads, buf_stats.bs_writes,
+		buf_stats.bs_evictions);
+	kprintf("    %u blocks read ahead, %u of them used\n",
+		buf_stats.bs_rablocks, buf_stats.bs_rahits);
+	kprintf("    flusher wrote %u buffers in %u runs\n",
+		buf_stats.bs_flushwrites, buf_stats.bs_flushruns);
+	lock_release(buf_lock);
+}
+
+void
+buf_resetstats(void)
+{
+	lock_acquire(buf_lock);
+	buf_stats.bs_hits = 0;
+	buf_stats.bs_misses = 0;
+	buf_stats.bs_reads = 0;
+	buf_stats.bs_writes = 0;
+	buf_stats.bs_evictions = 0;
+	buf_stats.bs_rablocks = 0;
+	buf_stats.bs_rahits = 0;
+	buf_stats.bs_flushruns = 0;
+	buf_stats.bs_flushwrites = 0;
+	lock_release(buf_lock);
+}
@@ -0,0 +1,374 @@
+/*
+ * Name lookup cache. See dcache.h.
+ *
+ * dcache_lock covers the hash table, the LRU list, the generation
+ * number, and the counters. References held by entries are dropped
+ * only after letting go of dcache_lock, since dropping the last one
+ * calls into the filesystem to reclaim the vnode.
+ *
+ * dcache_gen goes up on every purge. A lookup that misses notes it
+ * before asking the filesystem, and dcache_enter drops the result if
+ * it has changed since, so a name removed while the filesystem was
+ * looking it up can't be put back in the cache.
+ */
+
+#include <types.h>
+#include <lib.h>
+#include <synch.h>
+#include <vnode.h>
+#include <dcache.h>
+
+struct dcentry {
+	struct dcentry *dc_hashnext;	/* hash chain */
+	struct dcentry *dc_lruprev;	/* LRU list */
+	struct dcentry *dc_lrunext;
+	struct vnode *dc_dir;		/* directory */
+	struct vnode *dc_vn;		/* what the name is, or NULL */
+	uint32_t dc_hash;		/* hash of dc_dir and dc_name */
+	char dc_name[DCACHE_NAMELEN+1];
+};
+
+static struct lock *dcache_lock;
+static struct dcentry *dcache_table[DCACHE_HASHSIZE];
+static struct dcentry *dcache_lruhead;	/* least recently used */
+static struct dcentry *dcache_lrutail;	/* most recently used */
+static unsigned dcache_count;		/* entries allocated */
+static unsigned dcache_gen;		/* bumped by every purge */
+
+static struct {
+	unsigned ds_hits;		/* name was in the cache */
+	unsigned ds_neghits;		/* ...as a negative entry */
+	unsigned ds_misses;		/* name wasn't */
+	unsigned ds_enters;		/* entries added */
+	unsigned ds_evictions;		/* entries reused for another name */
+	unsigned ds_purges;		/* entries purged */
+} dcache_stats;
+
+void
+dcache_bootstrap(void)
+{
+	dcache_lock = lock_create("dcache_lock");
+	if (dcache_lock == NULL) {
+		panic("dcache_bootstrap: Out of memory\n");
+	}
+}
+
+/*
+ * Can (DIR, NAME) go in the cache?
+ */
+static
+bool
+dcache_cacheable(struct vnode *dir, const char *name)
+{
+	if (dir->vn_fs == NULL) {
+		/* a device */
+		return false;
+	}
+	if (name[0] == 0 || !strcmp(name, ".") || !strcmp(name, "..")) {
+		return false;
+	}
+	return strlen(name) <= DCACHE_NAMELEN;
+}
+
+////////////////////////////////////////////////////////////
+// Hash table and LRU list. Call with dcache_lock held.
+
+static
+uint32_t
+dcache_hash(struct vnode *dir, const char *name)
+{
+	uint32_t h = 2166136261U;
+
+	while (*name != 0) {
+		h ^= (unsigned char)*name++;
+		h *= 16777619U;
+	}
+	h ^= ((uint32_t)(uintptr_t)dir >> 4) * 2654435761U;
+	return h;
+}
+
+static
+struct dcentry **
+dcache_bucket(uint32_t hash)
+{
+	return &dcache_table[(hash >> 16) & (DCACHE_HASHSIZE - 1)];
+}
+
+static
+struct dcentry *
+dcache_find(struct vnode *dir, const char *name, uint32_t hash)
+{
+	struct dcentry *dc;
+
+	for (dc = *dcache_bucket(hash); dc != NULL; dc = dc->dc_hashnext) {
+		if (dc->dc_hash == hash && dc->dc_dir == dir &&
+		    !strcmp(dc->dc_name, name)) {
+			return dc;
+		}
+	}
+	return NULL;
+}
+
+static
+void
+dcache_hashremove(struct dcentry *dc)
+{
+	struct dcentry **pp;
+
+	pp = dcache_bucket(dc->dc_hash);
+	while (*pp != dc) {
+		KASSERT(*pp != NULL);
+		pp = &(*pp)->dc_hashnext;
+	}
+	*pp = dc->dc_hashnext;
+	dc->dc_hashnext = NULL;
+}
+
+static
+void
+dcache_lruadd(struct dcentry *dc)
+{
+	dc->dc_lrunext = NULL;
+	dc->dc_lruprev = dcache_lrutail;
+	if (dcache_lrutail != NULL) {
+		dcache_lrutail->dc_lrunext = dc;
+	}
+	else {
+		dcache_lruhead = dc;
+	}
+	dcache_lrutail = dc;
+}
+
+static
+void
+dcache_lruremove(struct dcentry *dc)
+{
+	if (dc->dc_lruprev != NULL) {
+		dc->dc_lruprev->dc_lrunext = dc->dc_lrunext;
+	}
+	else {
+		KASSERT(dcache_lruhead == dc);
+		dcache_lruhead = dc->dc_lrunext;
+	}
+	if (dc->dc_lrunext != NULL) {
+		dc->dc_lrunext->dc_lruprev = dc->dc_lruprev;
+	}
+	else {
+		KASSERT(dcache_lrutail == dc);
+		dcache_lrutail = dc->dc_lruprev;
+	}
+	dc->dc_lruprev = dc->dc_lrunext = NULL;
+}
+
+/*
+ * Take an entry out of the cache and put it on the list *DEADP, to
+ * be passed to dcache_release once dcache_lock is dropped.
+ */
+static
+void
+dcache_kill(struct dcentry *dc, struct dcentry **deadp)
+{
+	dcache_hashremove(dc);
+	dcache_lruremove(dc);
+	dcache_count--;
+	dc->dc_hashnext = *deadp;
+	*deadp = dc;
+}
+
+/*
+ * Drop the references held by a list of dead entries and free them.
+ * Call without dcache_lock.
+ */
+static
+void
+dcache_release(struct dcentry *dead)
+{
+	struct dcentry *dc;
+
+	while ((dc = dead) != NULL) {
+		dead = dc->dc_hashnext;
+		if (dc->dc_vn != NULL) {
+			VOP_DECREF(dc->dc_vn);
+		}
+		VOP_DECREF(dc->dc_dir);
+		kfree(dc);
+	}
+}
+
+////////////////////////////////////////////////////////////
+// Lookups
+
+bool
+dcache_lookup(struct vnode *dir, const char *name, struct vnode **ret,
+	      unsigned *gen)
+{
+	struct dcentry *dc;
+	uint32_t hash;
+
+	if (!dcache_cacheable(dir, name)) {
+		*gen = 0;
+		return false;
+	}
+	hash = dcache_hash(dir, name);
+
+	lock_acquire(dcache_lock);
+	dc = dcache_find(dir, name, hash);
+	if (dc == NULL) {
+		dcache_stats.ds_misses++;
+		*gen = dcache_gen;
+		lock_release(dcache_lock);
+		return false;
+	}
+
+	dcache_stats.ds_hits++;
+	if (dc->dc_vn != NULL) {
+		VOP_INCREF(dc->dc_vn);
+	}
+	else {
+		dcache_stats.ds_neghits++;
+	}
+	*ret = dc->dc_vn;
+
+	/* Move it to the most recently used end. */
+	dcache_lruremove(dc);
+	dcache_lruadd(dc);
+	lock_release(dcache_lock);
+	return true;
+}
+
+void
+dcache_enter(struct vnode *dir, const char *name, struct vnode *vn,
+	     unsigned gen)
+{
+	struct dcentry *dc, *dead;
+	uint32_t hash;
+
+	if (!dcache_cacheable(dir, name)) {
+		return;
+	}
+	hash = dcache_hash(dir, name);
+
+	dc = kmalloc(sizeof(*dc));
+	if (dc == NULL) {
+		/* Just don't cache it. */
+		return;
+	}
+	VOP_INCREF(dir);
+	if (vn != NULL) {
+		VOP_INCREF(vn);
+	}
+	dc->dc_dir = dir;
+	dc->dc_vn = vn;
+	dc->dc_hash = hash;
+	strcpy(dc->dc_name, name);
+	dc->dc_hashnext = NULL;
+	dead = NULL;
+
+	lock_acquire(dcache_lock);
+	if (gen != dcache_gen || dcache_find(dir, name, hash) != NULL) {
+		/* Out of date, or someone else got there first. */
+		lock_release(dcache_lock);
+		dcache_release(dc);
+		return;
+	}
+	if (dcache_count >= DCACHE_MAX) {
+		dcache_kill(dcache_lruhead, &dead);
+		dcache_stats.ds_evictions++;
+	}
+	dc->dc_hashnext = *dcache_bucket(hash);
+	*dcache_bucket(hash) = dc;
+	dcache_lruadd(dc);
+	dcache_count++;
+	dcache_stats.ds_enters++;
+	lock_release(dcache_lock);
+
+	dcache_release(dead);
+}
+
+////////////////////////////////////////////////////////////
+// Invalidation
+
+void
+dcache_purge(struct vnode *dir, const char *name)
+{
+	struct dcentry *dc, *next, *dead;
+	struct vnode *vn;
+
+	if (!dcache_cacheable(dir, name)) {
+		return;
+	}
+	dead = NULL;
+
+	lock_acquire(dcache_lock);
+	dcache_gen++;
+	dc = dcache_find(dir, name, dcache_hash(dir, name));
+	if (dc != NULL) {
+		vn = dc->dc_vn;
+		dcache_kill(dc, &dead);
+		dcache_stats.ds_purges++;
+
+		/* If it was a directory, forget what's in it too. */
+		if (vn != NULL) {
+			for (dc = dcache_lruhead; dc != NULL; dc = next) {
+				next = dc->dc_lrunext;
+				if (dc->dc_dir == vn) {
+					dcache_kill(dc, &dead);
+					dcache_stats.ds_purges++;
+				}
+			}
+		}
+	}
+	lock_release(dcache_lock);
+
+	dcache_release(dead);
+}
+
+void
+dcache_purgefs(struct fs *fs)
+{
+	struct dcentry *dc, *next, *dead;
+
+	dead = NULL;
+
+	lock_acquire(dcache_lock);
+	dcache_gen++;
+	for (dc = dcache_lruhead; dc != NULL; dc = next) {
+		next = dc->dc_lrunext;
+		if (dc->dc_dir->vn_fs == fs) {
+			dcache_kill(dc, &dead);
+			dcache_stats.ds_purges++;
+		}
+	}
+	lock_release(dcache_lock);
+
+	dcache_release(dead);
+}
+
+////////////////////////////////////////////////////////////
+// Statistics
+
+void
+dcache_printstats(void)
+{
+	lock_acquire(dcache_lock);
+	kprintf("Name cache: %u entries, %u hits (%u negative), "
+		"%u misses\n", dcache_count, dcache_stats.ds_hits,
+		dcache_stats.ds_neghits, dcache_stats.ds_misses);
+	kprintf("    %u added, %u evicted, %u purged\n",
+		dcache_stats.ds_enters, dcache_stats.ds_evictions,
+		dcache_stats.ds_purges);
+	lock_release(dcache_lock);
+}
+
+void
+dcache_resetstats(void)
+{
+	lock_acquire(dcache_lock);
+	dcache_stats.ds_hits = 0;
+	dcache_stats.ds_neghits = 0;
+	dcache_stats.ds_misses = 0;
+	dcache_stats.ds_enters = 0;
+	dcache_stats.ds_evictions = 0;
+	dcache_stats.ds_purges = 0;
+	lock_release(dcache_lock);
+}
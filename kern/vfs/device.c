@@ -328,6 +328,7 @@ static const struct vnode_ops dev_vnode_ops = {
 	.vop_eachopen = dev_eachopen,
 	.vop_reclaim = dev_reclaim,
 	.vop_read = dev_read,
+	.vop_readahead = vopfail_readahead_ignore,
 	.vop_readlink = vopfail_uio_inval,
 	.vop_getdirentry = vopfail_uio_notdir,
 	.vop_write = dev_write,
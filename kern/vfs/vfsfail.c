@@ -79,6 +79,17 @@ vopfail_uio_nosys(struct vnode *vn, struct uio *uio)
 	return ENOSYS;
 }
 
+////////////////////////////////////////////////////////////
+// readahead
+
+void
+vopfail_readahead_ignore(struct vnode *vn, off_t pos, off_t len)
+{
+	(void)vn;
+	(void)pos;
+	(void)len;
+}
+
 ////////////////////////////////////////////////////////////
 // mmap
 
@@ -35,12 +35,19 @@
 #include <kern/errno.h>
 #include <limits.h>
 #include <lib.h>
+#include <spinlock.h>
 #include <synch.h>
 #include <vfs.h>
 #include <fs.h>
 #include <vnode.h>
+#include <dcache.h>
 
+/*
+ * bootfs_vnode is protected by bootfs_lock so that name lookups can
+ * read it without the big lock.
+ */
 static struct vnode *bootfs_vnode = NULL;
+static struct spinlock bootfs_lock = SPINLOCK_INITIALIZER_NAMED("bootfs_lock");
 
 /*
  * Helper function for actually changing bootfs_vnode.
@@ -51,8 +58,10 @@ change_bootfs(struct vnode *newvn)
 {
 	struct vnode *oldvn;
 
+	spinlock_acquire(&bootfs_lock);
 	oldvn = bootfs_vnode;
 	bootfs_vnode = newvn;
+	spinlock_release(&bootfs_lock);
 
 	if (oldvn != NULL) {
 		VOP_DECREF(oldvn);
@@ -75,14 +84,11 @@ vfs_setbootfs(const char *fsname)
 	int result;
 	struct vnode *newguy;
 
-	vfs_biglock_acquire();
-
 	snprintf(tmp, sizeof(tmp)-1, "%s", fsname);
 	s = strchr(tmp, ':');
 	if (s) {
 		/* If there's a colon, it must be at the end */
 		if (strlen(s)>0) {
-			vfs_biglock_release();
 			return EINVAL;
 		}
 	}
@@ -92,19 +98,16 @@ vfs_setbootfs(const char *fsname)
 
 	result = vfs_chdir(tmp);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	result = vfs_getcurdir(&newguy);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	change_bootfs(newguy);
 
-	vfs_biglock_release();
 	return 0;
 }
 
@@ -114,9 +117,7 @@ vfs_setbootfs(const char *fsname)
 void
 vfs_clearbootfs(void)
 {
-	vfs_biglock_acquire();
 	change_bootfs(NULL);
-	vfs_biglock_release();
 }
 
 
@@ -133,8 +134,6 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	struct vnode *vn;
 	int result;
 
-	KASSERT(vfs_biglock_do_i_hold());
-
 	/*
 	 * Locate the first colon or slash.
 	 */
@@ -188,11 +187,14 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	KASSERT(colon==0 || slash==0);
 
 	if (path[0]=='/') {
+		spinlock_acquire(&bootfs_lock);
 		if (bootfs_vnode==NULL) {
+			spinlock_release(&bootfs_lock);
 			return ENOENT;
 		}
 		VOP_INCREF(bootfs_vnode);
 		*startvn = bootfs_vnode;
+		spinlock_release(&bootfs_lock);
 	}
 	else {
 		KASSERT(path[0]==':');
@@ -227,41 +229,136 @@ getdevice(char *path, char **subpath, struct vnode **startvn)
 	return 0;
 }
 
+/*
+ * Look up one path component NAME in directory DIR, through the name
+ * cache.
+ */
+static
+int
+lookonce(struct vnode *dir, char *name, struct vnode **ret)
+{
+	unsigned gen;
+	int result;
+
+	if (dcache_lookup(dir, name, ret, &gen)) {
+		return *ret != NULL ? 0 : ENOENT;
+	}
+
+	result = VOP_LOOKUP(dir, name, ret);
+	if (result == 0) {
+		dcache_enter(dir, name, *ret, gen);
+	}
+	else if (result == ENOENT) {
+		dcache_enter(dir, name, NULL, gen);
+	}
+	return result;
+}
+
+/*
+ * Look up PATH relative to STARTVN a component at a time. PATH is
+ * changed while we work but put back afterwards.
+ */
+static
+int
+lookpath(struct vnode *startvn, char *path, struct vnode **ret)
+{
+	struct vnode *dir, *next;
+	char *end, save;
+	int result;
+
+	VOP_INCREF(startvn);
+	dir = startvn;
+
+	while (1) {
+		while (*path == '/') {
+			path++;
+		}
+		if (*path == 0) {
+			break;
+		}
+
+		end = path;
+		while (*end != 0 && *end != '/') {
+			end++;
+		}
+		save = *end;
+		*end = 0;
+		result = lookonce(dir, path, &next);
+		*end = save;
+
+		VOP_DECREF(dir);
+		if (result) {
+			return result;
+		}
+		dir = next;
+		path = end;
+	}
+
+	*ret = dir;
+	return 0;
+}
+
 /*
  * Name-to-vnode translation.
  * (In BSD, both of these are subsumed by namei().)
+ *
+ * The path is walked a component at a time, through the name cache
+ * (see dcache.h); the filesystem only sees the components that
+ * aren't cached, one at a time, and for lookparent, the last one.
+ *
+ * These do not take the big lock. The device list is covered by its
+ * own reader-writer lock inside vfs_getroot, and the filesystem takes
+ * whatever locks it needs in VOP_LOOKUP/VOP_LOOKPARENT.
  */
 
 int
 vfs_lookparent(char *path, struct vnode **retval,
 	       char *buf, size_t buflen)
 {
-	struct vnode *startvn;
+	struct vnode *startvn, *dir;
+	char *name;
+	size_t len;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
-	if (strlen(path)==0) {
+	/* Trailing slashes don't change what the last component is. */
+	len = strlen(path);
+	while (len > 0 && path[len-1] == '/') {
+		path[--len] = 0;
+	}
+
+	if (len==0) {
 		/*
 		 * It does not make sense to use just a device name in
 		 * a context where "lookparent" is the desired
 		 * operation.
 		 */
-		result = EINVAL;
+		VOP_DECREF(startvn);
+		return EINVAL;
+	}
+
+	/* Find the directory part, then let the fs handle the rest. */
+	name = strrchr(path, '/');
+	if (name == NULL) {
+		name = path;
+		dir = startvn;
 	}
 	else {
-		result = VOP_LOOKPARENT(startvn, path, retval, buf, buflen);
+		*name++ = 0;
+		result = lookpath(startvn, path, &dir);
+		VOP_DECREF(startvn);
+		if (result) {
+			return result;
+		}
 	}
 
-	VOP_DECREF(startvn);
+	result = VOP_LOOKPARENT(dir, name, retval, buf, buflen);
+	VOP_DECREF(dir);
 
-	vfs_biglock_release();
 	return result;
 }
 
@@ -271,23 +368,18 @@ vfs_lookup(char *path, struct vnode **retval)
 	struct vnode *startvn;
 	int result;
 
-	vfs_biglock_acquire();
-
 	result = getdevice(path, &path, &startvn);
 	if (result) {
-		vfs_biglock_release();
 		return result;
 	}
 
 	if (strlen(path)==0) {
 		*retval = startvn;
-		vfs_biglock_release();
 		return 0;
 	}
 
-	result = VOP_LOOKUP(startvn, path, retval);
+	result = lookpath(startvn, path, retval);
 
 	VOP_DECREF(startvn);
-	vfs_biglock_release();
 	return result;
 }
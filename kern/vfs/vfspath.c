@@ -38,6 +38,7 @@
 #include <lib.h>
 #include <vfs.h>
 #include <vnode.h>
+#include <dcache.h>
 
 
 /* Does most of the work for open(). */
@@ -74,6 +75,10 @@ vfs_open(char *path, int openflags, mode_t mode, struct vnode **ret)
 		}
 
 		result = VOP_CREAT(dir, name, excl, mode, &vn);
+		if (result == 0) {
+			/* It may have been cached as not existing. */
+			dcache_purge(dir, name);
+		}
 
 		VOP_DECREF(dir);
 	}
@@ -146,6 +151,9 @@ vfs_remove(char *path)
 	}
 
 	result = VOP_REMOVE(dir, name);
+	if (result == 0) {
+		dcache_purge(dir, name);
+	}
 	VOP_DECREF(dir);
 
 	return result;
@@ -179,6 +187,10 @@ vfs_rename(char *oldpath, char *newpath)
 	}
 
 	result = VOP_RENAME(olddir, oldname, newdir, newname);
+	if (result == 0) {
+		dcache_purge(olddir, oldname);
+		dcache_purge(newdir, newname);
+	}
 
 	VOP_DECREF(newdir);
 	VOP_DECREF(olddir);
@@ -213,6 +225,9 @@ vfs_link(char *oldpath, char *newpath)
 	}
 
 	result = VOP_LINK(newdir, newname, oldfile);
+	if (result == 0) {
+		dcache_purge(newdir, newname);
+	}
 
 	VOP_DECREF(newdir);
 	VOP_DECREF(oldfile);
@@ -240,6 +255,9 @@ vfs_symlink(const char *contents, char *path)
 	}
 
 	result = VOP_SYMLINK(newdir, newname, contents);
+	if (result == 0) {
+		dcache_purge(newdir, newname);
+	}
 	VOP_DECREF(newdir);
 
 	return result;
@@ -286,6 +304,9 @@ vfs_mkdir(char *path, mode_t mode)
 	}
 
 	result = VOP_MKDIR(parent, name, mode);
+	if (result == 0) {
+		dcache_purge(parent, name);
+	}
 
 	VOP_DECREF(parent);
 
@@ -308,6 +329,9 @@ vfs_rmdir(char *path)
 	}
 
 	result = VOP_RMDIR(parent, name);
+	if (result == 0) {
+		dcache_purge(parent, name);
+	}
 
 	VOP_DECREF(parent);
 
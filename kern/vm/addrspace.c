@@ -70,9 +70,13 @@ as_create(void)
 
 	as->as_heap_start = 0;
 	as->as_heap_end = 0;
+	as->as_copiedpages = 0;
 
 	as->stack = NULL;
 	as->heap = NULL;
+	for(unsigned i = 0; i < UTHREAD_MAX; i++){
+		as->tstack[i] = NULL;
+	}
 
 	return as;
 }
@@ -117,7 +121,7 @@ add_table_entries(struct area *segment, vaddr_t start, unsigned int add){
 
 /* Copy all pages in an already initialized segment and prepare it for addition to a linked list. */
 static int
-seg_copy(struct area **out, struct area *src){
+seg_copy(struct area **out, struct area *src, unsigned *copied){
 	
 	struct pentry *copyable;
 
@@ -157,6 +161,7 @@ seg_copy(struct area **out, struct area *src){
 		}
 		memmove((void *)PADDR_TO_KVADDR(ppn_to_paddr(newpage->paddr)), 
 			(const void *)PADDR_TO_KVADDR(ppn_to_paddr(copyable->paddr)), PAGE_SIZE);
+		(*copied)++;
 
 		// Copy over the rest of the struct info
 		newpage->vaddr = copyable->vaddr;
@@ -230,7 +235,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 	while( oldseg != NULL ){
 		struct area *newseg;	
 	
-		result = seg_copy(&newseg, oldseg);
+		result = seg_copy(&newseg, oldseg, &newas->as_copiedpages);
 		if(result){
 			return ENOMEM;
 		}
@@ -283,6 +288,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 			newstack->paddr = paddr_to_ppn(alloc_ppages(1));
 			memmove((void *)PADDR_TO_KVADDR(ppn_to_paddr(newstack->paddr)), 
 				(const void *)PADDR_TO_KVADDR(ppn_to_paddr(oldstack->paddr)), PAGE_SIZE);
+			newas->as_copiedpages++;
 		}
 
 		oldstack = oldstack->next;
@@ -305,6 +311,7 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		newheap->paddr = paddr_to_ppn(alloc_ppages(1));
 		memmove((void *)PADDR_TO_KVADDR(ppn_to_paddr(newheap->paddr)), 
 			(const void *)PADDR_TO_KVADDR(ppn_to_paddr(oldheap->paddr)), PAGE_SIZE);
+		newas->as_copiedpages++;
 
 		newheap->vaddr = oldheap->vaddr;
 		newheap->next = NULL;
@@ -323,6 +330,32 @@ as_copy(struct addrspace *old, struct addrspace **ret)
 		oldheap = oldheap->next;
 	}
 	
+	// Copy the extra thread stacks; the forking thread may be on one of them.
+	for(unsigned i = 0; i < UTHREAD_MAX; i++){
+		if(old->tstack[i] == NULL){
+			continue;
+		}
+		result = as_define_thread_stack(newas, i, &fakestack);
+		if(result){
+			as_destroy(newas);
+			return result;
+		}
+
+		oldstack = old->tstack[i];
+		newstack = newas->tstack[i];
+		while( oldstack != NULL ){
+			if(oldstack->paddr != 0){
+				newstack->paddr = paddr_to_ppn(alloc_ppages(1));
+				memmove((void *)PADDR_TO_KVADDR(ppn_to_paddr(newstack->paddr)),
+					(const void *)PADDR_TO_KVADDR(ppn_to_paddr(oldstack->paddr)), PAGE_SIZE);
+				newas->as_copiedpages++;
+			}
+
+			oldstack = oldstack->next;
+			newstack = newstack->next;
+		}
+	}
+
 	// Set heap breakpoints from old addrspace
 	newas->as_heap_start = old->as_heap_start;
 	newas->as_heap_end = old->as_heap_end;
@@ -398,6 +431,11 @@ as_destroy(struct addrspace *as)
 		freeheap = temp;
 	}	
 
+	// Free all thread stacks
+	for(unsigned i = 0; i < UTHREAD_MAX; i++){
+		as_free_thread_stack(as, i);
+	}
+
 	// Just to be safe
 	as->as_heap_start = 0;
 	as->as_heap_end = 0;
@@ -643,3 +681,59 @@ as_define_stack(struct addrspace *as, vaddr_t *stackptr)
 	return 0;
 }
 
+/* A branch office of the stack department: each extra thread gets its own
+ * stack, carved out below the main one. Slot 0 sits right under the main
+ * stack, slot 1 under that, and so on. Like the main stack, pages are only
+ * given pentries here and are reserved on demand in vm_fault.
+ */
+int
+as_define_thread_stack(struct addrspace *as, unsigned slot, vaddr_t *stackptr)
+{
+	if(as == NULL || stackptr == NULL || slot >= UTHREAD_MAX){
+		return EFAULT;
+	}
+
+	// A slot being reused starts out with fresh (zero-fill) pages.
+	as_free_thread_stack(as, slot);
+
+	vaddr_t stack_top = USERSTACK - (PAGE_SIZE * ADDRSP_STACKSIZE) -
+		slot * (PAGE_SIZE * ADDRSP_THREADSTACK_PAGES);
+	vaddr_t stack_begin = stack_top - (PAGE_SIZE * ADDRSP_THREADSTACK_PAGES);
+
+	// Build the list from the top down, so it ends up in address order.
+	for(int i = ADDRSP_THREADSTACK_PAGES - 1; i >= 0; i--){
+		struct pentry *newpage;
+		newpage = kmalloc(sizeof(*newpage));
+		if(newpage == NULL){
+			as_free_thread_stack(as, slot);
+			return ENOMEM;
+		}
+		newpage->vaddr = vaddr_to_vpn(stack_begin + i * PAGE_SIZE);
+		newpage->paddr = 0;
+		newpage->next = as->tstack[slot];
+		as->tstack[slot] = newpage;
+	}
+
+	*stackptr = stack_top;
+	return 0;
+}
+
+/* Return a thread stack's pages and pentries once its thread is gone. */
+void
+as_free_thread_stack(struct addrspace *as, unsigned slot)
+{
+	struct pentry *page, *temp;
+
+	KASSERT(slot < UTHREAD_MAX);
+
+	page = as->tstack[slot];
+	while(page != NULL){
+		temp = page->next;
+		if(page->paddr != 0){
+			free_ppage( ppn_to_paddr(page->paddr) );
+		}
+		kfree(page);
+		page = temp;
+	}
+	as->tstack[slot] = NULL;
+}
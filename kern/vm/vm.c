@@ -33,7 +33,7 @@ static struct core *coremap;				// Pointer to coremap
  * (6) Set up global coremap lock. --> Set up statically. Step no longer needed.
  */
 
-static struct spinlock coremap_lock = SPINLOCK_INITIALIZER;	// Synchro primitive for coremap
+static struct spinlock coremap_lock = SPINLOCK_INITIALIZER_NAMED("coremap_lock");	// Synchro primitive for coremap
 
 void
 vm_bootstrap(void){
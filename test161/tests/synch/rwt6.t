@@ -0,0 +1,14 @@
+---
+name: "RW Lock Test 6"
+description:
+  Measures reader-writer lock throughput on a read-mostly workload with
+  increasing numbers of threads, and checks that readers and writers
+  never overlap.
+tags: [synch, rwlocks, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+rwt6
+khu
@@ -0,0 +1,14 @@
+---
+name: "Spinlock Stress Test"
+description:
+  Hammers one spinlock from every cpu, reporting throughput and
+  per-cpu acquisition counts, and checks that no updates made under
+  the lock are lost.
+tags: [synch, spinlocks, kleaks]
+depends: [boot, semaphores]
+sys161:
+  cpus: 8
+---
+khu
+spt1
+khu
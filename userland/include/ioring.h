@@ -0,0 +1,44 @@
+/*
+ * Batched file I/O through ioring_enter().
+ *
+ * Queue operations on a ring with the ioring_read/write/lseek/close
+ * functions, send them all to the kernel with ioring_submit, and
+ * collect the results with ioring_reap. Nothing happens until
+ * ioring_submit is called, and operations are done in the order they
+ * were queued. See <kern/ioring.h> for the ring itself.
+ */
+
+#ifndef _IORING_H_
+#define _IORING_H_
+
+#include <sys/types.h>
+#include <kern/ioring.h>
+
+/* The system call. Returns the number of completions posted. */
+int ioring_enter(struct ioring *ring);
+
+void ioring_init(struct ioring *ring);
+
+/*
+ * Queue an operation. DATA is handed back in its completion. These
+ * fail with EAGAIN if the submission queue is full.
+ */
+int ioring_read(struct ioring *ring, int fd, void *buf, size_t len,
+		unsigned data);
+int ioring_write(struct ioring *ring, int fd, const void *buf, size_t len,
+		 unsigned data);
+int ioring_lseek(struct ioring *ring, int fd, off_t pos, int whence,
+		 unsigned data);
+int ioring_close(struct ioring *ring, int fd, unsigned data);
+
+/*
+ * Submit everything queued. Returns the number of completions
+ * posted, or -1 on error. Stops early if the completion queue is
+ * full; reap and submit again to do the rest.
+ */
+int ioring_submit(struct ioring *ring);
+
+/* Take the next completion. Returns 1, or 0 if there are none. */
+int ioring_reap(struct ioring *ring, struct ioring_cqe *cqe);
+
+#endif /* _IORING_H_ */
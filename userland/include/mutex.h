@@ -0,0 +1,27 @@
+/*
+ * Mutual exclusion locks for user threads, built on futex().
+ *
+ * Locking and unlocking a mutex nobody else wants takes no system
+ * calls at all; futex() is only used to sleep when the mutex is held
+ * and to wake a sleeper on unlock.
+ */
+
+#ifndef _MUTEX_H_
+#define _MUTEX_H_
+
+/*
+ * mtx_state is 0 when unlocked, 1 when locked with no waiters, and 2
+ * when locked and there may be threads sleeping on it.
+ */
+struct mutex {
+	volatile int mtx_state;
+};
+
+#define MUTEX_INITIALIZER	{ 0 }
+
+void mutex_init(struct mutex *mtx);
+void mutex_lock(struct mutex *mtx);
+int mutex_trylock(struct mutex *mtx);	/* 0 or EBUSY */
+void mutex_unlock(struct mutex *mtx);
+
+#endif /* _MUTEX_H_ */
@@ -39,6 +39,7 @@
  * about the kern/ headers.
  */
 #include <kern/fcntl.h>
+#include <kern/futex.h>
 #include <kern/ioctl.h>
 #include <kern/reboot.h>
 #include <kern/seek.h>
@@ -128,7 +129,7 @@ int sync(void);
 int rmdir(const char *dirname);
 
 /* Recommended. */
-pid_t getpid(void);
+pid_t __getpid(void);
 int ioctl(int filehandle, int code, void *buf);
 off_t lseek(int filehandle, off_t pos, int code);
 int fsync(int filehandle);
@@ -148,6 +149,13 @@ int dup2(int filehandle, int newhandle);
 int pipe(int filehandles[2]);
 int __time(time_t *seconds, unsigned long *nanoseconds);
 ssize_t __getcwd(char *buf, size_t buflen);
+int futex(volatile int *addr, int op, int val);
+pid_t spawn(const char *prog, char *const *args);
+int __thread_create(void (*start)(void *(*)(void *), void *),
+		    void *(*func)(void *), void *arg);
+int thread_join(int tid, void **retval);
+__DEAD void thread_exit(void *retval);
+/* ioring_enter - see ioring.h */
 /* stat - see sys/stat.h */
 /* lstat - see sys/stat.h */
 
@@ -156,7 +164,11 @@ ssize_t __getcwd(char *buf, size_t buflen);
  */
 
 int execvp(const char *prog, char *const *args); /* calls execv */
+pid_t spawnp(const char *prog, char *const *args); /* calls spawn */
 char *getcwd(char *buf, size_t buflen);		/* calls __getcwd */
-time_t time(time_t *seconds);			/* calls __time */
+time_t time(time_t *seconds);			/* reads the user clock page */
+pid_t getpid(void);				/* reads the user info page */
+pid_t getppid(void);				/* reads the user info page */
+int thread_create(void *(*func)(void *), void *arg); /* calls __thread_create */
 
 #endif /* _UNISTD_H_ */
@@ -0,0 +1,21 @@
+/*
+ * getpid and getppid: read our pids out of the user info page (see
+ * <kern/userinfo.h>) instead of asking the kernel.
+ */
+
+#include <unistd.h>
+#include <kern/userinfo.h>
+
+#define UI	((const struct userinfo *)USERINFO_ADDR)
+
+pid_t
+getpid(void)
+{
+	return UI->ui_pid;
+}
+
+pid_t
+getppid(void)
+{
+	return UI->ui_ppid;
+}
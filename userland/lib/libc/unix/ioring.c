@@ -0,0 +1,82 @@
+/*
+ * libc side of ioring_enter(): queueing operations and reaping
+ * completions. See <ioring.h>.
+ */
+
+#include <ioring.h>
+#include <errno.h>
+
+void
+ioring_init(struct ioring *ring)
+{
+	ring->ir_sqhead = ring->ir_sqtail = 0;
+	ring->ir_cqhead = ring->ir_cqtail = 0;
+}
+
+static
+int
+ioring_queue(struct ioring *ring, int op, int fd, void *buf,
+	     unsigned len, off_t offset, unsigned data)
+{
+	struct ioring_sqe *sqe;
+
+	if (ring->ir_sqtail - ring->ir_sqhead >= IORING_SIZE) {
+		errno = EAGAIN;
+		return -1;
+	}
+	sqe = &ring->ir_sq[ring->ir_sqtail % IORING_SIZE];
+	sqe->sqe_op = op;
+	sqe->sqe_fd = fd;
+	sqe->sqe_buf = buf;
+	sqe->sqe_len = len;
+	sqe->sqe_data = data;
+	sqe->sqe_offset = offset;
+	ring->ir_sqtail++;
+	return 0;
+}
+
+int
+ioring_read(struct ioring *ring, int fd, void *buf, size_t len,
+	    unsigned data)
+{
+	return ioring_queue(ring, IORING_OP_READ, fd, buf, len, 0, data);
+}
+
+int
+ioring_write(struct ioring *ring, int fd, const void *buf, size_t len,
+	     unsigned data)
+{
+	return ioring_queue(ring, IORING_OP_WRITE, fd, (void *)buf, len, 0,
+			    data);
+}
+
+int
+ioring_lseek(struct ioring *ring, int fd, off_t pos, int whence,
+	     unsigned data)
+{
+	return ioring_queue(ring, IORING_OP_LSEEK, fd, NULL, whence, pos,
+			    data);
+}
+
+int
+ioring_close(struct ioring *ring, int fd, unsigned data)
+{
+	return ioring_queue(ring, IORING_OP_CLOSE, fd, NULL, 0, 0, data);
+}
+
+int
+ioring_submit(struct ioring *ring)
+{
+	return ioring_enter(ring);
+}
+
+int
+ioring_reap(struct ioring *ring, struct ioring_cqe *cqe)
+{
+	if (ring->ir_cqhead == ring->ir_cqtail) {
+		return 0;
+	}
+	*cqe = ring->ir_cq[ring->ir_cqhead % IORING_SIZE];
+	ring->ir_cqhead++;
+	return 1;
+}
@@ -0,0 +1,108 @@
+/*
+ * Futex-based mutex. This is the three-state mutex from Drepper's
+ * "Futexes Are Tricky": see <mutex.h> for the states.
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <mutex.h>
+
+/*
+ * Atomic compare-and-swap: if *P is OLD, set it to NEW. Returns the
+ * value *P had. Uses LL/SC; a failed SC just goes around again.
+ */
+static
+int
+mutex_cas(volatile int *p, int old, int new)
+{
+	int x, y;
+
+	do {
+		y = new;
+		__asm volatile(
+			".set push;"
+			".set mips32;"
+			".set noreorder;"
+			"ll %0, 0(%2);"
+			"bne %0, %3, 1f;"
+			" nop;"
+			"sc %1, 0(%2);"
+			"b 2f;"
+			" nop;"
+			"1: li %1, 1;"
+			"2: sync;"
+			".set pop"
+			: "=&r" (x), "+r" (y) : "r" (p), "r" (old) : "memory");
+	} while (y == 0);
+	return x;
+}
+
+/*
+ * Atomic exchange: set *P to NEW and return the old value.
+ */
+static
+int
+mutex_xchg(volatile int *p, int new)
+{
+	int x, y;
+
+	do {
+		y = new;
+		__asm volatile(
+			".set push;"
+			".set mips32;"
+			"ll %0, 0(%2);"
+			"sc %1, 0(%2);"
+			"sync;"
+			".set pop"
+			: "=&r" (x), "+r" (y) : "r" (p) : "memory");
+	} while (y == 0);
+	return x;
+}
+
+void
+mutex_init(struct mutex *mtx)
+{
+	mtx->mtx_state = 0;
+}
+
+void
+mutex_lock(struct mutex *mtx)
+{
+	int c;
+
+	/* Fast path: unlocked -> locked, no system call. */
+	c = mutex_cas(&mtx->mtx_state, 0, 1);
+	if (c == 0) {
+		return;
+	}
+
+	/*
+	 * Contended. Mark the mutex as having waiters and sleep until
+	 * we're the one that flips it from unlocked. We always leave
+	 * it in state 2 when we get it this way, since there may be
+	 * other sleepers.
+	 */
+	if (c != 2) {
+		c = mutex_xchg(&mtx->mtx_state, 2);
+	}
+	while (c != 0) {
+		(void)futex(&mtx->mtx_state, FUTEX_WAIT, 2);
+		c = mutex_xchg(&mtx->mtx_state, 2);
+	}
+}
+
+int
+mutex_trylock(struct mutex *mtx)
+{
+	return mutex_cas(&mtx->mtx_state, 0, 1) == 0 ? 0 : EBUSY;
+}
+
+void
+mutex_unlock(struct mutex *mtx)
+{
+	/* Only call into the kernel if someone may be waiting. */
+	if (mutex_xchg(&mtx->mtx_state, 0) == 2) {
+		(void)futex(&mtx->mtx_state, FUTEX_WAKE, 1);
+	}
+}
@@ -0,0 +1,22 @@
+/*
+ * thread_create: start a new user thread running FUNC(ARG).
+ *
+ * The kernel starts the thread in threadstart rather than in FUNC
+ * itself, so that returning from FUNC turns into thread_exit with the
+ * return value instead of jumping to nowhere.
+ */
+
+#include <unistd.h>
+
+static
+void
+threadstart(void *(*func)(void *), void *arg)
+{
+	thread_exit(func(arg));
+}
+
+int
+thread_create(void *(*func)(void *), void *arg)
+{
+	return __thread_create(threadstart, func, arg);
+}
@@ -73,6 +73,11 @@ static bool dofiles, dodirs;
 static bool doindirect;
 static bool recurse;
 
+/* fragmentation counts: for the current inode, and for all inodes */
+static uint32_t frag_lastblock;
+static unsigned frag_pairs, frag_breaks;
+static unsigned frag_totalpairs, frag_totalbreaks;
+
 ////////////////////////////////////////////////////////////
 // printouts
 
@@ -423,6 +428,42 @@ dumpfile(uint32_t ino, const struct sfs_dinode *sfi)
 	traverse(sfi, dumpfileblock);
 }
 
+/*
+ * Count a file's data blocks, in file order, to see how many aren't
+ * right after the one before. Holes are skipped.
+ */
+static
+void
+fragblock(uint32_t fileblock, uint32_t diskblock)
+{
+	(void)fileblock;
+
+	if (diskblock == 0) {
+		return;
+	}
+	if (frag_lastblock != 0) {
+		frag_pairs++;
+		if (diskblock != frag_lastblock + 1) {
+			frag_breaks++;
+		}
+	}
+	frag_lastblock = diskblock;
+}
+
+static
+void
+dumpfrag(const struct sfs_dinode *sfi)
+{
+	frag_lastblock = 0;
+	frag_pairs = frag_breaks = 0;
+	traverse(sfi, fragblock);
+	frag_totalpairs += frag_pairs;
+	frag_totalbreaks += frag_breaks;
+
+	printf("    Fragmentation: %u of %u consecutive blocks not adjacent\n",
+	       frag_breaks, frag_pairs);
+}
+
 static
 void
 dumpinode(uint32_t ino, const char *name)
@@ -483,6 +524,11 @@ dumpinode(uint32_t ino, const char *name)
 		}
 	}
 
+	if (SWAP16(sfi.sfi_type) == SFS_TYPE_FILE ||
+	    SWAP16(sfi.sfi_type) == SFS_TYPE_DIR) {
+		dumpfrag(&sfi);
+	}
+
 	if (doindirect) {
 		dumpindirect(SWAP32(sfi.sfi_indirect));
 	}
@@ -600,6 +646,15 @@ main(int argc, char **argv)
 	if (dumpino != 0) {
 		dumpinode(dumpino, NULL);
 	}
+	if (recurse) {
+		printf("Fragmentation: %u of %u consecutive file blocks not "
+		       "adjacent (%u.%u%%)\n", frag_totalbreaks,
+		       frag_totalpairs,
+		       frag_totalpairs ?
+		       frag_totalbreaks * 100 / frag_totalpairs : 0,
+		       frag_totalpairs ?
+		       frag_totalbreaks * 1000 / frag_totalpairs % 10 : 0);
+	}
 
 	closedisk();
 
@@ -64,6 +64,8 @@ setbadness(int code)
 int
 main(int argc, char **argv)
 {
+	unsigned long pairs, breaks;
+
 #ifdef HOST
 	hostcompat_init(argc, argv);
 #endif
@@ -96,6 +98,11 @@ main(int argc, char **argv)
 	warnx("%lu blocks used (of %lu); %lu directories; %lu files",
 	      freemap_blocksused(), (unsigned long)sb_totalblocks(),
 	      pass1_founddirs(), pass1_foundfiles());
+	pass1_fragmentation(&pairs, &breaks);
+	warnx("Fragmentation: %lu of %lu consecutive file blocks not "
+	      "adjacent (%lu.%lu%%)", breaks, pairs,
+	      pairs ? breaks * 100 / pairs : 0,
+	      pairs ? breaks * 1000 / pairs % 10 : 0);
 
 	switch (badness) {
 	    case EXIT_USAGE:
@@ -49,6 +49,12 @@
 
 static unsigned long count_dirs=0, count_files=0;
 
+/*
+ * Fragmentation: of the pairs of consecutive data blocks in a file,
+ * how many aren't next to each other on disk.
+ */
+static unsigned long count_blockpairs=0, count_blockbreaks=0;
+
 /*
  * State for checking indirect blocks.
  */
@@ -59,8 +65,26 @@ struct ibstate {
 	uint32_t volblocks;	/* volume size in blocks (constant) */
 	unsigned pasteofcount;	/* number of blocks found past eof */
 	blockusage_t usagetype;	/* how to call freemap_blockinuse() */
+	uint32_t lastdata;	/* previous data block in the file, or 0 */
 };
 
+/*
+ * Count DATABLOCK, the file's next data block, for the fragmentation
+ * figures.
+ */
+static
+void
+note_datablock(struct ibstate *ibs, uint32_t datablock)
+{
+	if (ibs->lastdata != 0) {
+		count_blockpairs++;
+		if (datablock != ibs->lastdata + 1) {
+			count_blockbreaks++;
+		}
+	}
+	ibs->lastdata = datablock;
+}
+
 /*
  * Traverse an indirect block, recording blocks that are in use,
  * dropping any entries that are past EOF, and clearing any entries
@@ -137,6 +161,7 @@ check_indirect_block(struct ibstate *ibs, uint32_t *ientry, int *iechangedp,
 					freemap_blockinuse(entries[i],
 							  ibs->usagetype,
 							  ibs->ino);
+					note_datablock(ibs, entries[i]);
 				}
 				else {
 					setbadness(EXIT_RECOV);
@@ -197,6 +222,7 @@ check_inode_blocks(uint32_t ino, struct sfs_dinode *sfi, int isdir)
 	ibs.volblocks = sb_totalblocks();
 	ibs.pasteofcount = 0;
 	ibs.usagetype = isdir ? B_DIRDATA : B_DATA;
+	ibs.lastdata = 0;
 
 	changed = 0;
 
@@ -217,6 +243,7 @@ check_inode_blocks(uint32_t ino, struct sfs_dinode *sfi, int isdir)
 			if (ibs.curfileblock < ibs.fileblocks) {
 				freemap_blockinuse(datablock, ibs.usagetype,
 						   ibs.ino);
+				note_datablock(&ibs, datablock);
 			}
 			else {
 				setbadness(EXIT_RECOV);
@@ -494,3 +521,10 @@ pass1_foundfiles(void)
 {
 	return count_files;
 }
+
+void
+pass1_fragmentation(unsigned long *pairs, unsigned long *breaks)
+{
+	*pairs = count_blockpairs;
+	*breaks = count_blockbreaks;
+}
@@ -48,4 +48,10 @@ void pass2(void);
 unsigned long pass1_founddirs(void);
 unsigned long pass1_foundfiles(void);
 
+/*
+ * After pass1 is done, return the number of pairs of consecutive data
+ * blocks in files, and how many of them aren't adjacent on disk.
+ */
+void pass1_fragmentation(unsigned long *pairs, unsigned long *breaks);
+
 #endif /* PASSES_H */
@@ -0,0 +1,262 @@
+/*
+ * cpbench - copy a file with and without the I/O ring.
+ *
+ * Usage: cpbench [size in KB]
+ *
+ * Writes a test file of the given size, then copies it twice: once
+ * with a read/write loop like cp's, and once with ioring_enter,
+ * which each time writes out the previous batch of chunks and reads
+ * the next batch in a single system call. Prints the number of
+ * system calls and the time for each copy, and checks that both
+ * copies match the original.
+ *
+ * "sysstat" in the kernel menu (or "cat sysstat:") shows the same
+ * difference from the kernel's side.
+ *
+ * There's no remove call, so the three files (cpbench.src, .cp1 and
+ * .cp2) are left behind; the next run just writes over them.
+ */
+
+#include <sys/types.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <ioring.h>
+
+#define DEFAULT_KB	256
+#define CHUNK		4096
+#define BATCH		(IORING_SIZE / 2)	/* chunks per ring submit */
+
+#define SRCFILE		"cpbench.src"
+#define PLAINFILE	"cpbench.cp1"
+#define RINGFILE	"cpbench.cp2"
+
+/* ring data: which buffer set and chunk, and whether it's a write */
+#define DATA_WRITE	0x10000
+#define DATA_SET	0x100
+
+static char bufs[2][BATCH][CHUNK];
+static struct ioring ring;
+
+static
+unsigned long long
+now(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000000000ULL + nsecs;
+}
+
+static
+int
+openfiles(const char *from, const char *to, int *tofd)
+{
+	int fromfd;
+
+	fromfd = open(from, O_RDONLY);
+	if (fromfd < 0) {
+		err(1, "%s", from);
+	}
+	*tofd = open(to, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (*tofd < 0) {
+		err(1, "%s", to);
+	}
+	return fromfd;
+}
+
+static
+void
+makefile(unsigned kb)
+{
+	unsigned i, j;
+	int fd;
+
+	fd = open(SRCFILE, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", SRCFILE);
+	}
+	for (i=0; i < kb * 1024 / CHUNK; i++) {
+		for (j=0; j<CHUNK; j++) {
+			bufs[0][0][j] = (char)(i + j);
+		}
+		if (write(fd, bufs[0][0], CHUNK) != CHUNK) {
+			err(1, "%s: write", SRCFILE);
+		}
+	}
+	close(fd);
+}
+
+/*
+ * Copy like cp does. Returns the number of system calls made.
+ */
+static
+unsigned
+plaincopy(void)
+{
+	unsigned calls;
+	int fromfd, tofd, len;
+
+	fromfd = openfiles(SRCFILE, PLAINFILE, &tofd);
+	calls = 2;
+
+	while (1) {
+		len = read(fromfd, bufs[0][0], CHUNK);
+		calls++;
+		if (len < 0) {
+			err(1, "%s: read", SRCFILE);
+		}
+		if (len == 0) {
+			break;
+		}
+		if (write(tofd, bufs[0][0], len) != len) {
+			err(1, "%s: write", PLAINFILE);
+		}
+		calls++;
+	}
+
+	close(fromfd);
+	close(tofd);
+	return calls + 2;
+}
+
+/*
+ * Copy with the ring, double buffered: each submit writes out the
+ * chunks read into one buffer set by the previous submit, and reads
+ * the next chunks into the other set. Returns the number of system
+ * calls made.
+ */
+static
+unsigned
+ringcopy(void)
+{
+	struct ioring_cqe cqe;
+	unsigned lens[2][BATCH];
+	unsigned calls, set, other, i, queued;
+	int fromfd, tofd;
+	bool eof;
+
+	fromfd = openfiles(SRCFILE, RINGFILE, &tofd);
+	calls = 2;
+
+	ioring_init(&ring);
+	memset(lens, 0, sizeof(lens));
+	eof = false;
+	set = 0;
+
+	while (1) {
+		other = 1 - set;
+		queued = 0;
+		/* Write out what the last round read into the other set. */
+		for (i=0; i<BATCH; i++) {
+			if (lens[other][i] > 0) {
+				ioring_write(&ring, tofd, bufs[other][i],
+					     lens[other][i],
+					     DATA_WRITE | other * DATA_SET | i);
+				queued++;
+			}
+		}
+		/* And read the next batch into this one. */
+		if (!eof) {
+			for (i=0; i<BATCH; i++) {
+				ioring_read(&ring, fromfd, bufs[set][i],
+					    CHUNK, set * DATA_SET | i);
+				queued++;
+			}
+		}
+		if (queued == 0) {
+			break;
+		}
+
+		if (ioring_submit(&ring) != (int)queued) {
+			err(1, "ioring_submit");
+		}
+		calls++;
+
+		memset(lens[other], 0, sizeof(lens[other]));
+		while (ioring_reap(&ring, &cqe)) {
+			if (cqe.cqe_err) {
+				errno = cqe.cqe_err;
+				err(1, "%s", (cqe.cqe_data & DATA_WRITE) ?
+				    RINGFILE : SRCFILE);
+			}
+			if (cqe.cqe_data & DATA_WRITE) {
+				continue;
+			}
+			i = cqe.cqe_data % DATA_SET;
+			lens[set][i] = cqe.cqe_res;
+			if (cqe.cqe_res < CHUNK) {
+				eof = true;
+			}
+		}
+		set = other;
+	}
+
+	close(fromfd);
+	close(tofd);
+	return calls + 2;
+}
+
+/*
+ * Check that FILE has the same contents as the source.
+ */
+static
+void
+compare(const char *file)
+{
+	int fd1, fd2, len1, len2;
+
+	fd1 = open(SRCFILE, O_RDONLY);
+	fd2 = open(file, O_RDONLY);
+	if (fd1 < 0 || fd2 < 0) {
+		err(1, "compare: open");
+	}
+	do {
+		len1 = read(fd1, bufs[0][0], CHUNK);
+		len2 = read(fd2, bufs[1][0], CHUNK);
+		if (len1 != len2 || memcmp(bufs[0][0], bufs[1][0], len1)) {
+			errx(1, "%s doesn't match %s", file, SRCFILE);
+		}
+	} while (len1 > 0);
+	close(fd1);
+	close(fd2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long long start, plaintime, ringtime;
+	unsigned kb = DEFAULT_KB;
+	unsigned plaincalls, ringcalls;
+
+	if (argc > 1) {
+		kb = atoi(argv[1]);
+	}
+	if (kb == 0) {
+		errx(1, "Usage: cpbench [size in KB]");
+	}
+
+	makefile(kb);
+
+	start = now();
+	plaincalls = plaincopy();
+	plaintime = now() - start;
+
+	start = now();
+	ringcalls = ringcopy();
+	ringtime = now() - start;
+
+	compare(PLAINFILE);
+	compare(RINGFILE);
+
+	printf("%u KB in %u-byte chunks\n", kb, CHUNK);
+	printf("read/write: %6u syscalls %12llu ns\n", plaincalls, plaintime);
+	printf("ioring:     %6u syscalls %12llu ns\n", ringcalls, ringtime);
+	return 0;
+}
@@ -0,0 +1,159 @@
+/*
+ * forkbench - measure process creation throughput.
+ *
+ * Usage: forkbench [iterations] [max parents]
+ *
+ * For 1, 2, 4, ... up to the max number of parents, starts that many
+ * parent processes at once. Each one forks ITERATIONS children that
+ * exit immediately and waits for them, then does the same with
+ * children that exec a trivial program. Prints forks/sec and
+ * execs/sec for each round, so scaling with concurrent parents can
+ * be compared.
+ *
+ * The exec'd program is forkbench itself with the argument "-x",
+ * which makes it exit right away.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_ITERS	50
+#define DEFAULT_PARENTS	4
+#define PROGNAME	"/testbin/forkbench"
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+starttimer(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+/*
+ * Print the rate of N operations of kind WHAT since starttimer().
+ */
+static
+void
+stoptimer(const char *what, unsigned nparents, unsigned n)
+{
+	time_t secs;
+	unsigned long nsecs;
+	unsigned long long total;
+
+	__time(&secs, &nsecs);
+	total = (secs - startsecs) * 1000000000ULL;
+	total += nsecs;
+	total -= startnsecs;
+
+	printf("%-6s %3u parents: %6u in %12llu ns, %6llu/sec\n",
+	       what, nparents, n, total,
+	       total == 0 ? 0ULL : n * 1000000000ULL / total);
+}
+
+static
+void
+waitfor(pid_t pid)
+{
+	int status;
+
+	if (waitpid(pid, &status, 0) < 0) {
+		err(1, "waitpid");
+	}
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		errx(1, "pid %d failed", pid);
+	}
+}
+
+/*
+ * One parent: fork ITERS children, one at a time, each of which
+ * either exits or execs.
+ */
+static
+void
+parent(unsigned iters, int doexec)
+{
+	char *args[3];
+	unsigned i;
+	pid_t pid;
+
+	for (i=0; i<iters; i++) {
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			if (doexec) {
+				args[0] = (char *)"forkbench";
+				args[1] = (char *)"-x";
+				args[2] = NULL;
+				execv(PROGNAME, args);
+				err(1, "%s", PROGNAME);
+			}
+			_exit(0);
+		}
+		waitfor(pid);
+	}
+}
+
+static
+void
+runround(unsigned iters, unsigned nparents, int doexec)
+{
+	pid_t pids[nparents];
+	unsigned i;
+
+	starttimer();
+	for (i=0; i<nparents; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			parent(iters, doexec);
+			_exit(0);
+		}
+	}
+	for (i=0; i<nparents; i++) {
+		waitfor(pids[i]);
+	}
+	stoptimer(doexec ? "exec" : "fork", nparents, iters * nparents);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	unsigned maxparents = DEFAULT_PARENTS;
+	unsigned n;
+
+	if (argc == 2 && !strcmp(argv[1], "-x")) {
+		/* We're the exec target. */
+		return 0;
+	}
+
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		maxparents = atoi(argv[2]);
+	}
+	if (iters == 0 || maxparents == 0) {
+		errx(1, "Usage: forkbench [iterations] [max parents]");
+	}
+
+	for (n = 1; n <= maxparents; n *= 2) {
+		runround(iters, n, 0);
+	}
+	for (n = 1; n <= maxparents; n *= 2) {
+		runround(iters, n, 1);
+	}
+
+	return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * forklat - measure fork latency against address space size.
+ *
+ * Usage: forklat [iterations]
+ *
+ * Touches 0, 16, 64 and then 256 pages of a static buffer and, for
+ * each size, times ITERATIONS forks: how long fork() takes to return
+ * in the parent, and the full fork/exit/waitpid round trip.
+ *
+ * The kernel counts the pages it copies for each fork. Run
+ * "forkstat reset" from the kernel menu before this and "forkstat"
+ * after it to see the pages copied per fork alongside these times.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_ITERS	20
+#define PAGESIZE	4096
+#define MAXPAGES	256
+
+static char buf[MAXPAGES * PAGESIZE];
+static const unsigned sizes[] = { 0, 16, 64, 256 };
+
+static
+unsigned long long
+now(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+measure(unsigned npages, unsigned iters)
+{
+	unsigned long long start, forked, done, forktotal, total;
+	unsigned i;
+	pid_t pid;
+	int status;
+
+	/* Make sure the pages really exist in our address space. */
+	for (i=0; i<npages; i++) {
+		buf[i * PAGESIZE] = (char)i;
+	}
+
+	forktotal = total = 0;
+	for (i=0; i<iters; i++) {
+		start = now();
+		pid = fork();
+		if (pid < 0) {
+			err(1, "fork");
+		}
+		if (pid == 0) {
+			_exit(0);
+		}
+		forked = now();
+		if (waitpid(pid, &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		done = now();
+
+		forktotal += forked - start;
+		total += done - start;
+	}
+
+	printf("%4u pages touched: fork %10llu ns, round trip %10llu ns\n",
+	       npages, forktotal / iters, total / iters);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	unsigned i;
+
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+	}
+	if (iters == 0) {
+		errx(1, "Usage: forklat [iterations]");
+	}
+
+	for (i=0; i<sizeof(sizes) / sizeof(sizes[0]); i++) {
+		measure(sizes[i], iters);
+	}
+	printf("Use forkstat in the kernel menu for pages copied per fork.\n");
+
+	return 0;
+}
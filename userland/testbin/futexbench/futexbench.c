@@ -0,0 +1,257 @@
+/*
+ * futexbench - compare the cost of user-level locking.
+ *
+ * Usage: futexbench [iterations] [processes]
+ *
+ * The process count is also used as the number of threads.
+ *
+ * Times, per operation:
+ *   - lock/unlock of an uncontended libc mutex (no system calls)
+ *   - futex() calls that return without sleeping, which is the floor
+ *     for the contended mutex paths
+ *   - lock/unlock of one libc mutex shared by several threads of this
+ *     process, so the contended paths really sleep and wake in futex()
+ *   - P/V on a semfs semaphore ("sem:"), uncontended and then with
+ *     several processes fighting over it, for comparison with the old
+ *     way of doing user synchronization
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <err.h>
+#include <limits.h>
+#include <mutex.h>
+
+#define DEFAULT_ITERS	10000
+#define DEFAULT_PROCS	4
+#define SEMNAME		"sem:futexbench"
+
+static time_t startsecs;
+static unsigned long startnsecs;
+
+static
+void
+starttimer(void)
+{
+	__time(&startsecs, &startnsecs);
+}
+
+/*
+ * Print the time since starttimer() for N operations of kind WHAT.
+ */
+static
+void
+stoptimer(const char *what, unsigned n)
+{
+	time_t secs;
+	unsigned long nsecs;
+	unsigned long long total;
+
+	__time(&secs, &nsecs);
+	total = (secs - startsecs) * 1000000000ULL;
+	total += nsecs;
+	total -= startnsecs;
+
+	printf("%-28s %8u ops %12llu ns %8llu ns/op\n", what, n, total,
+	       total / n);
+}
+
+static
+void
+bench_mutex(unsigned iters)
+{
+	struct mutex mtx = MUTEX_INITIALIZER;
+	unsigned i;
+
+	starttimer();
+	for (i=0; i<iters; i++) {
+		mutex_lock(&mtx);
+		mutex_unlock(&mtx);
+	}
+	stoptimer("mutex lock+unlock", iters);
+}
+
+static
+void
+bench_futex(unsigned iters)
+{
+	volatile int word = 0;
+	unsigned i;
+
+	starttimer();
+	for (i=0; i<iters; i++) {
+		/* Value doesn't match, so this fails with EAGAIN. */
+		if (futex(&word, FUTEX_WAIT, 1) == 0 || errno != EAGAIN) {
+			errx(1, "futex wait: expected EAGAIN");
+		}
+	}
+	stoptimer("futex wait (no sleep)", iters);
+
+	starttimer();
+	for (i=0; i<iters; i++) {
+		if (futex(&word, FUTEX_WAKE, 1) != 0) {
+			errx(1, "futex wake: expected 0 woken");
+		}
+	}
+	stoptimer("futex wake (no waiters)", iters);
+}
+
+static struct mutex shared_mtx = MUTEX_INITIALIZER;
+static volatile unsigned shared_count;
+
+static
+void *
+mutexthread(void *arg)
+{
+	unsigned iters = (unsigned)(uintptr_t)arg;
+	unsigned i;
+
+	for (i=0; i<iters; i++) {
+		mutex_lock(&shared_mtx);
+		shared_count++;
+		mutex_unlock(&shared_mtx);
+	}
+	return NULL;
+}
+
+static
+void
+bench_threads(unsigned iters, unsigned nthreads)
+{
+	int tids[nthreads];
+	unsigned i, each;
+
+	each = iters / nthreads;
+	shared_count = 0;
+
+	starttimer();
+	for (i=0; i<nthreads; i++) {
+		tids[i] = thread_create(mutexthread, (void *)(uintptr_t)each);
+		if (tids[i] < 0) {
+			err(1, "thread_create");
+		}
+	}
+	for (i=0; i<nthreads; i++) {
+		if (thread_join(tids[i], NULL) < 0) {
+			err(1, "thread_join");
+		}
+	}
+	stoptimer("mutex lock+unlock (threads)", each * nthreads);
+
+	if (shared_count != each * nthreads) {
+		errx(1, "mutex lost updates: count %u, expected %u",
+		     shared_count, each * nthreads);
+	}
+}
+
+static
+void
+P(int fd)
+{
+	char c;
+
+	if (read(fd, &c, 1) != 1) {
+		err(1, "%s: read", SEMNAME);
+	}
+}
+
+static
+void
+V(int fd)
+{
+	char c = 0;
+
+	if (write(fd, &c, 1) != 1) {
+		err(1, "%s: write", SEMNAME);
+	}
+}
+
+static
+void
+semloop(unsigned iters)
+{
+	unsigned i;
+	int fd;
+
+	fd = open(SEMNAME, O_RDWR);
+	if (fd < 0) {
+		err(1, "%s: open", SEMNAME);
+	}
+	for (i=0; i<iters; i++) {
+		P(fd);
+		V(fd);
+	}
+	close(fd);
+}
+
+static
+void
+bench_semfs(unsigned iters, unsigned nprocs)
+{
+	pid_t pids[nprocs];
+	unsigned i;
+	int fd, status;
+
+	/* Create the semaphore with a count of 1, so it acts as a lock. */
+	fd = open(SEMNAME, O_RDWR|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s: create", SEMNAME);
+	}
+	V(fd);
+	close(fd);
+
+	starttimer();
+	semloop(iters);
+	stoptimer("semfs P+V", iters);
+
+	starttimer();
+	for (i=0; i<nprocs; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			semloop(iters / nprocs);
+			_exit(0);
+		}
+	}
+	for (i=0; i<nprocs; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			warn("waitpid");
+		}
+	}
+	stoptimer("semfs P+V (contended)", (iters / nprocs) * nprocs);
+
+	(void)remove(SEMNAME);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned iters = DEFAULT_ITERS;
+	unsigned nprocs = DEFAULT_PROCS;
+
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		nprocs = atoi(argv[2]);
+	}
+	if (iters == 0 || nprocs == 0) {
+		errx(1, "Usage: futexbench [iterations] [processes]");
+	}
+
+	bench_mutex(iters);
+	bench_futex(iters);
+	/* A process can only have UTHREAD_MAX extra threads. */
+	bench_threads(iters, nprocs < UTHREAD_MAX ? nprocs : UTHREAD_MAX);
+	bench_semfs(iters, nprocs);
+
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * infobench - compare getpid() and time() with the system calls.
+ *
+ * Usage: infobench [iterations]
+ *
+ * getpid() and time() read the user info pages the kernel maps into
+ * every process; __getpid() and __time() trap into the kernel for
+ * the same answers. Times ITERATIONS calls of each and prints
+ * calls/sec, and checks that both ways agree.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <err.h>
+
+#define DEFAULT_ITERS	10000
+
+static
+unsigned long long
+now(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+report(const char *what, unsigned iters, unsigned long long ns)
+{
+	printf("%-12s %8u calls %12llu ns %10llu calls/sec\n", what, iters,
+	       ns, ns == 0 ? 0ULL : iters * 1000000000ULL / ns);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned long long start;
+	unsigned iters = DEFAULT_ITERS;
+	unsigned i;
+	time_t t1, t2;
+
+	if (argc > 1) {
+		iters = atoi(argv[1]);
+	}
+	if (iters == 0) {
+		errx(1, "Usage: infobench [iterations]");
+	}
+
+	if (getpid() != __getpid()) {
+		errx(1, "getpid() says %d, __getpid() says %d",
+		     getpid(), __getpid());
+	}
+	__time(&t1, NULL);
+	t2 = time(NULL);
+	if (t2 < t1 - 1 || t2 > t1 + 1) {
+		errx(1, "time() is off: %lld, __time says %lld",
+		     (long long)t2, (long long)t1);
+	}
+
+	start = now();
+	for (i=0; i<iters; i++) {
+		(void)__getpid();
+	}
+	report("__getpid", iters, now() - start);
+
+	start = now();
+	for (i=0; i<iters; i++) {
+		(void)getpid();
+	}
+	report("getpid", iters, now() - start);
+
+	start = now();
+	for (i=0; i<iters; i++) {
+		(void)__time(&t1, NULL);
+	}
+	report("__time", iters, now() - start);
+
+	start = now();
+	for (i=0; i<iters; i++) {
+		(void)time(&t2);
+	}
+	report("time", iters, now() - start);
+
+	return 0;
+}
@@ -0,0 +1,165 @@
+/*
+ * readbench - sequential vs. random read throughput.
+ *
+ * Usage: readbench [file size in KB] [read size in bytes]
+ *
+ * Writes a test file, then reads all of it twice with reads of the
+ * given size: once from start to end, and once in a random order of
+ * read-sized pieces. Prints the rate for each in MB/s. With the file
+ * bigger than the buffer cache, the sequential pass should be much
+ * faster, since the kernel notices it and reads ahead; "bufstat" in
+ * the kernel menu shows how many read-ahead blocks got used.
+ *
+ * There's no sync call, so the file is read through once, untimed,
+ * after writing it: with the file bigger than the cache, that pushes
+ * the dirty blocks out, and the timed passes time only reads. There's
+ * no remove call either, so readbench.dat is left behind; the next
+ * run just writes over it.
+ */
+
+#include <sys/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define DEFAULT_KB	512
+#define DEFAULT_READ	512
+#define MAXREAD		8192
+
+#define TESTFILE	"readbench.dat"
+
+static char buf[MAXREAD];
+
+static
+unsigned long long
+now(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+makefile(unsigned kb)
+{
+	unsigned i, j;
+	int fd;
+
+	fd = open(TESTFILE, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+	for (i=0; i<kb; i++) {
+		for (j=0; j<1024; j++) {
+			buf[j] = (char)(i + j);
+		}
+		if (write(fd, buf, 1024) != 1024) {
+			err(1, "%s: write", TESTFILE);
+		}
+	}
+	close(fd);
+}
+
+/*
+ * Read piece ORDER[i] (of size READSIZE) for each i; ORDER is null
+ * for the pieces in order. Returns the elapsed time in nanoseconds.
+ */
+static
+unsigned long long
+readfile(unsigned *order, unsigned npieces, unsigned readsize)
+{
+	unsigned long long start;
+	unsigned i;
+	int fd, len;
+
+	fd = open(TESTFILE, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", TESTFILE);
+	}
+
+	start = now();
+	for (i=0; i<npieces; i++) {
+		if (order != NULL &&
+		    lseek(fd, (off_t)order[i] * readsize, SEEK_SET) < 0) {
+			err(1, "%s: lseek", TESTFILE);
+		}
+		len = read(fd, buf, readsize);
+		if (len < 0) {
+			err(1, "%s: read", TESTFILE);
+		}
+		if ((unsigned)len != readsize) {
+			errx(1, "%s: short read", TESTFILE);
+		}
+	}
+	start = now() - start;
+
+	close(fd);
+	return start;
+}
+
+static
+void
+report(const char *what, unsigned kb, unsigned long long ns)
+{
+	unsigned long long rate;
+
+	/* hundredths of a MB/s */
+	rate = ns ? (unsigned long long)kb * 100 * 1000000000ULL / 1024 / ns
+		: 0;
+	printf("%-10s %6u KB in %12llu ns: %4llu.%02llu MB/s\n",
+	       what, kb, ns, rate / 100, rate % 100);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned kb = DEFAULT_KB;
+	unsigned readsize = DEFAULT_READ;
+	unsigned *order;
+	unsigned npieces, i, j, tmp;
+
+	if (argc > 1) {
+		kb = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		readsize = atoi(argv[2]);
+	}
+	if (kb == 0 || readsize == 0 || readsize > MAXREAD ||
+	    (kb * 1024) % readsize != 0) {
+		errx(1, "Usage: readbench [size in KB] [read size (1-%d, "
+		     "dividing the file size)]", MAXREAD);
+	}
+	npieces = kb * 1024 / readsize;
+
+	/* Shuffle the pieces for the random pass. */
+	order = malloc(npieces * sizeof(order[0]));
+	if (order == NULL) {
+		err(1, "malloc");
+	}
+	srandom(now());
+	for (i=0; i<npieces; i++) {
+		order[i] = i;
+	}
+	for (i=npieces-1; i>0; i--) {
+		j = random() % (i + 1);
+		tmp = order[i];
+		order[i] = order[j];
+		order[j] = tmp;
+	}
+
+	makefile(kb);
+	/* Get the writes out of the way before timing anything. */
+	(void)readfile(NULL, npieces, readsize);
+
+	printf("%u KB file, %u-byte reads\n", kb, readsize);
+	report("sequential", kb, readfile(NULL, npieces, readsize));
+	report("random", kb, readfile(order, npieces, readsize));
+
+	free(order);
+	return 0;
+}
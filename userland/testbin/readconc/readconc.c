@@ -0,0 +1,187 @@
+/*
+ * readconc - concurrent file readers.
+ *
+ * Usage: readconc [max readers] [file size in KB]
+ *
+ * Writes one test file per reader, then for 1, 2, 4, ... up to MAX
+ * readers forks that many processes and times them all reading: once
+ * with each process reading its own file, and once with all of them
+ * reading the same file. Prints the total read rate for each, which
+ * should go up with the number of readers on a multiprocessor if
+ * readers don't serialize in the filesystem.
+ *
+ * The files are read several times over, so after the first pass
+ * they come from the buffer cache if it's big enough to hold them
+ * all; "bufstat size" in the kernel menu changes its size.
+ *
+ * There's no remove call, so the files (readconc.N) are left behind;
+ * the next run just writes over them.
+ */
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <err.h>
+
+#define DEFAULT_READERS	4
+#define DEFAULT_KB	16
+#define MAXREADERS	16
+#define CHUNK		4096
+#define PASSES		8
+
+static char buf[CHUNK];
+
+static
+unsigned long long
+now(void)
+{
+	time_t secs;
+	unsigned long nsecs;
+
+	__time(&secs, &nsecs);
+	return secs * 1000000000ULL + nsecs;
+}
+
+static
+void
+filename(char *name, size_t len, unsigned n)
+{
+	snprintf(name, len, "readconc.%u", n);
+}
+
+static
+void
+makefile(unsigned n, unsigned kb)
+{
+	char name[32];
+	unsigned i, j;
+	int fd;
+
+	filename(name, sizeof(name), n);
+	fd = open(name, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (fd < 0) {
+		err(1, "%s", name);
+	}
+	for (i=0; i < kb * 1024 / CHUNK; i++) {
+		for (j=0; j<CHUNK; j++) {
+			buf[j] = (char)(n + i + j);
+		}
+		if (write(fd, buf, CHUNK) != CHUNK) {
+			err(1, "%s: write", name);
+		}
+	}
+	close(fd);
+}
+
+/*
+ * Read file N from start to end PASSES times.
+ */
+static
+void
+readfile(unsigned n)
+{
+	char name[32];
+	unsigned pass;
+	int fd, len;
+
+	filename(name, sizeof(name), n);
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		err(1, "%s", name);
+	}
+	for (pass=0; pass<PASSES; pass++) {
+		if (lseek(fd, 0, SEEK_SET) < 0) {
+			err(1, "%s: lseek", name);
+		}
+		do {
+			len = read(fd, buf, CHUNK);
+			if (len < 0) {
+				err(1, "%s: read", name);
+			}
+		} while (len > 0);
+	}
+	close(fd);
+}
+
+/*
+ * Run NREADERS readers at once, each on its own file or all on file
+ * 0. Returns the elapsed time in nanoseconds.
+ */
+static
+unsigned long long
+run(unsigned nreaders, int shared)
+{
+	unsigned long long start;
+	pid_t pids[MAXREADERS];
+	unsigned i;
+	int status;
+
+	start = now();
+	for (i=0; i<nreaders; i++) {
+		pids[i] = fork();
+		if (pids[i] < 0) {
+			err(1, "fork");
+		}
+		if (pids[i] == 0) {
+			readfile(shared ? 0 : i);
+			_exit(0);
+		}
+	}
+	for (i=0; i<nreaders; i++) {
+		if (waitpid(pids[i], &status, 0) < 0) {
+			err(1, "waitpid");
+		}
+		if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+			errx(1, "reader %u failed", i);
+		}
+	}
+	return now() - start;
+}
+
+static
+void
+report(const char *what, unsigned nreaders, unsigned kb,
+       unsigned long long ns)
+{
+	unsigned long long totalkb;
+
+	totalkb = (unsigned long long)nreaders * kb * PASSES;
+	printf("%2u readers, %-10s %8llu KB in %12llu ns: %8llu KB/s\n",
+	       nreaders, what, totalkb, ns,
+	       ns ? totalkb * 1000000000ULL / ns : 0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	unsigned maxreaders = DEFAULT_READERS;
+	unsigned kb = DEFAULT_KB;
+	unsigned n, i;
+
+	if (argc > 1) {
+		maxreaders = atoi(argv[1]);
+	}
+	if (argc > 2) {
+		kb = atoi(argv[2]);
+	}
+	if (maxreaders == 0 || maxreaders > MAXREADERS || kb == 0) {
+		errx(1, "Usage: readconc [max readers (1-%d)] [size in KB]",
+		     MAXREADERS);
+	}
+
+	for (i=0; i<maxreaders; i++) {
+		makefile(i, kb);
+	}
+
+	/* Warm the cache (as far as it goes) so the first run isn't slow. */
+	run(maxreaders, 0);
+
+	for (n=1; n<=maxreaders; n*=2) {
+		report("own file", n, kb, run(n, 0));
+		report("same file", n, kb, run(n, 1));
+	}
+	return 0;
+}
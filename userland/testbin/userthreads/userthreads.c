@@ -35,14 +35,11 @@
  * This won't do much of anything unless you implement user-level
  * threads.
  *
- * It also makes various assumptions about the thread API. In
- * particular, it believes (1) that you create a thread by calling
- * "threadfork()" and passing the address for execution of the new
- * thread to begin at, (2) that if the parent thread exits any child
- * threads will keep running, and (3) child threads will exit if they
- * return from the function they started in. If any or all of these
- * assumptions are not met by your user-level threads, you will need
- * to patch this test accordingly.
+ * It uses the thread_create() API: a thread starts in a function
+ * taking and returning a void pointer, and exits if it returns from
+ * that function. The parent leaves with thread_exit() rather than
+ * returning from main, since exit() would take the child threads
+ * down with it.
  *
  * This is also a rather basic test and you'll probably want to write
  * some more of your own.
@@ -51,6 +48,7 @@
 
 #include <unistd.h>
 #include <stdio.h>
+#include <err.h>
 
 #define NTHREADS  3
 #define MAX       1<<25
@@ -61,8 +59,8 @@
 volatile int count = 0;
 
 /* the 2 threads : */
-void ThreadRunner(void);
-void BladeRunner(void);
+void *ThreadRunner(void *);
+void *BladeRunner(void *);
 
 int
 main(int argc, char *argv[])
@@ -73,14 +71,12 @@ main(int argc, char *argv[])
     (void)argv;
 
     for (i=0; i<NTHREADS; i++) {
-	if (i)
-	    threadfork(ThreadRunner);
-        else
-	    threadfork(BladeRunner);
+	if (thread_create(i ? ThreadRunner : BladeRunner, NULL) < 0)
+	    err(1, "thread_create");
     }
 
-    tprintf("Parent has left.\n");
-    return 0;
+    printf("Parent has left.\n");
+    thread_exit(NULL);
 }
 
 /* multiple threads will simply print out the global variable.
@@ -88,22 +84,26 @@ main(int argc, char *argv[])
    random results.
 */
 
-void
-BladeRunner()
+void *
+BladeRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
 	if (count % 500 == 0)
-	    tprintf("Blade ");
+	    printf("Blade ");
 	count++;
     }
+    return NULL;
 }
 
-void
-ThreadRunner()
+void *
+ThreadRunner(void *junk)
 {
+    (void)junk;
     while (count < MAX) {
 	if (count % 513 == 0)
-	    tprintf(" Runner\n");
+	    printf(" Runner\n");
 	count++;
     }
+    return NULL;
 }